@@ -0,0 +1,76 @@
+/*
+ * bench — capture-path microbenchmarks
+ * Build: make bench
+ * Run:   ./bench            (10 s of audio per case)
+ *        ./bench 60         (custom seconds per case)
+ *
+ * Times the in-process resampler on one core for the common device
+ * formats, once per dot-product kernel, and reports input samples per
+ * second and how many times faster than realtime that is.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define main dictator_main
+#include "dictator.c"
+#undef main
+
+typedef float (*dot_fn)(const float *, const float *, unsigned);
+
+static void bench_resample(const char *name, dot_fn dot, unsigned rate,
+                           unsigned channels, int seconds) {
+    struct resampler rs;
+    if (resampler_init(&rs, rate, SAMPLE_RATE) < 0) return;
+    rs.dot = dot;
+
+    size_t period = (size_t)PERIOD_FRAMES * rate / SAMPLE_RATE;
+    int16_t *in = malloc(period * channels * sizeof(int16_t));
+    int16_t *out = malloc(resampler_max_out(&rs, period) * sizeof(int16_t));
+    for (size_t i = 0; i < period * channels; i++)
+        in[i] = (int16_t)(rand() % 20000 - 10000);
+
+    size_t frames = (size_t)rate * seconds, done = 0, produced = 0;
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    while (done < frames) {
+        produced += resampler_process(&rs, in, period, channels, out);
+        done += period;
+    }
+    double ms = ms_since(&t0);
+
+    double msps = (double)done * channels / (ms * 1000.0);
+    printf("  %-7s %6u Hz × %u: %8.1f Msamples/s  %7.0fx realtime  (%zu out)\n",
+           name, rate, channels, msps, (double)seconds * 1000.0 / ms, produced);
+    free(in);
+    free(out);
+    resampler_free(&rs);
+}
+
+int main(int argc, char **argv) {
+    int seconds = argc > 1 ? atoi(argv[1]) : 10;
+    if (seconds <= 0) seconds = 10;
+
+    struct { const char *name; dot_fn dot; } kernels[3];
+    int nk = 0;
+    kernels[nk].name = "scalar"; kernels[nk++].dot = dot_scalar;
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        kernels[nk].name = "sse2"; kernels[nk++].dot = dot_sse2;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        kernels[nk].name = "avx2"; kernels[nk++].dot = dot_avx2;
+    }
+#endif
+
+    static const unsigned formats[][2] = { {48000, 2}, {48000, 1}, {44100, 2} };
+    printf("resampler, %d s per case, one core\n", seconds);
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++)
+        for (int k = 0; k < nk; k++)
+            bench_resample(kernels[k].name, kernels[k].dot,
+                           formats[f][0], formats[f][1], seconds);
+    return 0;
+}
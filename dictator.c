@@ -1,15 +1,25 @@
 /*
  * dictator — hold a hotkey to dictate, release to transcribe
- * Build: gcc -O2 -Wall -Wextra -DUSE_X11 -DUSE_EVDEV -o dictator dictator.c -lX11 -lasound -lcurl -lpthread -levdev
+ * Build: gcc -O2 -Wall -Wextra -DUSE_X11 -DUSE_EVDEV -o dictator dictator.c -lX11 -lasound -lcurl -lpthread -lm -levdev
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <stdatomic.h>
 #include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <poll.h>
 
 
 #ifdef USE_X11
@@ -29,20 +39,25 @@
 #include <alsa/asoundlib.h>
 #include <curl/curl.h>
 
+#ifdef USE_OPUS
+#include <opus/opus.h>
+#endif
+
 /* Audio config: 16kHz mono 16-bit — Whisper sweet spot */
 #define SAMPLE_RATE  16000
 #define CHANNELS     1
 #define FRAME_SIZE   2              /* 16-bit = 2 bytes */
-#define MAX_SECONDS  300
-#define BUF_SAMPLES  (SAMPLE_RATE * MAX_SECONDS)
-#define BUF_BYTES    (BUF_SAMPLES * FRAME_SIZE)
+#define MAX_SECONDS  300              /* default max_duration */
 #define PERIOD_FRAMES 1024
 #define CHUNK_SECONDS 30
 #define CHUNK_SAMPLES (SAMPLE_RATE * CHUNK_SECONDS)
+#define PREROLL_MAX_MS 2000
+#define VAD_PAD_MS   150              /* silence kept around speech */
+#define STORE_MAX_SECONDS (24 * 3600)  /* max_duration upper bound */
 
-static int16_t  pcm_buf[BUF_SAMPLES];
+static int16_t *pcm_buf;           /* contiguous view of the capture store */
 static size_t   pcm_pos;           /* samples written */
-static atomic_int recording;       /* flag: 1 = keep recording */
+static atomic_int recording;       /* flag: 1 = keep capturing this session */
 
 static char groq_key[1024];
 static char aai_key[1024];
@@ -57,6 +72,8 @@ static int  have_groq, have_aai;
 
 enum action { ACT_COPY, ACT_PASTE, ACT_TRANSLATE };
 
+enum codec { CODEC_WAV, CODEC_FLAC, CODEC_OPUS, CODEC_COUNT };
+
 /* ── Backend detection ────────────────────────────────────────────── */
 
 enum backend { BACKEND_X11, BACKEND_EVDEV };
@@ -90,6 +107,31 @@ static struct {
     int           max_duration;   /* recording limit in seconds */
     char          groq_model[64]; /* Groq Whisper model name */
     char          proxy[256];     /* HTTP proxy URL, empty = direct */
+    enum codec    groq_codec;     /* upload format per backend */
+    enum codec    aai_codec;
+    int           upload_concurrency; /* chunks in flight at once */
+    int           hedge;          /* 1 = race AssemblyAI against a slow Groq chunk */
+    int           hedge_after_ms; /* when to hedge, 0 = from observed Groq p95 */
+    int           groq_rpm;       /* client-side request pacing, 0 = none */
+    int           aai_rpm;
+    int           latency_slo_ms; /* text due this long after release, plus per audio second */
+    int           stream_upload;  /* 1 = upload chunks while still recording */
+    int           aai_live_upload; /* 1 = AssemblyAI upload starts on key press */
+    char          realtime_url[512]; /* ws(s):// streaming backend, empty = off */
+    char          spill_dir[256]; /* where long recordings spill to disk */
+    char          capture_source[256]; /* alsa, wav:PATH, raw:PATH, fd:N, tone[:HZ], noise */
+    char          capture_device[64]; /* ALSA PCM name */
+    int           capture_rate;   /* device rate, 0 = nearest to 16 kHz */
+    int           preroll_ms;     /* audio kept from before the press, 0 = off */
+    int           vad;            /* 1 = trim silence before upload */
+    int           hands_free;     /* 1 = press toggles, silence ends the take */
+    int           endpoint_ms;    /* trailing silence that ends a hands-free take */
+    double        time_compress;  /* WSOLA speed-up before upload, 1.0 = off */
+    int           vad_threshold_db; /* speech above noise floor */
+    int           vad_max_pause_ms; /* longer pauses are shortened to this */
+    int           capture_mmap;   /* 1 = mmap access, 0 = readi */
+    int           capture_sched;  /* SCHED_OTHER, SCHED_FIFO or SCHED_RR */
+    int           capture_priority; /* RT priority for FIFO/RR */
 } cfg = {
     .speech2text_key      = { .key_name = "F1", .mod_mask = 0 },
     .speech2text_paste_key     = { .key_name = "F1", .mod_mask = MOD_SHIFT },
@@ -98,6 +140,31 @@ static struct {
     .max_duration  = MAX_SECONDS,
     .groq_model    = "whisper-large-v3",
     .proxy         = "",
+    .groq_codec    = CODEC_WAV,
+    .aai_codec     = CODEC_WAV,
+    .upload_concurrency = 4,
+    .hedge         = 1,
+    .hedge_after_ms = 0,
+    .groq_rpm      = 0,
+    .aai_rpm       = 0,
+    .latency_slo_ms = 20000,
+    .stream_upload = 0,
+    .aai_live_upload = 1,
+    .realtime_url  = "",
+    .spill_dir     = "/var/tmp",
+    .capture_source = "alsa",
+    .capture_device = "default",
+    .capture_rate  = 0,
+    .preroll_ms    = 0,
+    .vad           = 1,
+    .hands_free    = 0,
+    .endpoint_ms   = 800,
+    .time_compress = 1.0,
+    .vad_threshold_db = 10,
+    .vad_max_pause_ms = 600,
+    .capture_mmap  = 0,
+    .capture_sched = SCHED_OTHER,
+    .capture_priority = 10,
 };
 
 /* ── Config file loader ─────────────────────────────────────────────── */
@@ -125,6 +192,19 @@ static void parse_hotkey(const char *val, struct hotkey *hk) {
     snprintf(hk->key_name, sizeof(hk->key_name), "%s", rest);
 }
 
+static enum codec parse_codec(const char *val) {
+    if (strcmp(val, "flac") == 0) return CODEC_FLAC;
+    if (strcmp(val, "opus") == 0) {
+#ifdef USE_OPUS
+        return CODEC_OPUS;
+#else
+        fprintf(stderr, "dictator: built without Opus (make OPUS=1), uploading flac\n");
+        return CODEC_FLAC;
+#endif
+    }
+    return CODEC_WAV;
+}
+
 static int load_config_file(const char *path) {
     FILE *f = fopen(path, "r");
     if (!f) return -1;
@@ -168,11 +248,99 @@ static int load_config_file(const char *path) {
             snprintf(cfg.groq_model, sizeof(cfg.groq_model), "%s", val);
         } else if (strcmp(key, "proxy") == 0) {
             snprintf(cfg.proxy, sizeof(cfg.proxy), "%s", val);
+        } else if (strcmp(key, "groq_codec") == 0) {
+            cfg.groq_codec = parse_codec(val);
+        } else if (strcmp(key, "aai_codec") == 0) {
+            cfg.aai_codec = parse_codec(val);
+        } else if (strcmp(key, "upload_concurrency") == 0) {
+            int v = atoi(val);
+            if (v < 1) v = 1;
+            if (v > 16) v = 16;
+            cfg.upload_concurrency = v;
+        } else if (strcmp(key, "hedge") == 0) {
+            cfg.hedge = (strcmp(val, "true") == 0);
+        } else if (strcmp(key, "hedge_after_ms") == 0) {
+            int v = atoi(val);
+            if (v < 0) v = 0;
+            if (v > 120000) v = 120000;
+            cfg.hedge_after_ms = v;
+        } else if (strcmp(key, "groq_rpm") == 0) {
+            int v = atoi(val);
+            if (v < 0) v = 0;
+            if (v > 10000) v = 10000;
+            cfg.groq_rpm = v;
+        } else if (strcmp(key, "aai_rpm") == 0) {
+            int v = atoi(val);
+            if (v < 0) v = 0;
+            if (v > 10000) v = 10000;
+            cfg.aai_rpm = v;
+        } else if (strcmp(key, "latency_slo_ms") == 0) {
+            int v = atoi(val);
+            if (v < 1000) v = 1000;
+            if (v > 600000) v = 600000;
+            cfg.latency_slo_ms = v;
+        } else if (strcmp(key, "stream_upload") == 0) {
+            cfg.stream_upload = (strcmp(val, "true") == 0);
+        } else if (strcmp(key, "aai_live_upload") == 0) {
+            cfg.aai_live_upload = (strcmp(val, "true") == 0);
+        } else if (strcmp(key, "realtime_url") == 0) {
+            snprintf(cfg.realtime_url, sizeof(cfg.realtime_url), "%s", val);
+        } else if (strcmp(key, "spill_dir") == 0) {
+            snprintf(cfg.spill_dir, sizeof(cfg.spill_dir), "%s", val);
         } else if (strcmp(key, "max_duration") == 0) {
             int v = atoi(val);
             if (v < 10) v = 10;
-            if (v > MAX_SECONDS) v = MAX_SECONDS;
+            if (v > STORE_MAX_SECONDS) v = STORE_MAX_SECONDS;
             cfg.max_duration = v;
+        } else if (strcmp(key, "preroll_ms") == 0) {
+            int v = atoi(val);
+            if (v < 0) v = 0;
+            if (v > PREROLL_MAX_MS) v = PREROLL_MAX_MS;
+            cfg.preroll_ms = v;
+        } else if (strcmp(key, "hands_free") == 0) {
+            cfg.hands_free = (strcmp(val, "true") == 0);
+        } else if (strcmp(key, "endpoint_ms") == 0) {
+            int v = atoi(val);
+            if (v < 300) v = 300;
+            if (v > 5000) v = 5000;
+            cfg.endpoint_ms = v;
+        } else if (strcmp(key, "time_compress") == 0) {
+            double v = atof(val);
+            if (v < 1.0) v = 1.0;
+            if (v > 2.0) v = 2.0;
+            cfg.time_compress = v;
+        } else if (strcmp(key, "vad") == 0) {
+            cfg.vad = (strcmp(val, "true") == 0);
+        } else if (strcmp(key, "vad_threshold_db") == 0) {
+            int v = atoi(val);
+            if (v < 3) v = 3;
+            if (v > 40) v = 40;
+            cfg.vad_threshold_db = v;
+        } else if (strcmp(key, "vad_max_pause_ms") == 0) {
+            int v = atoi(val);
+            if (v < 2 * VAD_PAD_MS) v = 2 * VAD_PAD_MS;
+            if (v > 10000) v = 10000;
+            cfg.vad_max_pause_ms = v;
+        } else if (strcmp(key, "capture_source") == 0) {
+            snprintf(cfg.capture_source, sizeof(cfg.capture_source), "%s", val);
+        } else if (strcmp(key, "capture_device") == 0) {
+            snprintf(cfg.capture_device, sizeof(cfg.capture_device), "%s", val);
+        } else if (strcmp(key, "capture_rate") == 0) {
+            int v = atoi(val);
+            if (v != 0 && v < 8000) v = 8000;
+            if (v > 192000) v = 192000;
+            cfg.capture_rate = v;
+        } else if (strcmp(key, "capture_access") == 0) {
+            cfg.capture_mmap = (strcmp(val, "mmap") == 0);
+        } else if (strcmp(key, "capture_sched") == 0) {
+            cfg.capture_sched = strcmp(val, "fifo") == 0 ? SCHED_FIFO
+                              : strcmp(val, "rr") == 0   ? SCHED_RR
+                              :                            SCHED_OTHER;
+        } else if (strcmp(key, "capture_priority") == 0) {
+            int v = atoi(val);
+            if (v < 1) v = 1;
+            if (v > 99) v = 99;
+            cfg.capture_priority = v;
         }
         /* old "key" and "autopaste" entries silently ignored */
     }
@@ -236,498 +404,5374 @@ static void notify(const char *msg) {
     if (run(cmd)) { /* best effort */ }
 }
 
-/* ── ALSA recording thread ──────────────────────────────────────────── */
+/* ── Timing helpers ─────────────────────────────────────────────────── */
 
-static void *record_thread(void *arg) {
-    (void)arg;
-    snd_pcm_t *pcm;
-    int err;
+static double ms_since(const struct timespec *t0) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - t0->tv_sec) * 1000.0
+         + (double)(now.tv_nsec - t0->tv_nsec) / 1e6;
+}
 
-    if ((err = snd_pcm_open(&pcm, "default", SND_PCM_STREAM_CAPTURE, 0)) < 0) {
-        fprintf(stderr, "dictator: ALSA open: %s\n", snd_strerror(err));
-        return NULL;
-    }
+static double mono_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_nsec / 1e6;
+}
 
-    snd_pcm_hw_params_t *params;
-    snd_pcm_hw_params_alloca(&params);
-    snd_pcm_hw_params_any(pcm, params);
-    snd_pcm_hw_params_set_access(pcm, params, SND_PCM_ACCESS_RW_INTERLEAVED);
-    snd_pcm_hw_params_set_format(pcm, params, SND_PCM_FORMAT_S16_LE);
-    snd_pcm_hw_params_set_channels(pcm, params, CHANNELS);
-    unsigned int rate = SAMPLE_RATE;
-    snd_pcm_hw_params_set_rate_near(pcm, params, &rate, NULL);
-    if (rate != SAMPLE_RATE) {
-        fprintf(stderr, "dictator: ALSA rate %u != %d, aborting\n",
-                rate, SAMPLE_RATE);
-        snd_pcm_close(pcm);
-        return NULL;
-    }
-    snd_pcm_uframes_t period = PERIOD_FRAMES;
-    snd_pcm_hw_params_set_period_size_near(pcm, params, &period, NULL);
+/* ── Capture store ──────────────────────────────────────────────────── */
 
-    if ((err = snd_pcm_hw_params(pcm, params)) < 0) {
-        fprintf(stderr, "dictator: ALSA params: %s\n", snd_strerror(err));
-        snd_pcm_close(pcm);
-        return NULL;
+/*
+ * pcm_buf is a window into one big reserved (PROT_NONE) address range,
+ * made usable one segment at a time as the recording grows. The first
+ * STORE_RAM_SEGS segments are plain anonymous memory, so ordinary
+ * dictations never touch the disk. Later segments are mapped from an
+ * unlinked temp file in spill_dir and dropped from RSS once filled, so
+ * a meeting-length session costs disk, not memory. Readers still see a
+ * single contiguous int16_t array.
+ */
+
+#define STORE_SEG_SAMPLES (1u << 19)          /* 1 MiB, ~33 s */
+#define STORE_SEG_BYTES   ((size_t)STORE_SEG_SAMPLES * FRAME_SIZE)
+#define STORE_RAM_SEGS    2
+#define STORE_MAX_SEGS    (((size_t)STORE_MAX_SECONDS * SAMPLE_RATE \
+                            + STORE_SEG_SAMPLES - 1) / STORE_SEG_SAMPLES + 1)
+
+static struct {
+    size_t nsegs;        /* segments currently usable */
+    int    fd;           /* spill file, -1 until the first spill */
+    size_t released;     /* file segments below this sample were dropped */
+} store = { .fd = -1 };
+
+static int store_open_spill(void) {
+    int fd = -1;
+#ifdef O_TMPFILE
+    fd = open(cfg.spill_dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+#endif
+    if (fd < 0) {
+        char path[300];
+        snprintf(path, sizeof(path), "%s/dictator-XXXXXX", cfg.spill_dir);
+        fd = mkstemp(path);
+        if (fd >= 0) unlink(path);
+    }
+    if (fd < 0) {
+        fprintf(stderr, "dictator: cannot create spill file in %s: %s\n",
+                cfg.spill_dir, strerror(errno));
+        return -1;
     }
+    store.fd = fd;
+    return 0;
+}
 
-    pcm_pos = 0;
-    int warned = 0;
-    size_t max_samples = (size_t)(SAMPLE_RATE * cfg.max_duration);
-    while (recording && pcm_pos + period <= (snd_pcm_uframes_t)max_samples) {
-        snd_pcm_sframes_t n = snd_pcm_readi(pcm, pcm_buf + pcm_pos, period);
-        if (n == -EPIPE) {
-            snd_pcm_prepare(pcm);
-            continue;
-        }
-        if (n < 0) {
-            fprintf(stderr, "dictator: ALSA read: %s\n", snd_strerror((int)n));
-            break;
+/* Make pcm_buf[0..samples) writable. Returns -1 when the disk is full or
+ * the session hit STORE_MAX_SECONDS. */
+static int pcm_store_reserve(size_t samples) {
+    if (!pcm_buf) {
+        void *base = mmap(NULL, STORE_MAX_SEGS * STORE_SEG_BYTES, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base == MAP_FAILED) {
+            perror("dictator: reserve capture store");
+            return -1;
         }
-        pcm_pos += (size_t)n;
-        if (!warned && pcm_pos >= (size_t)(SAMPLE_RATE * (cfg.max_duration - 10))) {
-            char msg[128];
-            snprintf(msg, sizeof(msg),
-                     "Recording limit approaching (max_duration=%ds)",
-                     cfg.max_duration);
-            notify(msg);
-            warned = 1;
+        pcm_buf = base;
+    }
+    while (store.nsegs * STORE_SEG_SAMPLES < samples) {
+        if (store.nsegs >= STORE_MAX_SEGS) return -1;
+        uint8_t *seg = (uint8_t *)pcm_buf + store.nsegs * STORE_SEG_BYTES;
+        if (store.nsegs < STORE_RAM_SEGS) {
+            if (mprotect(seg, STORE_SEG_BYTES, PROT_READ | PROT_WRITE) < 0) {
+                perror("dictator: capture store");
+                return -1;
+            }
+        } else {
+            if (store.fd < 0 && store_open_spill() < 0) return -1;
+            off_t off = (off_t)(store.nsegs - STORE_RAM_SEGS) * (off_t)STORE_SEG_BYTES;
+            /* allocate blocks now: a full disk must fail here, not SIGBUS later */
+            int err = posix_fallocate(store.fd, off, (off_t)STORE_SEG_BYTES);
+            if (err) {
+                fprintf(stderr, "dictator: spill file: %s\n", strerror(err));
+                return -1;
+            }
+            if (mmap(seg, STORE_SEG_BYTES, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_FIXED, store.fd, off) == MAP_FAILED) {
+                perror("dictator: map spill segment");
+                return -1;
+            }
+            if (store.nsegs == STORE_RAM_SEGS)
+                printf("dictator: recording spills to %s\n", cfg.spill_dir);
         }
+        store.nsegs++;
     }
-    if (pcm_pos + period > (snd_pcm_uframes_t)max_samples) {
-        notify("Recording limit reached — set max_duration in /etc/dictator.conf to increase");
+    return 0;
+}
+
+/* Drop filled spill segments below `samples` from RSS. The data stays in
+ * the file and faults back in if read again. */
+static void pcm_store_release(size_t samples) {
+    size_t first = STORE_RAM_SEGS * (size_t)STORE_SEG_SAMPLES;
+    if (store.released < first) store.released = first;
+    size_t upto = samples / STORE_SEG_SAMPLES * STORE_SEG_SAMPLES;
+    if (upto <= store.released || upto > store.nsegs * STORE_SEG_SAMPLES) return;
+    madvise(pcm_buf + store.released, (upto - store.released) * FRAME_SIZE,
+            MADV_DONTNEED);
+    store.released = upto;
+}
+
+/* Forget the last recording: unmap everything, truncate the spill file */
+static void pcm_store_reset(void) {
+    if (pcm_buf && store.nsegs) {
+        mmap(pcm_buf, store.nsegs * STORE_SEG_BYTES, PROT_NONE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+        if (store.fd >= 0 && ftruncate(store.fd, 0) < 0) { /* best effort */ }
     }
+    store.nsegs = 0;
+    store.released = 0;
+    pcm_pos = 0;
+}
 
-    snd_pcm_close(pcm);
-    return NULL;
+/* ── Growable text buffer ───────────────────────────────────────────── */
+
+struct strbuf { char *data; size_t len, cap; };
+
+static int strbuf_append(struct strbuf *sb, const char *s, size_t n) {
+    if (sb->len + n + 1 > sb->cap) {
+        size_t cap = sb->cap ? sb->cap : 256;
+        while (cap < sb->len + n + 1) cap *= 2;
+        char *tmp = realloc(sb->data, cap);
+        if (!tmp) return -1;
+        sb->data = tmp;
+        sb->cap = cap;
+    }
+    memcpy(sb->data + sb->len, s, n);
+    sb->len += n;
+    sb->data[sb->len] = '\0';
+    return 0;
 }
 
-/* ── WAV builder (in-memory) ────────────────────────────────────────── */
+/* Append a transcript piece, space-separated from what came before */
+static int strbuf_append_words(struct strbuf *sb, const char *text) {
+    if (sb->len > 0 && strbuf_append(sb, " ", 1) < 0) return -1;
+    return strbuf_append(sb, text, strlen(text));
+}
 
-static size_t build_wav(int16_t *samples, size_t num_samples, uint8_t **out) {
-    size_t data_bytes = num_samples * FRAME_SIZE;
-    size_t total = 44 + data_bytes;
-    uint8_t *wav = malloc(total);
-    if (!wav) return 0;
+static void strbuf_free(struct strbuf *sb) {
+    free(sb->data);
+    *sb = (struct strbuf){0};
+}
 
-    uint32_t u32;
-    uint16_t u16;
+/* ── Lock-free SPSC sample ring ─────────────────────────────────────── */
 
-    memcpy(wav, "RIFF", 4);
-    u32 = (uint32_t)(total - 8);    memcpy(wav + 4, &u32, 4);
-    memcpy(wav + 8, "WAVE", 4);
-    memcpy(wav + 12, "fmt ", 4);
-    u32 = 16;                        memcpy(wav + 16, &u32, 4);
-    u16 = 1;                         memcpy(wav + 20, &u16, 2); /* PCM */
-    u16 = CHANNELS;                  memcpy(wav + 22, &u16, 2);
-    u32 = SAMPLE_RATE;               memcpy(wav + 24, &u32, 4);
-    u32 = SAMPLE_RATE * CHANNELS * FRAME_SIZE;
-                                     memcpy(wav + 28, &u32, 4); /* byte rate */
-    u16 = CHANNELS * FRAME_SIZE;     memcpy(wav + 32, &u16, 2); /* block align */
-    u16 = 16;                        memcpy(wav + 34, &u16, 2); /* bits/sample */
-    memcpy(wav + 36, "data", 4);
-    u32 = (uint32_t)data_bytes;      memcpy(wav + 40, &u32, 4);
-    memcpy(wav + 44, samples, data_bytes);
+/*
+ * Single producer (the capture thread), single consumer (an encoder,
+ * level meter, streaming uploader...). head and tail are free-running
+ * sample counters; the producer publishes samples with a release store
+ * of head and the consumer frees space with a release store of tail, so
+ * neither side ever takes a lock. The producer never blocks: if a
+ * consumer falls behind by a whole ring, new samples are dropped for that
+ * consumer and counted in `overruns`.
+ */
 
-    *out = wav;
-    return total;
+struct pcm_ring {
+    int16_t      *buf;
+    size_t        mask;                   /* capacity - 1, power of two */
+    _Alignas(64) atomic_size_t head;      /* samples written, producer-owned */
+    _Alignas(64) atomic_size_t tail;      /* samples read, consumer-owned */
+    _Alignas(64) atomic_size_t overruns;  /* samples dropped on a full ring */
+    atomic_int    eof;                    /* producer finished the session */
+};
+
+/* Capacity is rounded up to a power of two */
+static int pcm_ring_init(struct pcm_ring *r, size_t min_samples) {
+    size_t cap = 1;
+    while (cap < min_samples) cap <<= 1;
+    r->buf = malloc(cap * sizeof(int16_t));
+    if (!r->buf) return -1;
+    r->mask = cap - 1;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->overruns, 0);
+    atomic_init(&r->eof, 0);
+    return 0;
 }
 
-/* ── curl write callback ────────────────────────────────────────────── */
+static void pcm_ring_free(struct pcm_ring *r) {
+    free(r->buf);
+    r->buf = NULL;
+}
 
-struct response { char *data; size_t len; };
+/* Start a new session: only while neither side is running */
+static void pcm_ring_reset(struct pcm_ring *r) {
+    atomic_store_explicit(&r->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, 0, memory_order_relaxed);
+    atomic_store_explicit(&r->overruns, 0, memory_order_relaxed);
+    atomic_store_explicit(&r->eof, 0, memory_order_release);
+}
 
-static size_t write_cb(void *ptr, size_t size, size_t nmemb, void *userp) {
-    size_t bytes = size * nmemb;
-    struct response *r = userp;
-    char *tmp = realloc(r->data, r->len + bytes + 1);
-    if (!tmp) return 0;
-    r->data = tmp;
-    memcpy(r->data + r->len, ptr, bytes);
-    r->len += bytes;
-    r->data[r->len] = '\0';
-    return bytes;
+/* Producer side: free space */
+static size_t pcm_ring_space(struct pcm_ring *r) {
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    return r->mask + 1 - (head - tail);
 }
 
-/* ── Minimal JSON string extraction ─────────────────────────────────── */
+/* Consumer side: samples ready to read */
+static size_t pcm_ring_readable(struct pcm_ring *r) {
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    return head - tail;
+}
 
-/* Decode a hex digit, returns -1 on invalid input */
-static int hexval(char c) {
-    if (c >= '0' && c <= '9') return c - '0';
-    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
-    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
-    return -1;
+/* Producer: append up to n samples, returns how many fit */
+static size_t pcm_ring_write(struct pcm_ring *r, const int16_t *src, size_t n) {
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t space = pcm_ring_space(r);
+    if (n > space) {
+        atomic_fetch_add_explicit(&r->overruns, n - space, memory_order_relaxed);
+        n = space;
+    }
+    size_t at = head & r->mask;
+    size_t first = r->mask + 1 - at;
+    if (first > n) first = n;
+    memcpy(r->buf + at, src, first * sizeof(int16_t));
+    memcpy(r->buf, src + first, (n - first) * sizeof(int16_t));
+    atomic_store_explicit(&r->head, head + n, memory_order_release);
+    return n;
 }
 
-/* Parse \uXXXX at *p (p points past the 'u'), returns codepoint, advances *p */
-static uint32_t parse_u_escape(char **p) {
-    uint32_t cp = 0;
-    for (int i = 0; i < 4; i++) {
-        int v = hexval((*p)[i]);
-        if (v < 0) return 0xFFFD;
-        cp = (cp << 4) | (uint32_t)v;
+/* Consumer: take up to n samples, returns how many were copied */
+static size_t pcm_ring_read(struct pcm_ring *r, int16_t *dst, size_t n) {
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    size_t avail = pcm_ring_readable(r);
+    if (n > avail) n = avail;
+    size_t at = tail & r->mask;
+    size_t first = r->mask + 1 - at;
+    if (first > n) first = n;
+    memcpy(dst, r->buf + at, first * sizeof(int16_t));
+    memcpy(dst + first, r->buf, (n - first) * sizeof(int16_t));
+    atomic_store_explicit(&r->tail, tail + n, memory_order_release);
+    return n;
+}
+
+/* Producer: no more samples this session */
+static void pcm_ring_close(struct pcm_ring *r) {
+    atomic_store_explicit(&r->eof, 1, memory_order_release);
+}
+
+/* Consumer: closed and drained. Check eof before readable so samples
+ * published just before the close are not missed. */
+static int pcm_ring_done(struct pcm_ring *r) {
+    return atomic_load_explicit(&r->eof, memory_order_acquire)
+        && pcm_ring_readable(r) == 0;
+}
+
+/* ── Polyphase resampler ────────────────────────────────────────────── */
+
+/*
+ * Rational L/M polyphase FIR: downmixes interleaved S16 frames to mono
+ * and converts any device rate to SAMPLE_RATE (48k→16k is 1/3, 44.1k→16k
+ * is 160/441). Output m uses phase r = mM mod L of a Kaiser-windowed sinc
+ * prototype against the newest input x[mM / L] and its predecessors. Each
+ * phase is stored reversed so every output is one contiguous dot product,
+ * done with AVX2+FMA or SSE2 when the CPU has them.
+ */
+
+#define RS_ZERO_CROSSINGS 24   /* taps per input-rate sample of cutoff */
+#define RS_MAX_L          1024
+#define RS_KAISER_BETA    8.0
+
+struct resampler {
+    unsigned L, M;          /* out/in rate ratio, reduced */
+    unsigned taps;          /* per phase, multiple of 8 */
+    float   *coef;          /* L phases × taps, each reversed */
+    float   *hist;          /* taps-1 samples of history + pending input */
+    size_t   hist_cap, nhist;
+    size_t   pos;           /* hist index of the next output's newest input */
+    unsigned phase;
+    float  (*dot)(const float *, const float *, unsigned);
+};
+
+static float dot_scalar(const float *a, const float *b, unsigned n) {
+    float acc[8] = {0};
+    for (unsigned i = 0; i < n; i += 8)
+        for (unsigned j = 0; j < 8; j++)
+            acc[j] += a[i + j] * b[i + j];
+    return ((acc[0] + acc[1]) + (acc[2] + acc[3]))
+         + ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+
+__attribute__((target("sse2")))
+static float dot_sse2(const float *a, const float *b, unsigned n) {
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    for (unsigned i = 0; i < n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i),     _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
     }
-    *p += 4;
-    return cp;
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+    return _mm_cvtss_f32(acc0);
 }
 
-/* Write a Unicode codepoint as UTF-8, returns number of bytes written */
-static size_t utf8_encode(uint32_t cp, char *out) {
-    if (cp < 0x80) {
-        out[0] = (char)cp;
-        return 1;
-    } else if (cp < 0x800) {
-        out[0] = (char)(0xC0 | (cp >> 6));
-        out[1] = (char)(0x80 | (cp & 0x3F));
-        return 2;
-    } else if (cp < 0x10000) {
-        out[0] = (char)(0xE0 | (cp >> 12));
-        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
-        out[2] = (char)(0x80 | (cp & 0x3F));
-        return 3;
-    } else if (cp < 0x110000) {
-        out[0] = (char)(0xF0 | (cp >> 18));
-        out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
-        out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
-        out[3] = (char)(0x80 | (cp & 0x3F));
-        return 4;
+__attribute__((target("avx2,fma")))
+static float dot_avx2(const float *a, const float *b, unsigned n) {
+    __m256 acc = _mm256_setzero_ps();
+    for (unsigned i = 0; i < n; i += 8)
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc);
+    __m128 lo = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1));
+    return _mm_cvtss_f32(lo);
+}
+#endif
+
+/* Best kernel this CPU runs */
+static float (*resampler_pick_dot(void))(const float *, const float *, unsigned) {
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return dot_avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return dot_sse2;
+#endif
+    return dot_scalar;
+}
+
+static double bessel_i0(double x) {
+    double sum = 1, term = 1;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
     }
-    return utf8_encode(0xFFFD, out); /* replacement char */
+    return sum;
 }
 
-/* Unescape a JSON string in-place: \uXXXX → UTF-8, \n, \t, etc. */
-static char *json_unescape(char *s) {
-    char *r = s, *w = s;
-    while (*r) {
-        if (*r == '\\' && r[1]) {
-            r++;
-            switch (*r) {
-            case '"': case '\\': case '/': *w++ = *r++; break;
-            case 'n': *w++ = '\n'; r++; break;
-            case 't': *w++ = '\t'; r++; break;
-            case 'r': *w++ = '\r'; r++; break;
-            case 'b': *w++ = '\b'; r++; break;
-            case 'f': *w++ = '\f'; r++; break;
-            case 'u': {
-                r++; /* skip 'u' */
-                uint32_t cp = parse_u_escape(&r);
-                /* Handle surrogate pairs: \uD800-\uDBFF \uDC00-\uDFFF */
-                if (cp >= 0xD800 && cp <= 0xDBFF && r[0] == '\\' && r[1] == 'u') {
-                    r += 2; /* skip \u */
-                    uint32_t lo = parse_u_escape(&r);
-                    if (lo >= 0xDC00 && lo <= 0xDFFF)
-                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
-                }
-                w += utf8_encode(cp, w);
-                break;
-            }
-            default: *w++ = '\\'; *w++ = *r++; break;
-            }
-        } else {
-            *w++ = *r++;
+static unsigned gcd_u(unsigned a, unsigned b) {
+    while (b) { unsigned t = a % b; a = b; b = t; }
+    return a;
+}
+
+static int resampler_init(struct resampler *rs, unsigned in_rate, unsigned out_rate) {
+    unsigned g = gcd_u(in_rate, out_rate);
+    memset(rs, 0, sizeof(*rs));
+    rs->L = out_rate / g;
+    rs->M = in_rate / g;
+    if (rs->L > RS_MAX_L) return -1;
+
+    unsigned wide = rs->M > rs->L ? rs->M : rs->L;
+    rs->taps = (RS_ZERO_CROSSINGS * wide / rs->L + 7) & ~7u;
+    size_t n = (size_t)rs->L * rs->taps;
+    rs->coef = malloc(n * sizeof(float));
+    if (!rs->coef) return -1;
+
+    /* prototype at L × in_rate: cut just below the lower Nyquist */
+    double fc = 0.5 / wide * 0.94;
+    double mid = (double)(n - 1) / 2;
+    double i0b = bessel_i0(RS_KAISER_BETA);
+    for (unsigned r = 0; r < rs->L; r++) {
+        for (unsigned t = 0; t < rs->taps; t++) {
+            size_t k = r + (size_t)t * rs->L;
+            double x = (double)k - mid;
+            double sinc = x == 0 ? 2 * fc : sin(2 * M_PI * fc * x) / (M_PI * x);
+            double w = (2.0 * x) / (double)(n - 1);
+            double win = bessel_i0(RS_KAISER_BETA * sqrt(fmax(0, 1 - w * w))) / i0b;
+            rs->coef[(size_t)r * rs->taps + (rs->taps - 1 - t)] = (float)(sinc * win * rs->L);
         }
     }
-    *w = '\0';
-    return s;
+    rs->dot = resampler_pick_dot();
+    rs->nhist = rs->pos = rs->taps - 1;   /* start from silence */
+    return 0;
 }
 
-/* Extract the string value for a given key from JSON.
- * Looks for "key": "value" and returns a malloc'd copy of value (UTF-8).
- * Returns NULL if not found. */
-static char *json_get_string(const char *json, const char *key) {
-    char needle[128];
-    snprintf(needle, sizeof(needle), "\"%s\"", key);
-    const char *p = json;
-    while ((p = strstr(p, needle)) != NULL) {
-        p += strlen(needle);
-        /* skip whitespace */
-        while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
-        if (*p == ':') break; /* found as key */
-        /* matched as value (e.g. "status": "error"), keep searching */
-    }
-    if (!p) return NULL;
-    p++; /* skip colon */
-    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
-    if (*p == 'n' && strncmp(p, "null", 4) == 0) return NULL;
-    if (*p != '"') return NULL;
-    p++; /* skip opening quote */
-    const char *start = p;
-    while (*p && !(*p == '"' && *(p - 1) != '\\')) p++;
-    if (!*p) return NULL;
-    size_t len = (size_t)(p - start);
-    char *val = malloc(len + 1);
-    if (!val) return NULL;
-    memcpy(val, start, len);
-    val[len] = '\0';
-    return json_unescape(val);
+static void resampler_free(struct resampler *rs) {
+    free(rs->coef);
+    free(rs->hist);
+    memset(rs, 0, sizeof(*rs));
 }
 
-/* ── Shared curl helper ─────────────────────────────────────────────── */
+/* Forget history (after a stream restart) */
+static void resampler_reset(struct resampler *rs) {
+    if (rs->hist) memset(rs->hist, 0, (rs->taps - 1) * sizeof(float));
+    rs->nhist = rs->pos = rs->taps - 1;
+    rs->phase = 0;
+}
 
-/* Perform request, check for errors, return response.
- * Caller must free resp->data. Returns 0 on success, -1 on failure. */
-static int api_request(CURL *curl, struct curl_slist *headers,
-                       struct response *resp, const char *label) {
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, resp);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 120L);
-    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+/* Upper bound of outputs produced from `frames` input frames */
+static size_t resampler_max_out(const struct resampler *rs, size_t frames) {
+    return (frames * rs->L + rs->M - 1) / rs->M + 1;
+}
+
+/* Downmix `frames` interleaved frames of `channels` and resample into out.
+ * Returns samples written (at most resampler_max_out), or 0 on OOM. */
+static size_t resampler_process(struct resampler *rs, const int16_t *in,
+                                size_t frames, unsigned channels, int16_t *out) {
+    if (rs->nhist + frames > rs->hist_cap) {
+        size_t cap = rs->nhist + frames;
+        float *tmp = realloc(rs->hist, cap * sizeof(float));
+        if (!tmp) return 0;
+        if (!rs->hist) memset(tmp, 0, (rs->taps - 1) * sizeof(float));
+        rs->hist = tmp;
+        rs->hist_cap = cap;
+    }
+    float *x = rs->hist + rs->nhist;
+    float scale = 1.0f / (float)channels;
+    if (channels == 1) {
+        for (size_t i = 0; i < frames; i++) x[i] = in[i];
+    } else {
+        for (size_t i = 0; i < frames; i++) {
+            int sum = 0;
+            for (unsigned c = 0; c < channels; c++) sum += in[i * channels + c];
+            x[i] = (float)sum * scale;
+        }
+    }
+    rs->nhist += frames;
+
+    size_t nout = 0;
+    unsigned taps = rs->taps;
+    while (rs->pos < rs->nhist) {
+        float y = rs->dot(rs->coef + (size_t)rs->phase * taps,
+                          rs->hist + rs->pos - (taps - 1), taps);
+        long v = lrintf(y);
+        out[nout++] = (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+        rs->phase += rs->M;
+        rs->pos += rs->phase / rs->L;
+        rs->phase %= rs->L;
+    }
+
+    /* keep the last taps-1 inputs for the next block */
+    size_t drop = rs->pos - (taps - 1);
+    if (drop > rs->nhist) drop = rs->nhist;
+    memmove(rs->hist, rs->hist + drop, (rs->nhist - drop) * sizeof(float));
+    rs->nhist -= drop;
+    rs->pos -= drop;
+    return nout;
+}
+
+/* ── Voice activity detection ───────────────────────────────────────── */
+
+/*
+ * Runs between capture and build_wav. The recording is cut into 10 ms
+ * frames and each gets its energy and zero-crossing count. The noise
+ * floor is the 10th percentile of frame energies; a frame is speech when
+ * it sits vad_threshold_db above that floor, or a few dB less with a
+ * fricative-like crossing rate (s, f, sh are quiet but busy). Runs
+ * shorter than VAD_MIN_RUN frames (key clicks) don't count.
+ *
+ * Leading and trailing silence are trimmed to VAD_PAD_MS, internal
+ * pauses longer than vad_max_pause_ms are cut down to that length, in
+ * place. With less than VAD_MIN_SPEECH_MS of speech nothing is uploaded.
+ * The kept ranges are reported as spans of the original capture so that
+ * work done on the raw audio during capture can be reused afterwards.
+ */
+
+#define VAD_FRAME         (SAMPLE_RATE / 100)  /* 10 ms */
+#define VAD_MIN_SPEECH_MS 150
+#define VAD_MIN_RUN       5                    /* frames */
+#define VAD_FLOOR_DB      (-60.0)              /* quieter is never speech */
+#define VAD_NOISE_MAX_DB  (-45.0)              /* all-speech takes: floor can't be higher */
+#define VAD_FRIC_DB       6.0                  /* fricatives may sit this far below */
+#define VAD_FRIC_ZC       50                   /* crossings per frame, ~2.5 kHz */
+#define VAD_HIST_DB       100                  /* histogram covers -100..0 dBFS */
+
+struct vad_stats {
+    size_t in, out;          /* samples before / after */
+    size_t voiced;           /* speech frames */
+    double floor_db, threshold_db;
+};
+
+struct pcm_span { size_t raw, len; };   /* `len` samples from capture offset `raw` */
+
+struct span_list {
+    struct pcm_span *v;
+    size_t n, cap;
+    int    lost;             /* out of memory: origin unknown */
+};
+
+/* Append, merging with the previous span when contiguous */
+static void span_add(struct span_list *l, size_t raw, size_t len) {
+    if (l->lost || !len) return;
+    if (l->n && l->v[l->n - 1].raw + l->v[l->n - 1].len == raw) {
+        l->v[l->n - 1].len += len;
+        return;
+    }
+    if (l->n == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 16;
+        void *tmp = realloc(l->v, cap * sizeof(*l->v));
+        if (!tmp) { l->lost = 1; return; }
+        l->v = tmp;
+        l->cap = cap;
+    }
+    l->v[l->n++] = (struct pcm_span){ raw, len };
+}
+
+static void span_list_free(struct span_list *l) {
+    free(l->v);
+    *l = (struct span_list){0};
+}
+
+/* Spans found in pcm_buf + by refer to capture offsets `by` later */
+static void span_list_shift(struct span_list *l, size_t by) {
+    for (size_t i = 0; i < l->n; i++) l->v[i].raw += by;
+}
+
+/* Sum of squares and sign changes over x[0..n) */
+static void vad_frame_stats(const int16_t *x, size_t n, uint64_t *energy, unsigned *zc) {
+    uint64_t e = 0;
+    unsigned z = 0;
+    size_t i = 1;
+    if (n == 0) { *energy = 0; *zc = 0; return; }
+    e = (uint64_t)((int32_t)x[0] * x[0]);
+#ifdef __SSE2__
+    __m128i acc_e = _mm_setzero_si128(), acc_z = _mm_setzero_si128();
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(x + i - 1));
+        /* pmaddwd: two squares per lane, < 2^31 + 1 so exact as unsigned */
+        __m128i sq = _mm_madd_epi16(a, a);
+        acc_e = _mm_add_epi64(acc_e, _mm_unpacklo_epi32(sq, zero));
+        acc_e = _mm_add_epi64(acc_e, _mm_unpackhi_epi32(sq, zero));
+        /* sign bit of a^b set where the sign flipped: -1 per crossing */
+        acc_z = _mm_sub_epi16(acc_z, _mm_srai_epi16(_mm_xor_si128(a, b), 15));
+    }
+    uint64_t le[2];
+    uint16_t lz[8];
+    _mm_storeu_si128((__m128i *)le, acc_e);
+    _mm_storeu_si128((__m128i *)lz, acc_z);
+    e += le[0] + le[1];
+    for (int k = 0; k < 8; k++) z += lz[k];
+#endif
+    for (; i < n; i++) {
+        e += (uint64_t)((int32_t)x[i] * x[i]);
+        z += (x[i] ^ x[i - 1]) < 0;
+    }
+    *energy = e;
+    *zc = z;
+}
+
+static double vad_db(uint64_t energy, size_t n) {
+    double ms = (double)energy / (double)n / (32768.0 * 32768.0);
+    return ms > 1e-10 ? 10.0 * log10(ms) : -100.0;
+}
+
+/* Trim / compact pcm[0..n) in place. Returns the new length, 0 when
+ * there is no speech. `kept`, if given, receives where the survivors
+ * came from. */
+static size_t vad_compact(int16_t *pcm, size_t n, struct vad_stats *st,
+                          struct span_list *kept) {
+    struct vad_stats s = { .in = n };
+    size_t nframes = (n + VAD_FRAME - 1) / VAD_FRAME;
+    float *db = malloc(nframes * sizeof(float));
+    uint8_t *voiced = malloc(nframes);
+    unsigned short *zc = malloc(nframes * sizeof(unsigned short));
+    if (!db || !voiced || !zc) {     /* no memory: upload unchanged */
+        free(db); free(voiced); free(zc);
+        if (st) *st = (struct vad_stats){ .in = n, .out = n };
+        if (kept) span_add(kept, 0, n);
+        return n;
+    }
+
+    size_t hist[VAD_HIST_DB + 1] = {0};
+    for (size_t f = 0; f < nframes; f++) {
+        size_t off = f * VAD_FRAME;
+        size_t len = n - off < VAD_FRAME ? n - off : VAD_FRAME;
+        uint64_t e;
+        unsigned z;
+        vad_frame_stats(pcm + off, len, &e, &z);
+        db[f] = (float)vad_db(e, len);
+        zc[f] = (unsigned short)(z * VAD_FRAME / len);
+        int bin = (int)(db[f] + VAD_HIST_DB);
+        hist[bin < 0 ? 0 : bin > VAD_HIST_DB ? VAD_HIST_DB : bin]++;
+    }
+
+    size_t below = 0, pct = nframes / 10;
+    int bin = 0;
+    while (bin < VAD_HIST_DB && below + hist[bin] <= pct) below += hist[bin++];
+    s.floor_db = bin - VAD_HIST_DB;
+    if (s.floor_db > VAD_NOISE_MAX_DB) s.floor_db = VAD_NOISE_MAX_DB;
+    s.threshold_db = s.floor_db + cfg.vad_threshold_db;
+    if (s.threshold_db < VAD_FLOOR_DB) s.threshold_db = VAD_FLOOR_DB;
+
+    for (size_t f = 0; f < nframes; f++)
+        voiced[f] = db[f] >= s.threshold_db
+                 || (db[f] >= s.threshold_db - VAD_FRIC_DB && zc[f] >= VAD_FRIC_ZC);
+
+    /* drop blips */
+    for (size_t f = 0; f < nframes;) {
+        size_t e = f;
+        while (e < nframes && voiced[e] == voiced[f]) e++;
+        if (voiced[f] && e - f < VAD_MIN_RUN)
+            memset(voiced + f, 0, e - f);
+        else if (voiced[f])
+            s.voiced += e - f;
+        f = e;
+    }
+
+    size_t out = 0;
+    if (s.voiced * 10 >= VAD_MIN_SPEECH_MS) {
+        size_t pad = VAD_PAD_MS / 10;
+        size_t maxp = (size_t)cfg.vad_max_pause_ms / 10;
+        for (size_t f = 0; f < nframes;) {
+            size_t e = f;
+            while (e < nframes && voiced[e] == voiced[f]) e++;
+            /* [f, e) is one run; decide which frames of it survive */
+            size_t keep_a = e - f, keep_b = 0;     /* head / tail frames kept */
+            if (!voiced[f]) {
+                size_t g = e - f;
+                if (f == 0)              { keep_a = 0; keep_b = g < pad ? g : pad; }
+                else if (e == nframes)   { keep_a = g < pad ? g : pad; }
+                else if (g > maxp)       { keep_a = maxp / 2; keep_b = maxp - maxp / 2; }
+            }
+            size_t ranges[2][2] = { { f, f + keep_a }, { e - keep_b, e } };
+            for (int r = 0; r < 2; r++) {
+                size_t a = ranges[r][0] * VAD_FRAME, b = ranges[r][1] * VAD_FRAME;
+                if (b > n) b = n;
+                if (b <= a) continue;
+                memmove(pcm + out, pcm + a, (b - a) * sizeof(int16_t));
+                if (kept) span_add(kept, a, b - a);
+                out += b - a;
+            }
+            f = e;
+        }
+    }
+    s.out = out;
+    free(db);
+    free(voiced);
+    free(zc);
+    if (st) *st = s;
+    return out;
+}
+
+/* ── Endpoint detector ──────────────────────────────────────────────── */
+
+/*
+ * Online end-of-utterance detection for hands_free mode, fed every period
+ * by the capture loop. 10 ms frames are classified against a running
+ * noise floor (tracks down immediately, creeps up 5 dB/s); once speech has
+ * been heard, endpoint_ms of continuous silence ends the session. A press
+ * with no speech at all gives up after ENDPOINT_NO_SPEECH_MS.
+ */
+
+#define ENDPOINT_NO_SPEECH_MS 8000
+#define ENDPOINT_FLOOR_RISE   0.05   /* dB per frame */
+
+struct endpoint {
+    uint64_t energy;        /* current partial frame */
+    size_t   fill;
+    double   floor_db;
+    unsigned run;           /* consecutive speech frames */
+    int      heard;         /* a real speech run was seen */
+    unsigned silence_ms, elapsed_ms;
+};
+
+static void endpoint_reset(struct endpoint *ep) {
+    *ep = (struct endpoint){ .floor_db = 0 };
+}
+
+/* Feed captured samples. Returns 1 when the utterance is over (or never
+ * started), 0 while it is still going. */
+static int endpoint_feed(struct endpoint *ep, const int16_t *s, size_t n) {
+    while (n > 0) {
+        size_t take = VAD_FRAME - ep->fill;
+        if (take > n) take = n;
+        uint64_t e;
+        unsigned zc;
+        vad_frame_stats(s, take, &e, &zc);
+        ep->energy += e;
+        ep->fill += take;
+        s += take;
+        n -= take;
+        if (ep->fill < VAD_FRAME) break;
+
+        double db = vad_db(ep->energy, VAD_FRAME);
+        ep->energy = 0;
+        ep->fill = 0;
+        ep->elapsed_ms += 10;
+        if (ep->elapsed_ms == 10 || db < ep->floor_db) ep->floor_db = db;
+        else ep->floor_db += ENDPOINT_FLOOR_RISE;
+        if (ep->floor_db > VAD_NOISE_MAX_DB) ep->floor_db = VAD_NOISE_MAX_DB;
+
+        double thr = ep->floor_db + cfg.vad_threshold_db;
+        if (thr < VAD_FLOOR_DB) thr = VAD_FLOOR_DB;
+        if (db >= thr) {
+            if (++ep->run >= VAD_MIN_RUN) {
+                ep->heard = 1;
+                ep->silence_ms = 0;
+            }
+        } else {
+            ep->run = 0;
+            ep->silence_ms += 10;
+        }
+        if (ep->heard && ep->silence_ms >= (unsigned)cfg.endpoint_ms) return 1;
+        if (!ep->heard && ep->elapsed_ms >= ENDPOINT_NO_SPEECH_MS) return 1;
+    }
+    return 0;
+}
+
+/* ── ALSA capture subsystem ─────────────────────────────────────────── */
+
+/*
+ * One PCM handle is opened and configured at startup and one capture
+ * thread lives for the whole process. Hotkey presses arm it, releases
+ * disarm it — no snd_pcm_open / hw_params / pthread_create on the hot
+ * path. Between sessions the stream is dropped (stopped) but stays
+ * configured, so arming is just snd_pcm_prepare + snd_pcm_start.
+ *
+ * With preroll_ms > 0 the stream instead keeps running while idle and
+ * the last preroll_ms of audio sit in a small ring; on press that tail is
+ * spliced in front of the recording, so words spoken together with the
+ * key press survive. Idle reads are batched (IDLE_WAKE_FRAMES per wakeup)
+ * so the always-on ring costs a few wakeups per second.
+ *
+ * capture_access = mmap copies periods straight out of the DMA area with
+ * snd_pcm_mmap_begin/commit instead of snd_pcm_readi. Overruns are
+ * recovered and counted; xruns, dropped frames and the worst period
+ * latency are logged after every session.
+ *
+ * The device is opened at its own rate and channel count (ALSA's plug
+ * resampler is disabled); anything other than 16 kHz mono goes through
+ * the in-process resampler above before reaching pcm_buf.
+ *
+ * Consumers that want audio while the key is still held attach a
+ * pcm_ring with capture_attach() before arming; every captured period
+ * (and the pre-roll) is pushed to each attached ring and the rings are
+ * closed when the session ends.
+ */
+
+#define CAPTURE_MAX_TAPS 6
+
+#define IDLE_WAKE_FRAMES  4096      /* ~256 ms per idle wakeup */
+#define ALSA_BUFFER_FRAMES (4 * IDLE_WAKE_FRAMES)
+#define PREROLL_RING      (SAMPLE_RATE * PREROLL_MAX_MS / 1000 + 2 * IDLE_WAKE_FRAMES)
+
+/* Where audio comes from. read() blocks like snd_pcm_readi and returns
+ * interleaved S16 frames, 0 at end of input or a negative errno. */
+struct capture_source {
+    const char *name;
+    int  (*open)(unsigned *rate, unsigned *channels, snd_pcm_uframes_t *period);
+    int  (*start)(void);
+    snd_pcm_sframes_t (*read)(int16_t *dst, snd_pcm_uframes_t frames);
+    void (*stop)(void);
+    void (*close)(void);
+};
+
+struct capture_stats {
+    int    endpointed;        /* hands_free: ended by trailing silence */
+    double first_sample_ms;   /* press → first captured sample */
+    double preroll_ms;        /* audio spliced in from before the press */
+    unsigned xruns;           /* overruns recovered */
+    size_t   dropped;         /* frames lost to overruns (estimate) */
+    double   worst_period_ms; /* age of the oldest unread frame at read time */
+};
+
+static struct {
+    const struct capture_source *src;
+    char              src_arg[256]; /* path, fd or frequency after "name:" */
+    int               opened;    /* src->open succeeded */
+    snd_pcm_t        *pcm;       /* ALSA source only, NULL otherwise */
+    snd_pcm_uframes_t period;    /* device frames per read */
+    snd_pcm_uframes_t idle_frames; /* device frames per idle wakeup */
+    unsigned          rate, channels; /* what the device runs at */
+    int               convert;   /* not 16 kHz mono: resample in-process */
+    struct resampler  rs;
+    int16_t          *raw;       /* device frames before conversion */
+    size_t            raw_frames;
+    int16_t          *out;       /* converted idle batch */
+    int               use_mmap;  /* device accepted mmap access */
+    int               streaming; /* snd_pcm_start'ed and not dropped */
+    int               src_ended; /* the last source read hit end of input */
+    struct timespec   t_read;    /* last successful read, for drop estimates */
+    pthread_t         tid;
+    pthread_mutex_t   lock;
+    pthread_cond_t    cond;
+    int               armed;     /* main → thread: start a session */
+    int               running;   /* thread → main: session in progress */
+    int               quit;
+    struct timespec   t_arm;     /* when the hotkey press armed us */
+    struct capture_stats stats;  /* last session */
+    struct endpoint   ep;        /* hands_free end-of-utterance */
+    int               done_fd;   /* eventfd: a session ended on its own */
+    struct pcm_ring  *taps[CAPTURE_MAX_TAPS]; /* changed only while idle */
+    int               ntaps;
+    /* pre-roll ring — touched only by the capture thread */
+    int16_t           ring[PREROLL_RING];
+    size_t            ring_pos;  /* next write index */
+    size_t            ring_fill;
+} cap = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .done_fd = -1,
+};
+
+/* ALSA source: the configured PCM at its native rate. Sets cap.pcm,
+ * which also enables the pre-roll idle loop and xrun recovery. */
+static int alsa_open(unsigned *rate_out, unsigned *channels_out,
+                     snd_pcm_uframes_t *period_out) {
+    snd_pcm_t *pcm;
+    int err;
+
+    if ((err = snd_pcm_open(&pcm, cfg.capture_device, SND_PCM_STREAM_CAPTURE, 0)) < 0) {
+        fprintf(stderr, "dictator: ALSA open %s: %s\n", cfg.capture_device, snd_strerror(err));
+        return -1;
+    }
+
+    snd_pcm_hw_params_t *params;
+    snd_pcm_hw_params_alloca(&params);
+    snd_pcm_hw_params_any(pcm, params);
+    int use_mmap = 0;
+    if (cfg.capture_mmap) {
+        use_mmap = snd_pcm_hw_params_set_access(pcm, params,
+                                                SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0;
+        if (!use_mmap)
+            fprintf(stderr, "dictator: ALSA device has no mmap access, using readi\n");
+    }
+    if (!use_mmap)
+        snd_pcm_hw_params_set_access(pcm, params, SND_PCM_ACCESS_RW_INTERLEAVED);
+    snd_pcm_hw_params_set_format(pcm, params, SND_PCM_FORMAT_S16_LE);
+    /* native rate: we resample ourselves, cheaper than plug or the server */
+    snd_pcm_hw_params_set_rate_resample(pcm, params, 0);
+    unsigned int channels = CHANNELS;
+    snd_pcm_hw_params_set_channels_near(pcm, params, &channels);
+    unsigned int rate = cfg.capture_rate ? (unsigned)cfg.capture_rate : SAMPLE_RATE;
+    snd_pcm_hw_params_set_rate_near(pcm, params, &rate, NULL);
+    /* keep ~64 ms periods and the idle batch size whatever the rate */
+    snd_pcm_uframes_t period = (snd_pcm_uframes_t)PERIOD_FRAMES * rate / SAMPLE_RATE;
+    snd_pcm_hw_params_set_period_size_near(pcm, params, &period, NULL);
+    /* room for a whole idle batch plus slack */
+    snd_pcm_uframes_t bufsize = (snd_pcm_uframes_t)ALSA_BUFFER_FRAMES * rate / SAMPLE_RATE;
+    snd_pcm_hw_params_set_buffer_size_near(pcm, params, &bufsize);
+
+    if ((err = snd_pcm_hw_params(pcm, params)) < 0) {
+        fprintf(stderr, "dictator: ALSA params: %s\n", snd_strerror(err));
+        snd_pcm_close(pcm);
+        return -1;
+    }
+    /* hw_params leaves the stream PREPARED; keep it idle until armed */
+    snd_pcm_drop(pcm);
+
+    cap.pcm = pcm;
+    cap.use_mmap = use_mmap;
+    *rate_out = rate;
+    *channels_out = channels;
+    *period_out = period;
+    return 0;
+}
+
+static void alsa_close(void) {
+    if (cap.pcm) snd_pcm_close(cap.pcm);
+    cap.pcm = NULL;
+}
+
+/* Wake the reader every `frames` frames: one period while recording,
+ * a large batch while idling on the pre-roll ring */
+static void capture_set_avail_min(snd_pcm_uframes_t frames) {
+    snd_pcm_sw_params_t *sw;
+    snd_pcm_sw_params_alloca(&sw);
+    snd_pcm_sw_params_current(cap.pcm, sw);
+    snd_pcm_sw_params_set_avail_min(cap.pcm, sw, frames);
+    snd_pcm_sw_params(cap.pcm, sw);
+}
+
+static int alsa_start(void) {
+    int err;
+    if ((err = snd_pcm_prepare(cap.pcm)) < 0 || (err = snd_pcm_start(cap.pcm)) < 0) {
+        fprintf(stderr, "dictator: ALSA start: %s\n", snd_strerror(err));
+        return -1;
+    }
+    return 0;
+}
+
+static void alsa_stop(void) {
+    snd_pcm_drop(cap.pcm);
+}
+
+/* Read `frames` interleaved device frames into dst, blocking like
+ * snd_pcm_readi. In mmap mode the samples are copied straight out of the
+ * DMA area. Returns frames read or a negative ALSA error (-EPIPE on
+ * overrun). */
+static snd_pcm_sframes_t alsa_read(int16_t *dst, snd_pcm_uframes_t frames) {
+    if (!cap.use_mmap)
+        return snd_pcm_readi(cap.pcm, dst, frames);
+
+    snd_pcm_uframes_t done = 0;
+    while (done < frames) {
+        snd_pcm_sframes_t avail = snd_pcm_avail_update(cap.pcm);
+        if (avail < 0) return avail;
+        if ((snd_pcm_uframes_t)avail < frames - done) {
+            int w = snd_pcm_wait(cap.pcm, 1000);
+            if (w < 0) return w;
+            if (w == 0) return -EIO; /* no data for a second */
+            continue;
+        }
+        const snd_pcm_channel_area_t *areas;
+        snd_pcm_uframes_t offset, n = frames - done;
+        int err = snd_pcm_mmap_begin(cap.pcm, &areas, &offset, &n);
+        if (err < 0) return err;
+        /* interleaved: channel 0's area walks whole frames */
+        size_t frame_bytes = (size_t)cap.channels * FRAME_SIZE;
+        const uint8_t *src = (const uint8_t *)areas[0].addr
+                           + (areas[0].first + offset * areas[0].step) / 8;
+        if (areas[0].step == 8 * frame_bytes) {
+            memcpy(dst + done * cap.channels, src, n * frame_bytes);
+        } else {
+            for (snd_pcm_uframes_t i = 0; i < n; i++)
+                memcpy(dst + (done + i) * cap.channels,
+                       src + i * (areas[0].step / 8), frame_bytes);
+        }
+        snd_pcm_sframes_t c = snd_pcm_mmap_commit(cap.pcm, offset, n);
+        if (c < 0) return c;
+        if ((snd_pcm_uframes_t)c != n) return -EPIPE;
+        done += n;
+    }
+    return (snd_pcm_sframes_t)done;
+}
+
+/* File sources: a WAV file (any rate, channels; 16-bit PCM), a raw S16LE
+ * file or FIFO, or an inherited fd carrying raw S16LE. Raw input is mono
+ * at capture_rate (16 kHz if unset). WAV files are paced to real time like
+ * a microphone and replay from the start on every press; raw input is
+ * read as fast as the writer delivers it. */
+static struct {
+    int      fd;
+    int      owned;          /* opened by us, close on shutdown */
+    int      pace;           /* deliver at real time */
+    off_t    data_off;       /* start of sample data */
+    uint64_t data_len;       /* bytes, UINT64_MAX = until EOF */
+    uint64_t data_left;
+    struct timespec t0;      /* pacing epoch */
+    uint64_t frames;         /* delivered since start */
+} srcf = { .fd = -1 };
+
+/* Sleep until `frames` frames at `rate` would have been captured */
+static void source_pace(const struct timespec *t0, uint64_t frames, unsigned rate) {
+    struct timespec due = *t0;
+    due.tv_sec  += (time_t)(frames / rate);
+    due.tv_nsec += (long)((frames % rate) * 1000000000ull / rate);
+    if (due.tv_nsec >= 1000000000L) { due.tv_sec++; due.tv_nsec -= 1000000000L; }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR)
+        ;
+}
+
+static int read_full(int fd, void *buf, size_t n) {
+    size_t got = 0;
+    while (got < n) {
+        ssize_t r = read(fd, (uint8_t *)buf + got, n - got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        got += (size_t)r;
+    }
+    return (int)got;
+}
+
+static uint32_t rd_le32(const uint8_t *p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* Walk the RIFF chunks up to "data"; accepts PCM and EXTENSIBLE 16-bit */
+static int wav_parse_header(int fd, unsigned *rate, unsigned *channels) {
+    uint8_t h[12];
+    if (read_full(fd, h, 12) != 12 || memcmp(h, "RIFF", 4) || memcmp(h + 8, "WAVE", 4))
+        return -1;
+    int have_fmt = 0;
+    for (;;) {
+        uint8_t ck[8];
+        if (read_full(fd, ck, 8) != 8) return -1;
+        uint32_t size = rd_le32(ck + 4);
+        if (memcmp(ck, "fmt ", 4) == 0) {
+            uint8_t f[16];
+            if (size < 16 || read_full(fd, f, 16) != 16) return -1;
+            unsigned format = f[0] | f[1] << 8;
+            *channels = f[2] | f[3] << 8;
+            *rate = rd_le32(f + 4);
+            unsigned bits = f[14] | f[15] << 8;
+            if ((format != 1 && format != 0xFFFE) || bits != 16 || !*channels || !*rate)
+                return -1;
+            if (lseek(fd, (off_t)(size - 16 + (size & 1)), SEEK_CUR) < 0) return -1;
+            have_fmt = 1;
+        } else if (memcmp(ck, "data", 4) == 0) {
+            if (!have_fmt) return -1;
+            srcf.data_off = lseek(fd, 0, SEEK_CUR);
+            /* streamed WAVs leave the size at 0 or 0xFFFFFFFF */
+            srcf.data_len = (size == 0 || size == 0xFFFFFFFFu) ? UINT64_MAX : size;
+            return 0;
+        } else if (lseek(fd, (off_t)size + (size & 1), SEEK_CUR) < 0) {
+            return -1;
+        }
+    }
+}
+
+static int file_open(unsigned *rate, unsigned *channels, snd_pcm_uframes_t *period) {
+    const char *arg = cap.src_arg;
+    int is_wav = strcmp(cap.src->name, "wav") == 0;
+    if (strcmp(cap.src->name, "fd") == 0) {
+        srcf.fd = atoi(arg);
+        srcf.owned = 0;
+    } else {
+        srcf.fd = open(arg, O_RDONLY | O_CLOEXEC);
+        srcf.owned = 1;
+    }
+    if (srcf.fd < 0) {
+        fprintf(stderr, "dictator: capture source %s:%s: %s\n",
+                cap.src->name, arg, strerror(errno));
+        return -1;
+    }
+    if (is_wav) {
+        if (wav_parse_header(srcf.fd, rate, channels) < 0) {
+            fprintf(stderr, "dictator: %s: not a 16-bit PCM WAV file\n", arg);
+            if (srcf.owned) close(srcf.fd);
+            srcf.fd = -1;
+            return -1;
+        }
+        srcf.pace = 1;
+    } else {
+        *rate = cfg.capture_rate ? (unsigned)cfg.capture_rate : SAMPLE_RATE;
+        *channels = CHANNELS;
+        srcf.data_off = 0;
+        srcf.data_len = UINT64_MAX;
+        srcf.pace = 0;
+    }
+    srcf.data_left = srcf.data_len;
+    *period = (snd_pcm_uframes_t)PERIOD_FRAMES * *rate / SAMPLE_RATE;
+    return 0;
+}
+
+static void file_close(void) {
+    if (srcf.owned && srcf.fd >= 0) close(srcf.fd);
+    srcf.fd = -1;
+}
+
+static int file_start(void) {
+    /* replay from the top; pipes cannot seek and just continue */
+    if (lseek(srcf.fd, srcf.data_off, SEEK_SET) >= 0)
+        srcf.data_left = srcf.data_len;
+    srcf.frames = 0;
+    clock_gettime(CLOCK_MONOTONIC, &srcf.t0);
+    return 0;
+}
+
+static void file_stop(void) {}
+
+static snd_pcm_sframes_t file_read(int16_t *dst, snd_pcm_uframes_t frames) {
+    size_t frame_bytes = (size_t)cap.channels * FRAME_SIZE;
+    size_t want = frames * frame_bytes;
+    if (want > srcf.data_left) want = (size_t)(srcf.data_left / frame_bytes * frame_bytes);
+    if (want == 0) return 0;
+    int got = read_full(srcf.fd, dst, want);
+    snd_pcm_sframes_t n = (snd_pcm_sframes_t)((size_t)got / frame_bytes);
+    if (srcf.data_left != UINT64_MAX) srcf.data_left -= (uint64_t)got;
+    srcf.frames += (uint64_t)n;
+    if (srcf.pace) source_pace(&srcf.t0, srcf.frames, cap.rate);
+    return n;
+}
+
+/* Synthetic sources: a sine ("tone:HZ", 440 Hz by default) or white
+ * noise at -12 dBFS, mono at capture_rate (16 kHz if unset), paced to
+ * real time. The noise generator is seeded identically every press, so
+ * runs are reproducible. */
+#define SYNTH_AMPLITUDE 8192
+
+static struct {
+    int      noise;
+    double   hz, phase;
+    uint32_t rng;
+    struct timespec t0;
+    uint64_t frames;
+} srcs;
+
+static int synth_open(unsigned *rate, unsigned *channels, snd_pcm_uframes_t *period) {
+    srcs.noise = strcmp(cap.src->name, "noise") == 0;
+    srcs.hz = cap.src_arg[0] ? atof(cap.src_arg) : 440.0;
+    *rate = cfg.capture_rate ? (unsigned)cfg.capture_rate : SAMPLE_RATE;
+    *channels = CHANNELS;
+    if (!srcs.noise && (srcs.hz <= 0 || srcs.hz >= *rate / 2.0)) {
+        fprintf(stderr, "dictator: tone frequency must be below %u Hz\n", *rate / 2);
+        return -1;
+    }
+    *period = (snd_pcm_uframes_t)PERIOD_FRAMES * *rate / SAMPLE_RATE;
+    return 0;
+}
+
+static void synth_close(void) {}
+
+static int synth_start(void) {
+    srcs.phase = 0;
+    srcs.rng = 0x9E3779B9u;
+    srcs.frames = 0;
+    clock_gettime(CLOCK_MONOTONIC, &srcs.t0);
+    return 0;
+}
+
+static snd_pcm_sframes_t synth_read(int16_t *dst, snd_pcm_uframes_t frames) {
+    double step = 2 * M_PI * srcs.hz / cap.rate;
+    for (snd_pcm_uframes_t i = 0; i < frames; i++) {
+        if (srcs.noise) {
+            srcs.rng ^= srcs.rng << 13;   /* xorshift32 */
+            srcs.rng ^= srcs.rng >> 17;
+            srcs.rng ^= srcs.rng << 5;
+            dst[i] = (int16_t)((int32_t)(srcs.rng % (2 * SYNTH_AMPLITUDE + 1)) - SYNTH_AMPLITUDE);
+        } else {
+            dst[i] = (int16_t)lrint(SYNTH_AMPLITUDE * sin(srcs.phase));
+            srcs.phase += step;
+            if (srcs.phase >= 2 * M_PI) srcs.phase -= 2 * M_PI;
+        }
+    }
+    srcs.frames += frames;
+    source_pace(&srcs.t0, srcs.frames, cap.rate);
+    return (snd_pcm_sframes_t)frames;
+}
+
+static const struct capture_source capture_sources[] = {
+    { "alsa",  alsa_open,  alsa_start,  alsa_read,  alsa_stop, alsa_close  },
+    { "wav",   file_open,  file_start,  file_read,  file_stop, file_close  },
+    { "raw",   file_open,  file_start,  file_read,  file_stop, file_close  },
+    { "fd",    file_open,  file_start,  file_read,  file_stop, file_close  },
+    { "tone",  synth_open, synth_start, synth_read, file_stop, synth_close },
+    { "noise", synth_open, synth_start, synth_read, file_stop, synth_close },
+};
+
+/* Pick the source for a capture_source / --source spec ("NAME[:ARG]").
+ * Only before capture_init. */
+static int capture_select_source(const char *spec) {
+    size_t nlen = strcspn(spec, ":");
+    if (nlen == 0) { spec = "alsa"; nlen = 4; }
+    for (size_t i = 0; i < sizeof(capture_sources) / sizeof(capture_sources[0]); i++) {
+        const struct capture_source *s = &capture_sources[i];
+        if (strlen(s->name) == nlen && strncmp(spec, s->name, nlen) == 0) {
+            const char *arg = spec[nlen] == ':' ? spec + nlen + 1 : "";
+            if (!arg[0] && (s->open == file_open)) break;   /* needs a path / fd */
+            cap.src = s;
+            snprintf(cap.src_arg, sizeof(cap.src_arg), "%s", arg);
+            return 0;
+        }
+    }
+    fprintf(stderr, "dictator: bad capture source '%s' "
+            "(alsa, wav:PATH, raw:PATH, fd:N, tone[:HZ], noise)\n", spec);
+    return -1;
+}
+
+/* Open the selected source and set up conversion to 16 kHz mono */
+static int capture_open(void) {
+    unsigned rate, channels;
+    snd_pcm_uframes_t period;
+    if (cap.src->open(&rate, &channels, &period) < 0)
+        return -1;
+
+    cap.idle_frames = (snd_pcm_uframes_t)IDLE_WAKE_FRAMES * rate / SAMPLE_RATE;
+    cap.convert = rate != SAMPLE_RATE || channels != CHANNELS;
+    if (cap.convert) {
+        cap.raw_frames = cap.idle_frames > period ? cap.idle_frames : period;
+        cap.raw = malloc(cap.raw_frames * channels * FRAME_SIZE);
+        if (!cap.raw || resampler_init(&cap.rs, rate, SAMPLE_RATE) < 0) {
+            fprintf(stderr, "dictator: cannot resample %u Hz capture\n", rate);
+            free(cap.raw);
+            cap.raw = NULL;
+            cap.convert = 0;
+            cap.src->close();
+            return -1;
+        }
+        cap.out = malloc(resampler_max_out(&cap.rs, cap.raw_frames) * sizeof(int16_t));
+        if (!cap.out) {
+            resampler_free(&cap.rs);
+            free(cap.raw);
+            cap.raw = NULL;
+            cap.convert = 0;
+            cap.src->close();
+            return -1;
+        }
+        printf("dictator: capture %u Hz × %u ch, resampling to %d Hz mono in-process (%u taps/phase)\n",
+               rate, channels, SAMPLE_RATE, cap.rs.taps);
+    }
+
+    cap.period = period;
+    cap.rate = rate;
+    cap.channels = channels;
+    cap.streaming = 0;
+    cap.opened = 1;
+    return 0;
+}
+
+static void capture_close(void) {
+    if (cap.opened) cap.src->close();
+    cap.opened = 0;
+    cap.streaming = 0;
+    if (cap.convert) {
+        resampler_free(&cap.rs);
+        free(cap.raw);
+        free(cap.out);
+        cap.raw = cap.out = NULL;
+        cap.convert = 0;
+    }
+}
+
+static int capture_stream_start(void) {
+    if (cap.streaming) return 0;
+    if (cap.src->start() < 0) {
+        capture_close(); /* reopen on next press */
+        return -1;
+    }
+    if (cap.convert) resampler_reset(&cap.rs);
+    cap.src_ended = 0;
+    cap.streaming = 1;
+    return 0;
+}
+
+static void capture_stream_stop(void) {
+    if (!cap.streaming) return;
+    cap.src->stop();
+    cap.streaming = 0;
+}
+
+/* Hand freshly captured samples to every attached consumer */
+static void capture_publish(const int16_t *samples, size_t n) {
+    for (int i = 0; i < cap.ntaps; i++)
+        pcm_ring_write(cap.taps[i], samples, n);
+}
+
+/* Read up to `frames` source frames and deliver them as 16 kHz mono into
+ * dst, which must hold capture_max_out(frames). Returns samples written
+ * or a negative error. 0 can also mean the resampler is still filling
+ * its window; cap.src_ended tells the end of a file source apart. */
+static snd_pcm_sframes_t capture_pull(int16_t *dst, snd_pcm_uframes_t frames) {
+    if (!cap.convert) {
+        snd_pcm_sframes_t n = cap.src->read(dst, frames);
+        cap.src_ended = n == 0;
+        return n;
+    }
+    if (frames > cap.raw_frames) frames = cap.raw_frames;
+    snd_pcm_sframes_t n = cap.src->read(cap.raw, frames);
+    cap.src_ended = n == 0;
+    if (n <= 0) return n;
+    return (snd_pcm_sframes_t)resampler_process(&cap.rs, cap.raw, (size_t)n,
+                                                cap.channels, dst);
+}
+
+static size_t capture_max_out(snd_pcm_uframes_t frames) {
+    return cap.convert ? resampler_max_out(&cap.rs, frames) : frames;
+}
+
+/* Restart after an overrun or suspend. Everything since the last good
+ * read is gone — the buffer was full and prepare discards it. */
+static int capture_recover(int err, struct capture_stats *st) {
+    if (st) {
+        double gap = ms_since(&cap.t_read);
+        st->xruns++;
+        st->dropped += (size_t)(gap * SAMPLE_RATE / 1000);
+    }
+    if ((err = snd_pcm_recover(cap.pcm, err, 1)) < 0 ||
+        ((err = snd_pcm_start(cap.pcm)) < 0 && err != -EBADFD)) {
+        fprintf(stderr, "dictator: ALSA recover: %s\n", snd_strerror(err));
+        capture_close();
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &cap.t_read);
+    return 0;
+}
+
+static void capture_ring_advance(size_t n) {
+    cap.ring_pos = (cap.ring_pos + n) % PREROLL_RING;
+    cap.ring_fill += n;
+    if (cap.ring_fill > PREROLL_RING) cap.ring_fill = PREROLL_RING;
+}
+
+static void capture_ring_push(const int16_t *s, size_t n) {
+    if (n > PREROLL_RING) { s += n - PREROLL_RING; n = PREROLL_RING; }
+    size_t first = PREROLL_RING - cap.ring_pos;
+    if (first > n) first = n;
+    memcpy(cap.ring + cap.ring_pos, s, first * sizeof(int16_t));
+    memcpy(cap.ring, s + first, (n - first) * sizeof(int16_t));
+    capture_ring_advance(n);
+}
+
+/* Pull everything ALSA has buffered into the pre-roll ring. Blocks until
+ * an idle batch is ready when `wait` is set. Returns -1 if the device died. */
+static int capture_fill_ring(int wait) {
+    if (wait) /* errors (xrun, suspend) surface via avail_update below */
+        snd_pcm_wait(cap.pcm, (int)(2 * cap.idle_frames * 1000 / cap.rate));
+    for (;;) {
+        snd_pcm_sframes_t avail = snd_pcm_avail_update(cap.pcm);
+        if (avail == -EPIPE || avail == -ESTRPIPE)
+            return capture_recover((int)avail, NULL);
+        if (avail < 0) {
+            fprintf(stderr, "dictator: ALSA idle read: %s\n", snd_strerror((int)avail));
+            capture_close();
+            return -1;
+        }
+        if (avail == 0) return 0;
+        snd_pcm_sframes_t n;
+        if (cap.convert) {
+            n = capture_pull(cap.out, (snd_pcm_uframes_t)avail);
+            if (n > 0) capture_ring_push(cap.out, (size_t)n);
+        } else {
+            size_t room = PREROLL_RING - cap.ring_pos; /* contiguous up to wrap */
+            snd_pcm_uframes_t want = (size_t)avail < room ? (snd_pcm_uframes_t)avail : room;
+            n = alsa_read(cap.ring + cap.ring_pos, want);
+            if (n > 0) capture_ring_advance((size_t)n);
+        }
+        if (n == -EPIPE || n == -ESTRPIPE)
+            return capture_recover((int)n, NULL);
+        if (n <= 0) return 0;
+    }
+}
+
+/* Idle with a warm stream: keep the last preroll_ms in the ring */
+static void capture_idle(void) {
+    if (!cap.streaming) {
+        cap.ring_pos = cap.ring_fill = 0;
+        if (capture_stream_start() < 0) return;
+        capture_set_avail_min(cap.idle_frames);
+    }
+    capture_fill_ring(1);
+}
+
+/* Copy the pre-roll tail to the front of pcm_buf. The thread may wake up
+ * to IDLE_WAKE_FRAMES after the press, so everything since the press is
+ * taken on top of preroll_ms. */
+static void capture_splice_preroll(void) {
+    if (capture_fill_ring(0) < 0) return;
+    size_t want = (size_t)cfg.preroll_ms * SAMPLE_RATE / 1000
+                + (size_t)(ms_since(&cap.t_arm) * SAMPLE_RATE / 1000);
+    if (want > cap.ring_fill) want = cap.ring_fill;
+    if (pcm_store_reserve(want) < 0) want = 0;
+    size_t start = (cap.ring_pos + PREROLL_RING - want) % PREROLL_RING;
+    size_t first = PREROLL_RING - start;
+    if (first > want) first = want;
+    memcpy(pcm_buf, cap.ring + start, first * sizeof(int16_t));
+    memcpy(pcm_buf + first, cap.ring, (want - first) * sizeof(int16_t));
+    pcm_pos = want;
+    capture_publish(pcm_buf, want);
+    if (cfg.hands_free) /* primes the noise floor */
+        endpoint_feed(&cap.ep, pcm_buf, want);
+    cap.ring_pos = cap.ring_fill = 0;
+    cap.stats.first_sample_ms = 0;
+    cap.stats.preroll_ms = (double)want * 1000.0 / SAMPLE_RATE;
+}
+
+/* Capture one session into pcm_buf until disarmed or max_duration is hit */
+static void capture_session(void) {
+    pcm_pos = 0;
+    cap.stats = (struct capture_stats){ .first_sample_ms = -1 };
+    endpoint_reset(&cap.ep);
+
+    if (cap.streaming) {
+        capture_splice_preroll();
+        if (!cap.opened) return;
+    } else if (capture_stream_start() < 0) {
+        return;
+    }
+    if (cap.pcm) capture_set_avail_min(cap.period);
+    clock_gettime(CLOCK_MONOTONIC, &cap.t_read);
+
+    snd_pcm_t *pcm = cap.pcm;
+    snd_pcm_uframes_t period = cap.period;
+    size_t out_period = capture_max_out(period);
+    int warned = 0;
+    size_t max_samples = (size_t)(SAMPLE_RATE * cfg.max_duration);
+    while (recording && pcm_pos + out_period <= max_samples) {
+        if (pcm_store_reserve(pcm_pos + out_period) < 0) {
+            notify("Recording stopped — cannot grow capture store (disk full?)");
+            break;
+        }
+        snd_pcm_sframes_t n = capture_pull(pcm_buf + pcm_pos, period);
+        if (pcm && (n == -EPIPE || n == -ESTRPIPE)) {
+            if (capture_recover((int)n, &cap.stats) < 0) return;
+            continue;
+        }
+        if (n == 0 && !pcm && cap.src_ended) {
+            printf("dictator: capture source %s ended\n", cap.src->name);
+            break;
+        }
+        if (n < 0) {
+            fprintf(stderr, "dictator: capture read: %s\n", snd_strerror((int)n));
+            capture_close(); /* device gone? reopen on next press */
+            return;
+        }
+        if (cap.stats.first_sample_ms < 0 && n > 0) {
+            /* readi returns once a whole period is in; its first sample
+             * arrived n frames earlier */
+            double ms = ms_since(&cap.t_arm) - (double)n * 1000.0 / SAMPLE_RATE;
+            cap.stats.first_sample_ms = ms > 0 ? ms : 0;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &cap.t_read);
+        /* what is still queued behind this period tells how late we are */
+        snd_pcm_sframes_t backlog = pcm ? snd_pcm_avail_update(pcm) : 0;
+        if (backlog >= 0) {
+            double age = (double)n * 1000.0 / SAMPLE_RATE
+                       + (double)backlog * 1000.0 / cap.rate;
+            if (age > cap.stats.worst_period_ms) cap.stats.worst_period_ms = age;
+        }
+        capture_publish(pcm_buf + pcm_pos, (size_t)n);
+        int done = cfg.hands_free && endpoint_feed(&cap.ep, pcm_buf + pcm_pos, (size_t)n);
+        pcm_pos += (size_t)n;
+        pcm_store_release(pcm_pos);
+        if (done) {
+            cap.stats.endpointed = 1;
+            break;
+        }
+        if (!warned && pcm_pos >= (size_t)(SAMPLE_RATE * (cfg.max_duration - 10))) {
+            char msg[128];
+            snprintf(msg, sizeof(msg),
+                     "Recording limit approaching (max_duration=%ds)",
+                     cfg.max_duration);
+            notify(msg);
+            warned = 1;
+        }
+    }
+    if (pcm_pos + out_period > max_samples) {
+        notify("Recording limit reached — set max_duration in /etc/dictator.conf to increase");
+    }
+
+    if (cfg.preroll_ms > 0 && pcm) {
+        /* stay warm; the ring starts over so it never replays this session */
+        cap.ring_pos = cap.ring_fill = 0;
+        capture_set_avail_min(cap.idle_frames);
+    } else {
+        capture_stream_stop();
+    }
+}
+
+/* Optional SCHED_FIFO / SCHED_RR for the capture thread. Needs rtkit,
+ * CAP_SYS_NICE or an rtprio limit; without them we log and carry on. */
+static void capture_set_sched(void) {
+    if (cfg.capture_sched == SCHED_OTHER) return;
+    struct sched_param sp = { .sched_priority = cfg.capture_priority };
+    int err = pthread_setschedparam(pthread_self(), cfg.capture_sched, &sp);
+    if (err)
+        fprintf(stderr, "dictator: capture realtime priority: %s\n", strerror(err));
+    else
+        printf("dictator: capture thread %s priority %d\n",
+               cfg.capture_sched == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_RR",
+               cfg.capture_priority);
+}
+
+static void *capture_thread(void *arg) {
+    (void)arg;
+    capture_set_sched();
+    pthread_mutex_lock(&cap.lock);
+    for (;;) {
+        while (!cap.armed && !cap.quit) {
+            if (cfg.preroll_ms > 0 && cap.pcm) {
+                pthread_mutex_unlock(&cap.lock);
+                capture_idle();
+                pthread_mutex_lock(&cap.lock);
+            } else {
+                pthread_cond_wait(&cap.cond, &cap.lock);
+            }
+        }
+        if (cap.quit) break;
+        cap.running = 1;
+        pthread_mutex_unlock(&cap.lock);
+
+        if (cap.opened || capture_open() == 0)
+            capture_session();
+        for (int i = 0; i < cap.ntaps; i++)
+            pcm_ring_close(cap.taps[i]);
+        if (recording) /* not disarmed: tell the hotkey loop to hand off */
+            eventfd_write(cap.done_fd, 1);
+
+        pthread_mutex_lock(&cap.lock);
+        cap.armed = 0;   /* one session per arm, even if it ended early */
+        cap.running = 0;
+        pthread_cond_broadcast(&cap.cond);
+    }
+    pthread_mutex_unlock(&cap.lock);
+    return NULL;
+}
+
+/* Open the device and start the capture thread. A missing device is not
+ * fatal: the thread retries the open on the next hotkey press. */
+static int capture_init(void) {
+    if (capture_select_source(cfg.capture_source) < 0)
+        return -1;
+    cap.done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (cap.done_fd < 0) {
+        perror("dictator: eventfd");
+        return -1;
+    }
+    if (capture_open() < 0)
+        fprintf(stderr, "dictator: no capture device yet, will retry on key press\n");
+    else if (!cap.pcm)
+        printf("dictator: capture source %s%s%s\n", cap.src->name,
+               cap.src_arg[0] ? ":" : "", cap.src_arg);
+    if (pthread_create(&cap.tid, NULL, capture_thread, NULL) != 0) {
+        perror("dictator: pthread_create");
+        capture_close();
+        close(cap.done_fd);
+        cap.done_fd = -1;
+        return -1;
+    }
+    if (cfg.preroll_ms > 0)
+        printf("dictator: pre-roll %d ms (capture stream stays open)\n", cfg.preroll_ms);
+    return 0;
+}
+
+static void capture_shutdown(void) {
+    pthread_mutex_lock(&cap.lock);
+    cap.quit = 1;
+    recording = 0;
+    pthread_cond_broadcast(&cap.cond);
+    pthread_mutex_unlock(&cap.lock);
+    pthread_join(cap.tid, NULL);
+    capture_close();
+    if (cap.done_fd >= 0) close(cap.done_fd);
+    cap.done_fd = -1;
+}
+
+/* Attach / detach a consumer ring. Only between sessions: the capture
+ * thread reads the tap list without a lock while running. */
+static int capture_attach(struct pcm_ring *r) {
+    int rc = -1;
+    pthread_mutex_lock(&cap.lock);
+    if (!cap.running && cap.ntaps < CAPTURE_MAX_TAPS) {
+        cap.taps[cap.ntaps++] = r;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&cap.lock);
+    return rc;
+}
+
+static void capture_detach(struct pcm_ring *r) {
+    pthread_mutex_lock(&cap.lock);
+    while (cap.running)
+        pthread_cond_wait(&cap.cond, &cap.lock);
+    for (int i = 0; i < cap.ntaps; i++) {
+        if (cap.taps[i] == r) {
+            cap.taps[i] = cap.taps[--cap.ntaps];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cap.lock);
+}
+
+/* Consume the "session ended on its own" event behind cap.done_fd.
+ * Returns 1 if there was one. */
+static int capture_ended(void) {
+    eventfd_t v;
+    return eventfd_read(cap.done_fd, &v) == 0;
+}
+
+/* Hotkey pressed: start filling pcm_buf and the attached rings */
+static void capture_arm(void) {
+    pthread_mutex_lock(&cap.lock);
+    /* the last take may have ended on its own as it was being stopped;
+     * that event must not end this one */
+    capture_ended();
+    clock_gettime(CLOCK_MONOTONIC, &cap.t_arm);
+    for (int i = 0; i < cap.ntaps; i++)
+        pcm_ring_reset(cap.taps[i]);
+    pcm_store_reset();
+    recording = 1;
+    cap.armed = 1;
+    pthread_cond_broadcast(&cap.cond);
+    pthread_mutex_unlock(&cap.lock);
+}
+
+/* Armed session still going? For runs that end on their own (file
+ * source EOF, max_duration) rather than on key release. */
+static int capture_busy(void) {
+    pthread_mutex_lock(&cap.lock);
+    int busy = cap.armed || cap.running;
+    pthread_mutex_unlock(&cap.lock);
+    return busy;
+}
+
+/* Hotkey released: stop and wait until the thread no longer touches
+ * pcm_buf / pcm_pos, so the caller may read them */
+static void capture_disarm(void) {
+    pthread_mutex_lock(&cap.lock);
+    recording = 0;
+    cap.armed = 0;
+    while (cap.running)
+        pthread_cond_wait(&cap.cond, &cap.lock);
+    /* also covers a press released before the thread picked it up */
+    for (int i = 0; i < cap.ntaps; i++)
+        pcm_ring_close(cap.taps[i]);
+    pthread_mutex_unlock(&cap.lock);
+
+    const struct capture_stats *st = &cap.stats;
+    if (st->endpointed)
+        printf("dictator: endpoint after %d ms of silence\n", cfg.endpoint_ms);
+    if (st->preroll_ms > 0)
+        printf("dictator: press→first sample 0 ms (%.0f ms pre-roll)\n",
+               st->preroll_ms);
+    else if (st->first_sample_ms >= 0)
+        printf("dictator: press→first sample %.1f ms\n", st->first_sample_ms);
+    printf("dictator: capture %s: %u xruns, %zu frames dropped (%.0f ms), "
+           "worst period %.1f ms\n",
+           !cap.pcm ? cap.src->name : cap.use_mmap ? "mmap" : "readi",
+           st->xruns, st->dropped,
+           (double)st->dropped * 1000.0 / SAMPLE_RATE, st->worst_period_ms);
+    if (st->xruns) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Audio dropouts: %.0f ms lost to %u overrun%s",
+                 (double)st->dropped * 1000.0 / SAMPLE_RATE, st->xruns,
+                 st->xruns == 1 ? "" : "s");
+        notify(msg);
+    }
+}
+
+/* ── Input level monitor ────────────────────────────────────────────── */
+
+/*
+ * First consumer of the capture rings: follows the live signal while the
+ * key is held and warns within a second when the microphone is muted or
+ * unplugged, instead of after the upload comes back empty.
+ */
+
+#define METER_SILENT_PEAK 64       /* below this the input is dead */
+#define METER_CHECK_MS    1000
+
+static struct {
+    struct pcm_ring ring;
+    pthread_t       tid;
+    int             active;
+    int             peak;          /* session peak, read after join */
+} meter;
+
+static void *meter_thread(void *arg) {
+    (void)arg;
+    int16_t buf[PERIOD_FRAMES];
+    size_t seen = 0;
+    int warned = 0;
+    meter.peak = 0;
+    while (!pcm_ring_done(&meter.ring)) {
+        size_t n = pcm_ring_read(&meter.ring, buf, PERIOD_FRAMES);
+        if (n == 0) { usleep(20000); continue; }
+        for (size_t i = 0; i < n; i++) {
+            int v = buf[i] < 0 ? -buf[i] : buf[i];
+            if (v > meter.peak) meter.peak = v;
+        }
+        seen += n;
+        if (!warned && seen >= (size_t)SAMPLE_RATE * METER_CHECK_MS / 1000) {
+            warned = 1;
+            if (meter.peak < METER_SILENT_PEAK)
+                notify("No input signal — is the microphone muted?");
+        }
+    }
+    return NULL;
+}
+
+static void meter_init(void) {
+    if (pcm_ring_init(&meter.ring, 8 * PERIOD_FRAMES) < 0) return;
+    if (capture_attach(&meter.ring) < 0) pcm_ring_free(&meter.ring);
+}
+
+/* After capture_arm(): the ring has just been reset */
+static void meter_start(void) {
+    if (!meter.ring.buf) return;
+    meter.active = pthread_create(&meter.tid, NULL, meter_thread, NULL) == 0;
+}
+
+/* After capture_disarm(): the ring is closed, the thread drains and exits */
+static void meter_stop(void) {
+    if (!meter.active) return;
+    pthread_join(meter.tid, NULL);
+    meter.active = 0;
+    if (meter.peak > 0)
+        printf("dictator: input peak %.1f dBFS\n", 20.0 * log10(meter.peak / 32768.0));
+}
+
+static void meter_shutdown(void) {
+    if (!meter.ring.buf) return;
+    capture_detach(&meter.ring);
+    pcm_ring_free(&meter.ring);
+}
+
+/* ── Chunk planner ──────────────────────────────────────────────────── */
+
+/*
+ * Long recordings go up in chunks of at most ~CHUNK_SECONDS. Instead of
+ * hard cuts every 30 s, the recording is split into equal parts (so the
+ * last one is never a one-second sliver) and each cut is moved to the
+ * quietest 10 ms frame within CHUNK_SEARCH_MS of its nominal position,
+ * nearest to nominal on ties. Cuts land in pauses rather than words.
+ */
+
+#define CHUNK_SEARCH_MS 2000
+
+/* Number of chunks chunk_plan() will produce for n samples */
+static size_t chunk_count(size_t n) {
+    return (n + CHUNK_SAMPLES - 1) / CHUNK_SAMPLES;
+}
+
+/* Cut point near `nominal`: middle of the quietest 10 ms frame within
+ * CHUNK_SEARCH_MS of it, looking no further than pcm[n) */
+static size_t chunk_quiet_cut(const int16_t *pcm, size_t n, size_t nominal) {
+    size_t win = (size_t)CHUNK_SEARCH_MS * SAMPLE_RATE / 1000;
+    size_t lo = nominal > win ? nominal - win : 0;
+    size_t hi = nominal + win + VAD_FRAME <= n ? nominal + win : n - VAD_FRAME;
+    size_t best = nominal;
+    uint64_t best_e = UINT64_MAX;
+    size_t best_d = SIZE_MAX;
+    for (size_t f = lo; f <= hi; f += VAD_FRAME) {
+        uint64_t e;
+        unsigned zc;
+        vad_frame_stats(pcm + f, VAD_FRAME, &e, &zc);
+        size_t mid = f + VAD_FRAME / 2;
+        size_t d = mid > nominal ? mid - nominal : nominal - mid;
+        if (e < best_e || (e == best_e && d < best_d)) {
+            best_e = e;
+            best_d = d;
+            best = mid;
+        }
+    }
+    return best;
+}
+
+/* Fill ends[0..chunk_count(n)) with the end offset of each chunk; the
+ * last is always n. Returns the number of chunks. */
+static size_t chunk_plan(const int16_t *pcm, size_t n, size_t *ends) {
+    size_t nchunks = chunk_count(n);
+    for (size_t k = 1; k < nchunks; k++)
+        ends[k - 1] = chunk_quiet_cut(pcm, n, n * k / nchunks);
+    if (nchunks) ends[nchunks - 1] = n;
+    return nchunks;
+}
+
+/* ── Time compression (WSOLA) ───────────────────────────────────────── */
+
+/*
+ * Waveform-similarity overlap-add: speeds speech up by `factor` without
+ * changing its pitch, so a 30 s chunk at 1.25x uploads and bills as 24 s.
+ * 20 ms Hann frames are laid down every 10 ms of output while the input
+ * advances 10 ms × factor; each frame's start is nudged by up to
+ * WSOLA_TOLERANCE samples to the spot whose waveform best continues the
+ * previous frame, so overlapping periods stay in phase.
+ */
+
+#define WSOLA_WIN       (SAMPLE_RATE / 50)     /* 20 ms, multiple of 8 */
+#define WSOLA_HOP       (WSOLA_WIN / 2)
+#define WSOLA_TOLERANCE (SAMPLE_RATE / 160)    /* ±6.25 ms */
+#define WSOLA_MAX       2.0
+
+/* Compress in[0..n) into a new buffer. Returns its length, or 0 when the
+ * input is left as is (factor ≤ 1, too short, no memory). */
+static size_t time_compress(const int16_t *in, size_t n, double factor, int16_t **out) {
+    *out = NULL;
+    if (factor <= 1.0 || n < 4 * WSOLA_WIN) return 0;
+    if (factor > WSOLA_MAX) factor = WSOLA_MAX;
+
+    size_t nframes = (size_t)((double)(n - WSOLA_WIN - WSOLA_TOLERANCE) / (WSOLA_HOP * factor)) + 1;
+    size_t nout = (nframes - 1) * WSOLA_HOP + WSOLA_WIN;
+    float *x = malloc(n * sizeof(float));
+    float *y = calloc(nout, sizeof(float));
+    int16_t *res = malloc(nout * sizeof(int16_t));
+    if (!x || !y || !res) {
+        free(x); free(y); free(res);
+        return 0;
+    }
+    for (size_t i = 0; i < n; i++) x[i] = in[i];
+
+    float win[WSOLA_WIN];   /* periodic Hann: overlaps at half a window sum to 1 */
+    for (int i = 0; i < WSOLA_WIN; i++)
+        win[i] = (float)(0.5 - 0.5 * cos(2 * M_PI * i / WSOLA_WIN));
+
+    float (*dot)(const float *, const float *, unsigned) = resampler_pick_dot();
+    size_t prev = 0;
+    for (size_t k = 0; k < nframes; k++) {
+        size_t pos = 0;
+        if (k > 0) {
+            /* what the previous frame would naturally continue into */
+            size_t natural = prev + WSOLA_HOP;
+            size_t nominal = (size_t)((double)k * WSOLA_HOP * factor + 0.5);
+            size_t lo = nominal > WSOLA_TOLERANCE ? nominal - WSOLA_TOLERANCE : 0;
+            size_t hi = nominal + WSOLA_TOLERANCE;
+            if (hi + WSOLA_WIN > n) hi = n - WSOLA_WIN;
+            float best = -INFINITY;
+            pos = nominal < hi ? nominal : hi;
+            if (natural + WSOLA_WIN <= n) {
+                for (size_t c = lo; c <= hi; c++) {
+                    float r = dot(x + natural, x + c, WSOLA_WIN);
+                    if (r > best) { best = r; pos = c; }
+                }
+            }
+        }
+        float *dst = y + k * WSOLA_HOP;
+        for (int i = 0; i < WSOLA_WIN; i++)
+            dst[i] += win[i] * x[pos + i];
+        prev = pos;
+    }
+
+    for (size_t i = 0; i < nout; i++) {
+        long v = lrintf(y[i]);
+        res[i] = (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+    }
+    free(x);
+    free(y);
+    *out = res;
+    return nout;
+}
+
+/* ── WAV builder (in-memory) ────────────────────────────────────────── */
+
+#define WAV_HEADER 44
+#define WAV_STREAMING SIZE_MAX   /* length not known when the header goes out */
+
+/* 16 kHz mono S16 header for data_bytes of samples. A streaming header
+ * carries 0xFFFFFFFF sizes, which readers take as "until end of file". */
+static void wav_header(uint8_t *wav, size_t data_bytes) {
+    uint32_t u32;
+    uint16_t u16;
+
+    memcpy(wav, "RIFF", 4);
+    u32 = data_bytes == WAV_STREAMING ? UINT32_MAX : (uint32_t)(data_bytes + WAV_HEADER - 8);
+                                     memcpy(wav + 4, &u32, 4);
+    memcpy(wav + 8, "WAVE", 4);
+    memcpy(wav + 12, "fmt ", 4);
+    u32 = 16;                        memcpy(wav + 16, &u32, 4);
+    u16 = 1;                         memcpy(wav + 20, &u16, 2); /* PCM */
+    u16 = CHANNELS;                  memcpy(wav + 22, &u16, 2);
+    u32 = SAMPLE_RATE;               memcpy(wav + 24, &u32, 4);
+    u32 = SAMPLE_RATE * CHANNELS * FRAME_SIZE;
+                                     memcpy(wav + 28, &u32, 4); /* byte rate */
+    u16 = CHANNELS * FRAME_SIZE;     memcpy(wav + 32, &u16, 2); /* block align */
+    u16 = 16;                        memcpy(wav + 34, &u16, 2); /* bits/sample */
+    memcpy(wav + 36, "data", 4);
+    u32 = data_bytes == WAV_STREAMING ? UINT32_MAX : (uint32_t)data_bytes;
+                                     memcpy(wav + 40, &u32, 4);
+}
+
+static size_t build_wav(int16_t *samples, size_t num_samples, uint8_t **out) {
+    size_t data_bytes = num_samples * FRAME_SIZE;
+    size_t total = WAV_HEADER + data_bytes;
+    uint8_t *wav = malloc(total);
+    if (!wav) return 0;
+
+    wav_header(wav, data_bytes);
+    memcpy(wav + WAV_HEADER, samples, data_bytes);
+
+    *out = wav;
+    return total;
+}
+
+/* ── FLAC encoder ───────────────────────────────────────────────────── */
+
+/*
+ * Minimal lossless encoder for 16 kHz mono S16: variable-blocksize
+ * frames, each one subframe chosen from CONSTANT, VERBATIM or FIXED
+ * order 0-4 with partitioned Rice residuals. Speech typically packs to
+ * 40-60 % of WAV. Every frame carries its own sample number, so frames
+ * encoded during capture (one per FLAC_BLOCK of raw audio) can later be
+ * stitched into any chunk by rewriting just the frame header and CRCs.
+ */
+
+#define FLAC_BLOCK          4096
+#define FLAC_MIN_BLOCK      16
+#define FLAC_MAX_RICE_ORDER 8
+#define FLAC_RICE_MAX       14
+
+struct bitwriter {
+    uint8_t *buf;
+    size_t   len, cap;
+    uint64_t acc;
+    unsigned nbits;
+    int      oom;
+};
+
+static void bw_byte(struct bitwriter *bw, uint8_t b) {
+    if (bw->len == bw->cap) {
+        size_t cap = bw->cap ? bw->cap * 2 : 4096;
+        uint8_t *tmp = realloc(bw->buf, cap);
+        if (!tmp) { bw->oom = 1; return; }
+        bw->buf = tmp;
+        bw->cap = cap;
+    }
+    bw->buf[bw->len++] = b;
+}
+
+/* Append the low `bits` (≤ 32) bits of v, MSB first */
+static void bw_put(struct bitwriter *bw, uint32_t v, unsigned bits) {
+    if (!bits) return;
+    bw->acc = (bw->acc << bits) | (bits == 32 ? v : v & ((1u << bits) - 1));
+    bw->nbits += bits;
+    while (bw->nbits >= 8) {
+        bw->nbits -= 8;
+        bw_byte(bw, (uint8_t)(bw->acc >> bw->nbits));
+    }
+}
+
+static void bw_zeros(struct bitwriter *bw, uint32_t n) {
+    while (n >= 32) { bw_put(bw, 0, 32); n -= 32; }
+    bw_put(bw, 0, n);
+}
+
+static void bw_align(struct bitwriter *bw) {
+    if (bw->nbits) bw_put(bw, 0, 8 - bw->nbits);
+}
+
+static void bw_bytes(struct bitwriter *bw, const uint8_t *p, size_t n) {
+    for (size_t i = 0; i < n; i++) bw_byte(bw, p[i]);
+}
+
+static pthread_once_t flac_crc_once = PTHREAD_ONCE_INIT;
+static uint8_t  flac_crc8_tab[256];
+static uint16_t flac_crc16_tab[256];
+
+static void flac_crc_init(void) {
+    for (int i = 0; i < 256; i++) {
+        uint8_t c8 = (uint8_t)i;
+        uint16_t c16 = (uint16_t)(i << 8);
+        for (int b = 0; b < 8; b++) {
+            c8 = (uint8_t)((c8 << 1) ^ (c8 & 0x80 ? 0x07 : 0));
+            c16 = (uint16_t)((c16 << 1) ^ (c16 & 0x8000 ? 0x8005 : 0));
+        }
+        flac_crc8_tab[i] = c8;
+        flac_crc16_tab[i] = c16;
+    }
+}
+
+static uint8_t flac_crc8(const uint8_t *p, size_t n) {
+    uint8_t c = 0;
+    while (n--) c = flac_crc8_tab[c ^ *p++];
+    return c;
+}
+
+static uint16_t flac_crc16(const uint8_t *p, size_t n) {
+    uint16_t c = 0;
+    while (n--) c = (uint16_t)((c << 8) ^ flac_crc16_tab[(c >> 8) ^ *p++]);
+    return c;
+}
+
+/* Residual of fixed predictor `order` at x[i] */
+static int32_t flac_fixed_residual(const int16_t *x, size_t i, int order) {
+    switch (order) {
+    case 0: return x[i];
+    case 1: return x[i] - x[i - 1];
+    case 2: return x[i] - 2 * x[i - 1] + x[i - 2];
+    case 3: return x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+    default: return x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+    }
+}
+
+static uint64_t rice_bits(const uint32_t *u, size_t n, unsigned k) {
+    uint64_t bits = (uint64_t)n * (k + 1);
+    for (size_t i = 0; i < n; i++) bits += u[i] >> k;
+    return bits;
+}
+
+/* Best Rice parameter for one partition and its cost in bits */
+static unsigned rice_best(const uint32_t *u, size_t n, uint64_t *cost) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) sum += u[i];
+    unsigned guess = 0;
+    while (guess < FLAC_RICE_MAX && (uint64_t)n << (guess + 1) < sum) guess++;
+    unsigned best = guess;
+    uint64_t best_bits = rice_bits(u, n, guess);
+    for (unsigned k = guess ? guess - 1 : 0; k <= guess + 1 && k <= FLAC_RICE_MAX; k++) {
+        uint64_t b = rice_bits(u, n, k);
+        if (b < best_bits) { best_bits = b; best = k; }
+    }
+    *cost = best_bits;
+    return best;
+}
+
+/* Encode one subframe for x[0..n) into bw; returns -1 on OOM */
+static int flac_subframe(struct bitwriter *bw, const int16_t *x, size_t n) {
+    size_t i;
+    for (i = 1; i < n && x[i] == x[0]; i++) ;
+    if (i == n) {                                     /* CONSTANT */
+        bw_put(bw, 0x00, 8);
+        bw_put(bw, (uint16_t)x[0], 16);
+        return bw->oom ? -1 : 0;
+    }
+
+    /* pick the fixed order with the smallest total |residual| */
+    int order = 0;
+    uint64_t best_abs = UINT64_MAX;
+    for (int o = 0; o <= 4 && (size_t)o < n; o++) {
+        uint64_t s = 0;
+        for (i = (size_t)o; i < n; i++) {
+            int32_t r = flac_fixed_residual(x, i, o);
+            s += (uint64_t)(r < 0 ? -r : r);
+        }
+        if (s < best_abs) { best_abs = s; order = o; }
+    }
+
+    uint32_t *u = malloc(n * sizeof(uint32_t));
+    if (!u) return -1;
+    for (i = (size_t)order; i < n; i++) {
+        int32_t r = flac_fixed_residual(x, i, order);
+        u[i] = ((uint32_t)r << 1) ^ (uint32_t)(r >> 31);   /* zigzag */
+    }
+
+    /* partition order: n must split evenly and the first partition must
+     * be longer than the warm-up */
+    unsigned best_p = 0;
+    uint64_t best_bits = UINT64_MAX;
+    for (unsigned p = 0; p <= FLAC_MAX_RICE_ORDER; p++) {
+        if (p && (n % (1u << p) || (n >> p) <= (size_t)order)) break;
+        uint64_t bits = 0;
+        for (unsigned part = 0; part < (1u << p); part++) {
+            size_t start = part ? part * (n >> p) : (size_t)order;
+            size_t end = (part + 1) * (n >> p);
+            uint64_t c;
+            rice_best(u + start, end - start, &c);
+            bits += c + 4;
+        }
+        if (bits < best_bits) { best_bits = bits; best_p = p; }
+    }
+
+    if (best_bits + (uint64_t)order * 16 + 6 >= (uint64_t)n * 16) {  /* VERBATIM */
+        free(u);
+        bw_put(bw, 0x02, 8);
+        for (i = 0; i < n; i++) bw_put(bw, (uint16_t)x[i], 16);
+        return bw->oom ? -1 : 0;
+    }
+
+    bw_put(bw, (uint32_t)(0x08 | order) << 1, 8);     /* FIXED, no wasted bits */
+    for (i = 0; i < (size_t)order; i++) bw_put(bw, (uint16_t)x[i], 16);
+    bw_put(bw, 0, 2);                                  /* 4-bit Rice params */
+    bw_put(bw, best_p, 4);
+    for (unsigned part = 0; part < (1u << best_p); part++) {
+        size_t start = part ? part * (n >> best_p) : (size_t)order;
+        size_t end = (part + 1) * (n >> best_p);
+        uint64_t c;
+        unsigned k = rice_best(u + start, end - start, &c);
+        bw_put(bw, k, 4);
+        for (i = start; i < end; i++) {
+            bw_zeros(bw, u[i] >> k);
+            bw_put(bw, 1, 1);
+            bw_put(bw, u[i], k);
+        }
+    }
+    free(u);
+    bw_align(bw);
+    return bw->oom ? -1 : 0;
+}
+
+/* FLAC "UTF-8" coded sample number */
+static void flac_put_coded(struct bitwriter *bw, uint64_t v) {
+    if (v < 0x80) { bw_put(bw, (uint32_t)v, 8); return; }
+    int extra = v < 0x800 ? 1 : v < 0x10000 ? 2 : v < 0x200000 ? 3
+              : v < 0x4000000 ? 4 : v < 0x80000000ull ? 5 : 6;
+    uint8_t lead = (uint8_t)(0xFF << (7 - extra));
+    bw_put(bw, lead | (uint32_t)(v >> (6 * extra)), 8);
+    for (int i = extra - 1; i >= 0; i--)
+        bw_put(bw, 0x80 | (uint32_t)((v >> (6 * i)) & 0x3F), 8);
+}
+
+/* Append one frame: header for (sample_number, n), the byte-aligned
+ * subframe `payload`, CRC-16 */
+static void flac_frame(struct bitwriter *bw, uint64_t sample_number, size_t n,
+                       const uint8_t *payload, size_t payload_len) {
+    size_t start = bw->len;
+    bw_put(bw, 0xFFF9, 16);              /* sync, variable blocksize */
+    bw_put(bw, n <= 256 ? 0x6 : 0x7, 4); /* blocksize-1 follows */
+    bw_put(bw, 0x5, 4);                  /* 16 kHz */
+    bw_put(bw, 0x0, 4);                  /* mono */
+    bw_put(bw, 0x4 << 1, 4);             /* 16 bit, reserved 0 */
+    flac_put_coded(bw, sample_number);
+    bw_put(bw, (uint32_t)(n - 1), n <= 256 ? 8 : 16);
+    if (bw->oom) return;
+    bw_put(bw, flac_crc8(bw->buf + start, bw->len - start), 8);
+    bw_bytes(bw, payload, payload_len);
+    if (bw->oom) return;
+    bw_put(bw, flac_crc16(bw->buf + start, bw->len - start), 16);
+}
+
+/* Subframe bytes for one block, reusable under any frame header */
+static int flac_block_payload(const int16_t *x, size_t n, uint8_t **out, size_t *len) {
+    struct bitwriter sb = {0};
+    if (flac_subframe(&sb, x, n) < 0 || sb.oom) {
+        free(sb.buf);
+        return -1;
+    }
+    *out = sb.buf;
+    *len = sb.len;
+    return 0;
+}
+
+/* Subframes encoded during capture, one per FLAC_BLOCK of raw capture
+ * offset; filled by the encoder tap below, read only after it joined */
+static struct {
+    struct flac_block { uint8_t *data; size_t len; } *blocks;
+    size_t nblocks, cap;
+    int    valid;            /* matches pcm_buf as captured */
+} flac_cache;
+
+static void flac_cache_clear(void) {
+    for (size_t i = 0; i < flac_cache.nblocks; i++)
+        free(flac_cache.blocks[i].data);
+    free(flac_cache.blocks);
+    flac_cache.blocks = NULL;
+    flac_cache.nblocks = flac_cache.cap = 0;
+    flac_cache.valid = 0;
+}
+
+static int flac_cache_add(uint8_t *data, size_t len) {
+    if (flac_cache.nblocks == flac_cache.cap) {
+        size_t cap = flac_cache.cap ? flac_cache.cap * 2 : 64;
+        void *tmp = realloc(flac_cache.blocks, cap * sizeof(*flac_cache.blocks));
+        if (!tmp) return -1;
+        flac_cache.blocks = tmp;
+        flac_cache.cap = cap;
+    }
+    flac_cache.blocks[flac_cache.nblocks++] = (struct flac_block){ data, len };
+    return 0;
+}
+
+static const uint8_t *flac_cached_block(size_t k, size_t *len) {
+    if (!flac_cache.valid || k >= flac_cache.nblocks) return NULL;
+    *len = flac_cache.blocks[k].len;
+    return flac_cache.blocks[k].data;
+}
+
+/* Encode pcm[0..n) as a FLAC stream. `spans`, when given, says where in
+ * the raw capture those samples came from (in order, summing to n), so
+ * whole FLAC_BLOCKs already encoded during capture are reused. */
+static size_t flac_encode(const int16_t *pcm, size_t n,
+                          const struct pcm_span *spans, size_t nspans, uint8_t **out) {
+    pthread_once(&flac_crc_once, flac_crc_init);
+    struct pcm_span whole = { SIZE_MAX, n };
+    if (!spans) { spans = &whole; nspans = 1; }
+
+    struct bitwriter bw = {0};
+    bw_bytes(&bw, (const uint8_t *)"fLaC", 4);
+    bw_put(&bw, 0x80, 8);                /* last metadata block, STREAMINFO */
+    bw_put(&bw, 34, 24);
+    size_t si = bw.len;                  /* block sizes patched at the end */
+    bw_zeros(&bw, 16 + 16 + 24 + 24);
+    bw_put(&bw, SAMPLE_RATE, 20);
+    bw_put(&bw, CHANNELS - 1, 3);
+    bw_put(&bw, 15, 5);                  /* 16 bits per sample */
+    bw_put(&bw, (uint32_t)((uint64_t)n >> 32), 4);
+    bw_put(&bw, (uint32_t)n, 32);
+    bw_zeros(&bw, 128);                  /* MD5 unknown */
+
+    size_t out_pos = 0, min_bs = SIZE_MAX, max_bs = 0;
+    for (size_t s = 0; s < nspans && !bw.oom; s++) {
+        size_t raw = spans[s].raw, end = out_pos + spans[s].len;
+        while (out_pos < end) {
+            size_t len = end - out_pos, plen;
+            const uint8_t *cached = NULL;
+            uint8_t *fresh = NULL;
+            if (raw != SIZE_MAX) {
+                size_t k = raw / FLAC_BLOCK, into = raw % FLAC_BLOCK;
+                if (into == 0 && (len == FLAC_BLOCK ||
+                                  len >= FLAC_BLOCK + FLAC_MIN_BLOCK)) {
+                    len = FLAC_BLOCK;
+                    cached = flac_cached_block(k, &plen);
+                } else if (into == 0 && len > FLAC_BLOCK) {
+                    /* runt tail: encode fresh as one slightly larger frame */
+                } else if (into) {
+                    /* up to the next block boundary, unless that leaves
+                     * a runt frame on either side */
+                    size_t head = FLAC_BLOCK - into;
+                    if (head < len && head >= FLAC_MIN_BLOCK &&
+                        len - head >= FLAC_MIN_BLOCK)
+                        len = head;
+                    else if (head < len && len - head >= FLAC_BLOCK + FLAC_MIN_BLOCK)
+                        len = head + FLAC_BLOCK;
+                }
+            }
+            if (len > FLAC_BLOCK && raw == SIZE_MAX) {
+                len = FLAC_BLOCK;
+                if (end - out_pos - len < FLAC_MIN_BLOCK) len = end - out_pos;
+            }
+            if (!cached) {
+                if (flac_block_payload(pcm + out_pos, len, &fresh, &plen) < 0) {
+                    bw.oom = 1;
+                    break;
+                }
+                cached = fresh;
+            }
+            flac_frame(&bw, out_pos, len, cached, plen);
+            free(fresh);
+            if (len < min_bs) min_bs = len;
+            if (len > max_bs) max_bs = len;
+            out_pos += len;
+            if (raw != SIZE_MAX) raw += len;
+        }
+    }
+    if (bw.oom) {
+        free(bw.buf);
+        return 0;
+    }
+    if (min_bs < FLAC_MIN_BLOCK || min_bs == SIZE_MAX) min_bs = FLAC_MIN_BLOCK;
+    if (max_bs < min_bs) max_bs = min_bs;
+    bw.buf[si]     = (uint8_t)(min_bs >> 8);
+    bw.buf[si + 1] = (uint8_t)min_bs;
+    bw.buf[si + 2] = (uint8_t)(max_bs >> 8);
+    bw.buf[si + 3] = (uint8_t)max_bs;
+    *out = bw.buf;
+    return bw.len;
+}
+
+/* ── Ogg Opus encoder ───────────────────────────────────────────────── */
+
+#ifdef USE_OPUS
+/*
+ * libopus at OPUS_BITRATE in 20 ms frames, wrapped in a minimal Ogg
+ * stream (OpusHead, OpusTags, then 42 packets, 0.84 s, per page).
+ * Unlike FLAC frames, Opus packets depend on the encoder state carried
+ * over from the previous frame, so they cannot be cut out of a stream
+ * encoded during capture; this runs once per chunk after release.
+ */
+
+#define OPUS_FRAME      (SAMPLE_RATE / 50)   /* 20 ms */
+#define OPUS_BITRATE    24000
+#define OPUS_MAX_PACKET 1275
+#define OGG_PAGE_PACKETS 42                  /* x 6 lacing values fits 255 */
+#define OGG_SERIAL      0x64696374           /* "dict" */
+
+static pthread_once_t ogg_crc_once = PTHREAD_ONCE_INIT;
+static uint32_t ogg_crc_tab[256];
+
+static void ogg_crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i << 24;
+        for (int b = 0; b < 8; b++)
+            c = (c << 1) ^ (c & 0x80000000u ? 0x04c11db7u : 0);
+        ogg_crc_tab[i] = c;
+    }
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+/* Append one page holding `count` packets stored back to back in `data` */
+static void ogg_page(struct bitwriter *bw, int flags, uint64_t granule, uint32_t seq,
+                     const uint8_t *data, const size_t *lens, size_t count) {
+    uint8_t hdr[27 + 255];
+    size_t nseg = 0, body = 0;
+    for (size_t i = 0; i < count; i++) {
+        for (size_t l = lens[i]; ; l -= 255) {
+            hdr[27 + nseg++] = (uint8_t)(l < 255 ? l : 255);
+            if (l < 255) break;
+        }
+        body += lens[i];
+    }
+    memcpy(hdr, "OggS", 4);
+    hdr[4] = 0;
+    hdr[5] = (uint8_t)flags;
+    put_le32(hdr + 6, (uint32_t)granule);
+    put_le32(hdr + 10, (uint32_t)(granule >> 32));
+    put_le32(hdr + 14, OGG_SERIAL);
+    put_le32(hdr + 18, seq);
+    put_le32(hdr + 22, 0);
+    hdr[26] = (uint8_t)nseg;
+
+    uint32_t crc = 0;
+    for (size_t i = 0; i < 27 + nseg; i++)
+        crc = (crc << 8) ^ ogg_crc_tab[(crc >> 24) ^ hdr[i]];
+    for (size_t i = 0; i < body; i++)
+        crc = (crc << 8) ^ ogg_crc_tab[(crc >> 24) ^ data[i]];
+    put_le32(hdr + 22, crc);
+    bw_bytes(bw, hdr, 27 + nseg);
+    bw_bytes(bw, data, body);
+}
+
+static size_t opus_encode_ogg(const int16_t *pcm, size_t n, uint8_t **out) {
+    pthread_once(&ogg_crc_once, ogg_crc_init);
+    int err;
+    OpusEncoder *enc = opus_encoder_create(SAMPLE_RATE, CHANNELS,
+                                           OPUS_APPLICATION_VOIP, &err);
+    if (!enc) {
+        fprintf(stderr, "dictator: opus: %s\n", opus_strerror(err));
+        return 0;
+    }
+    opus_encoder_ctl(enc, OPUS_SET_BITRATE(OPUS_BITRATE));
+    opus_int32 lookahead = 0;
+    opus_encoder_ctl(enc, OPUS_GET_LOOKAHEAD(&lookahead));
+    uint32_t pre_skip = (uint32_t)lookahead * (48000 / SAMPLE_RATE);
+
+    struct bitwriter bw = {0};
+    uint8_t head[19];
+    memcpy(head, "OpusHead", 8);
+    head[8] = 1;                          /* version */
+    head[9] = CHANNELS;
+    head[10] = (uint8_t)pre_skip;
+    head[11] = (uint8_t)(pre_skip >> 8);
+    put_le32(head + 12, SAMPLE_RATE);     /* original rate, informational */
+    head[16] = head[17] = 0;              /* output gain */
+    head[18] = 0;                         /* mapping family */
+    size_t len = sizeof(head);
+    ogg_page(&bw, 0x02, 0, 0, head, &len, 1);
+
+    uint8_t tags[8 + 4 + 8 + 4];
+    memcpy(tags, "OpusTags", 8);
+    put_le32(tags + 8, 8);
+    memcpy(tags + 12, "dictator", 8);
+    put_le32(tags + 20, 0);
+    len = sizeof(tags);
+    ogg_page(&bw, 0, 0, 1, tags, &len, 1);
+
+    /* enough frames to flush the lookahead; the tail is zero padded */
+    size_t frames = (n + (size_t)lookahead + OPUS_FRAME - 1) / OPUS_FRAME;
+    uint8_t *pkts = malloc(OGG_PAGE_PACKETS * OPUS_MAX_PACKET);
+    int16_t frame[OPUS_FRAME];
+    size_t lens[OGG_PAGE_PACKETS], fill = 0, used = 0;
+    uint32_t seq = 2;
+    if (!pkts) bw.oom = 1;
+    for (size_t f = 0; f < frames && !bw.oom; f++) {
+        size_t at = f * OPUS_FRAME;
+        size_t take = at >= n ? 0 : n - at < OPUS_FRAME ? n - at : OPUS_FRAME;
+        memcpy(frame, pcm + at, take * sizeof(int16_t));
+        memset(frame + take, 0, (OPUS_FRAME - take) * sizeof(int16_t));
+        int r = opus_encode(enc, frame, OPUS_FRAME, pkts + used, OPUS_MAX_PACKET);
+        if (r < 0) {
+            fprintf(stderr, "dictator: opus: %s\n", opus_strerror(r));
+            bw.oom = 1;
+            break;
+        }
+        lens[fill++] = (size_t)r;
+        used += (size_t)r;
+        int last = f + 1 == frames;
+        if (fill == OGG_PAGE_PACKETS || last) {
+            /* granule: 48 kHz samples decodable through this page; the
+             * final one trims the padding */
+            uint64_t granule = last ? pre_skip + (uint64_t)n * (48000 / SAMPLE_RATE)
+                                    : (uint64_t)(f + 1) * OPUS_FRAME * (48000 / SAMPLE_RATE);
+            ogg_page(&bw, last ? 0x04 : 0, granule, seq++, pkts, lens, fill);
+            fill = used = 0;
+        }
+    }
+    free(pkts);
+    opus_encoder_destroy(enc);
+    if (bw.oom) {
+        free(bw.buf);
+        return 0;
+    }
+    *out = bw.buf;
+    return bw.len;
+}
+#endif
+
+/* ── Upload encoding ────────────────────────────────────────────────── */
+
+/*
+ * Each backend uploads in its configured codec (groq_codec, aai_codec).
+ * A chunk is wrapped in a struct audio and encoded lazily, once per
+ * codec, so a Groq → AssemblyAI fallback with different codecs encodes
+ * each only when needed. FLAC reuses the frames the encoder tap produced
+ * while the key was held; only the partial frames at VAD cuts and chunk
+ * edges are encoded after release.
+ */
+
+static const struct codec_info {
+    const char *name, *mime, *filename;
+} codecs[CODEC_COUNT] = {
+    [CODEC_WAV]  = { "wav",  "audio/wav",  "audio.wav"  },
+    [CODEC_FLAC] = { "flac", "audio/flac", "audio.flac" },
+    [CODEC_OPUS] = { "opus", "audio/ogg",  "audio.ogg"  },
+};
+
+struct audio {
+    int16_t         *pcm;     /* 16 kHz mono */
+    size_t           n;
+    int16_t         *owned;   /* time-compressed copy behind pcm, if any */
+    struct pcm_span *spans;   /* capture origin of pcm, NULL if unknown */
+    size_t           nspans;
+    double           overlap_s;   /* leading audio repeated from the previous chunk */
+    int              timed;   /* ask for word timestamps: the text is the JSON */
+    uint8_t         *enc[CODEC_COUNT];
+    size_t           enc_len[CODEC_COUNT];
+};
+
+/* Per-session encode totals, printed after the upload */
+static struct {
+    size_t wav_bytes[CODEC_COUNT], bytes[CODEC_COUNT];
+    double capture_ms, after_ms;
+} enc_stats;
+static pthread_mutex_t enc_stats_lock = PTHREAD_MUTEX_INITIALIZER;   /* hedges encode too */
+
+/* Wrap pcm[offset..offset+n) for upload. `origin` maps pcm back to the
+ * capture; time compression changes the samples, so it drops that. */
+static void audio_chunk(struct audio *a, int16_t *pcm, size_t offset, size_t n,
+                        const struct span_list *origin) {
+    *a = (struct audio){ .pcm = pcm + offset, .n = n };
+    size_t m = time_compress(a->pcm, n, cfg.time_compress, &a->owned);
+    if (m) {
+        a->pcm = a->owned;
+        a->n = m;
+        return;
+    }
+    if (!origin || origin->lost || !origin->n) return;
+    a->spans = malloc(origin->n * sizeof(*a->spans));
+    if (!a->spans) return;
+    size_t pos = 0, end = offset + n;
+    for (size_t i = 0; i < origin->n && pos < end; pos += origin->v[i++].len) {
+        size_t s = pos > offset ? pos : offset;
+        size_t e = pos + origin->v[i].len < end ? pos + origin->v[i].len : end;
+        if (e > s)
+            a->spans[a->nspans++] = (struct pcm_span){ origin->v[i].raw + (s - pos), e - s };
+    }
+}
+
+/* Encoded bytes for codec c, encoding on first use. NULL on failure. */
+static const uint8_t *audio_encode(struct audio *a, enum codec c, size_t *len) {
+    if (!a->enc[c]) {
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        switch (c) {
+        case CODEC_FLAC:
+            a->enc_len[c] = flac_encode(a->pcm, a->n, a->spans, a->nspans, &a->enc[c]);
+            break;
+#ifdef USE_OPUS
+        case CODEC_OPUS:
+            a->enc_len[c] = opus_encode_ogg(a->pcm, a->n, &a->enc[c]);
+            break;
+#endif
+        default:
+            a->enc_len[c] = build_wav(a->pcm, a->n, &a->enc[c]);
+            break;
+        }
+        if (!a->enc_len[c]) {
+            a->enc[c] = NULL;
+            return NULL;
+        }
+        double ms = ms_since(&t0);
+        pthread_mutex_lock(&enc_stats_lock);
+        if (c != CODEC_WAV) enc_stats.after_ms += ms;
+        enc_stats.wav_bytes[c] += WAV_HEADER + a->n * FRAME_SIZE;
+        enc_stats.bytes[c] += a->enc_len[c];
+        pthread_mutex_unlock(&enc_stats_lock);
+    }
+    *len = a->enc_len[c];
+    return a->enc[c];
+}
+
+static void audio_free(struct audio *a) {
+    for (int c = 0; c < CODEC_COUNT; c++) free(a->enc[c]);
+    free(a->owned);
+    free(a->spans);
+    *a = (struct audio){0};
+}
+
+/*
+ * Upload bodies are read by curl through a callback instead of handed
+ * over as one buffer. A WAV body is its 44-byte header followed by the
+ * chunk's samples read in place from the capture store, so WAV uploads
+ * never hold a second copy of the audio; compressed codecs read from
+ * their encoding. Seekable, so curl can rewind it for a retry.
+ */
+struct body {
+    uint8_t        hdr[WAV_HEADER];
+    size_t         hdr_len;
+    const uint8_t *data;
+    size_t         len;       /* hdr_len + data bytes */
+    size_t         pos;
+};
+
+/* Point b at the upload of `a` in codec c. Returns -1 if the audio could
+ * not be encoded; b must not outlive a. */
+static int audio_body(struct audio *a, enum codec c, struct body *b) {
+    *b = (struct body){0};
+    if (c == CODEC_WAV) {
+        wav_header(b->hdr, a->n * FRAME_SIZE);
+        b->hdr_len = WAV_HEADER;
+        b->data = (const uint8_t *)a->pcm;
+        b->len = WAV_HEADER + a->n * FRAME_SIZE;
+        return 0;
+    }
+    b->data = audio_encode(a, c, &b->len);
+    return b->data ? 0 : -1;
+}
+
+static size_t body_read(char *buf, size_t size, size_t nitems, void *arg) {
+    struct body *b = arg;
+    size_t want = size * nitems, n = 0;
+    while (n < want && b->pos < b->len) {
+        size_t take;
+        if (b->pos < b->hdr_len) {
+            take = b->hdr_len - b->pos;
+            if (take > want - n) take = want - n;
+            memcpy(buf + n, b->hdr + b->pos, take);
+        } else {
+            take = b->len - b->pos;
+            if (take > want - n) take = want - n;
+            memcpy(buf + n, b->data + (b->pos - b->hdr_len), take);
+        }
+        n += take;
+        b->pos += take;
+    }
+    return n;
+}
+
+static int body_seek(void *arg, curl_off_t offset, int origin) {
+    struct body *b = arg;
+    curl_off_t base = origin == SEEK_SET ? 0 :
+                      origin == SEEK_CUR ? (curl_off_t)b->pos : (curl_off_t)b->len;
+    if (base + offset < 0 || base + offset > (curl_off_t)b->len)
+        return CURL_SEEKFUNC_FAIL;
+    b->pos = (size_t)(base + offset);
+    return CURL_SEEKFUNC_OK;
+}
+
+/* Compression ratio and encode time of the last session, per codec used */
+static void enc_stats_print(void) {
+    pthread_mutex_lock(&enc_stats_lock);
+    for (int c = CODEC_WAV + 1; c < CODEC_COUNT; c++) {
+        if (!enc_stats.bytes[c]) continue;
+        printf("dictator: %s upload %zu KB, %.0f%% of WAV, encode %.0f ms during "
+               "capture + %.0f ms after\n", codecs[c].name, enc_stats.bytes[c] / 1024,
+               100.0 * (double)enc_stats.bytes[c] / (double)enc_stats.wav_bytes[c],
+               c == CODEC_FLAC ? enc_stats.capture_ms : 0.0, enc_stats.after_ms);
+    }
+    pthread_mutex_unlock(&enc_stats_lock);
+}
+
+/* ── FLAC encoding during capture ───────────────────────────────────── */
+
+/*
+ * Second consumer of the capture rings: encodes every complete
+ * FLAC_BLOCK of the live signal into flac_cache while the key is held,
+ * so most of the FLAC work is done before release. Only attached when a
+ * backend uploads FLAC. The ring must absorb the pre-roll burst spliced
+ * in at the start of a session.
+ */
+
+#define FLAC_TAP_RING (PREROLL_RING + 8 * PERIOD_FRAMES)
+
+static struct {
+    struct pcm_ring ring;
+    pthread_t       tid;
+    int             active;
+    size_t          consumed;    /* samples read this session */
+    int             failed;
+    double          ms;          /* time spent encoding */
+} flac_tap;
+
+static void *flac_tap_thread(void *arg) {
+    (void)arg;
+    int16_t *block = malloc(FLAC_BLOCK * sizeof(int16_t));
+    size_t fill = 0;
+    if (!block) flac_tap.failed = 1;
+    while (!pcm_ring_done(&flac_tap.ring)) {
+        if (flac_tap.failed) {   /* keep draining so consumed stays honest */
+            int16_t sink[PERIOD_FRAMES];
+            size_t n = pcm_ring_read(&flac_tap.ring, sink, PERIOD_FRAMES);
+            if (n == 0) usleep(20000);
+            flac_tap.consumed += n;
+            continue;
+        }
+        size_t n = pcm_ring_read(&flac_tap.ring, block + fill, FLAC_BLOCK - fill);
+        if (n == 0) { usleep(20000); continue; }
+        flac_tap.consumed += n;
+        fill += n;
+        if (fill < FLAC_BLOCK) continue;
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        uint8_t *data;
+        size_t len;
+        if (flac_block_payload(block, FLAC_BLOCK, &data, &len) < 0) {
+            flac_tap.failed = 1;
+        } else if (flac_cache_add(data, len) < 0) {
+            free(data);
+            flac_tap.failed = 1;
+        }
+        flac_tap.ms += ms_since(&t0);
+        fill = 0;
+    }
+    free(block);
+    return NULL;
+}
+
+static void flac_tap_init(void) {
+    if (cfg.groq_codec != CODEC_FLAC && cfg.aai_codec != CODEC_FLAC) return;
+    pthread_once(&flac_crc_once, flac_crc_init);
+    if (pcm_ring_init(&flac_tap.ring, FLAC_TAP_RING) < 0) return;
+    if (capture_attach(&flac_tap.ring) < 0) pcm_ring_free(&flac_tap.ring);
+}
+
+/* After capture_arm(): the ring has just been reset */
+static void flac_tap_start(void) {
+    if (!flac_tap.ring.buf) return;
+    flac_cache_clear();
+    flac_tap.consumed = 0;
+    flac_tap.failed = 0;
+    flac_tap.ms = 0;
+    flac_tap.active = pthread_create(&flac_tap.tid, NULL, flac_tap_thread, NULL) == 0;
+}
+
+/* After capture_disarm(): the cache is usable only if the tap saw
+ * exactly what pcm_buf holds (a full ring drops samples) */
+static void flac_tap_stop(void) {
+    if (!flac_tap.active) return;
+    pthread_join(flac_tap.tid, NULL);
+    flac_tap.active = 0;
+    flac_cache.valid = !flac_tap.failed && flac_tap.consumed == pcm_pos;
+    if (!flac_cache.valid)
+        printf("dictator: FLAC encoder fell behind, encoding after release\n");
+}
+
+static void flac_tap_shutdown(void) {
+    if (!flac_tap.ring.buf) return;
+    capture_detach(&flac_tap.ring);
+    pcm_ring_free(&flac_tap.ring);
+    flac_cache_clear();
+}
+
+/* ── curl write callback ────────────────────────────────────────────── */
+
+struct response { char *data; size_t len; };
+
+static size_t write_cb(void *ptr, size_t size, size_t nmemb, void *userp) {
+    size_t bytes = size * nmemb;
+    struct response *r = userp;
+    char *tmp = realloc(r->data, r->len + bytes + 1);
+    if (!tmp) return 0;
+    r->data = tmp;
+    memcpy(r->data + r->len, ptr, bytes);
+    r->len += bytes;
+    r->data[r->len] = '\0';
+    return bytes;
+}
+
+/* ── Minimal JSON string extraction ─────────────────────────────────── */
+
+/* Decode a hex digit, returns -1 on invalid input */
+static int hexval(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* Parse \uXXXX at *p (p points past the 'u'), returns codepoint, advances *p */
+static uint32_t parse_u_escape(char **p) {
+    uint32_t cp = 0;
+    for (int i = 0; i < 4; i++) {
+        int v = hexval((*p)[i]);
+        if (v < 0) return 0xFFFD;
+        cp = (cp << 4) | (uint32_t)v;
+    }
+    *p += 4;
+    return cp;
+}
+
+/* Write a Unicode codepoint as UTF-8, returns number of bytes written */
+static size_t utf8_encode(uint32_t cp, char *out) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    } else if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    } else if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    } else if (cp < 0x110000) {
+        out[0] = (char)(0xF0 | (cp >> 18));
+        out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[3] = (char)(0x80 | (cp & 0x3F));
+        return 4;
+    }
+    return utf8_encode(0xFFFD, out); /* replacement char */
+}
+
+/* Unescape a JSON string in-place: \uXXXX → UTF-8, \n, \t, etc. */
+static char *json_unescape(char *s) {
+    char *r = s, *w = s;
+    while (*r) {
+        if (*r == '\\' && r[1]) {
+            r++;
+            switch (*r) {
+            case '"': case '\\': case '/': *w++ = *r++; break;
+            case 'n': *w++ = '\n'; r++; break;
+            case 't': *w++ = '\t'; r++; break;
+            case 'r': *w++ = '\r'; r++; break;
+            case 'b': *w++ = '\b'; r++; break;
+            case 'f': *w++ = '\f'; r++; break;
+            case 'u': {
+                r++; /* skip 'u' */
+                uint32_t cp = parse_u_escape(&r);
+                /* Handle surrogate pairs: \uD800-\uDBFF \uDC00-\uDFFF */
+                if (cp >= 0xD800 && cp <= 0xDBFF && r[0] == '\\' && r[1] == 'u') {
+                    r += 2; /* skip \u */
+                    uint32_t lo = parse_u_escape(&r);
+                    if (lo >= 0xDC00 && lo <= 0xDFFF)
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                }
+                w += utf8_encode(cp, w);
+                break;
+            }
+            default: *w++ = '\\'; *w++ = *r++; break;
+            }
+        } else {
+            *w++ = *r++;
+        }
+    }
+    *w = '\0';
+    return s;
+}
+
+/* Start of the value of the first "key": in json, whitespace skipped;
+ * NULL if there is none */
+static const char *json_value(const char *json, const char *key) {
+    char needle[128];
+    snprintf(needle, sizeof(needle), "\"%s\"", key);
+    const char *p = json;
+    while ((p = strstr(p, needle)) != NULL) {
+        p += strlen(needle);
+        /* skip whitespace */
+        while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+        if (*p == ':') break; /* found as key */
+        /* matched as value (e.g. "status": "error"), keep searching */
+    }
+    if (!p) return NULL;
+    p++; /* skip colon */
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+    return p;
+}
+
+/* Extract the string value for a given key from JSON.
+ * Looks for "key": "value" and returns a malloc'd copy of value (UTF-8).
+ * Returns NULL if not found. */
+static char *json_get_string(const char *json, const char *key) {
+    const char *p = json_value(json, key);
+    if (!p) return NULL;
+    if (*p == 'n' && strncmp(p, "null", 4) == 0) return NULL;
+    if (*p != '"') return NULL;
+    p++; /* skip opening quote */
+    const char *start = p;
+    while (*p && !(*p == '"' && *(p - 1) != '\\')) p++;
+    if (!*p) return NULL;
+    size_t len = (size_t)(p - start);
+    char *val = malloc(len + 1);
+    if (!val) return NULL;
+    memcpy(val, start, len);
+    val[len] = '\0';
+    return json_unescape(val);
+}
+
+/* Numeric value for key, found the same way as json_get_string().
+ * Returns 0 and sets *out, or -1 if absent or not a number. */
+static int json_get_number(const char *json, const char *key, double *out) {
+    const char *p = json_value(json, key);
+    if (!p) return -1;
+    char *end;
+    double v = strtod(p, &end);
+    if (end == p) return -1;
+    *out = v;
+    return 0;
+}
+
+/* Length of the object, array or string starting at p, brackets inside
+ * strings ignored; 0 if it is not terminated */
+static size_t json_span(const char *p) {
+    int depth = 0;
+    const char *q = p;
+    do {
+        if (*q == '"') {
+            for (q++; *q && *q != '"'; q++)
+                if (*q == '\\' && q[1]) q++;
+            if (!*q) return 0;
+        } else if (*q == '{' || *q == '[') {
+            depth++;
+        } else if (*q == '}' || *q == ']') {
+            depth--;
+        } else if (!*q) {
+            return 0;
+        }
+        q++;
+    } while (depth > 0);
+    return (size_t)(q - p);
+}
+
+/* ── Connection pool ────────────────────────────────────────────────── */
+
+/*
+ * Easy handles are kept per API host and reused, and all of them share
+ * one curl_share for the DNS cache, TLS session IDs and the connection
+ * cache. A dictation then goes out on the connection the previous one
+ * left open instead of paying DNS + TCP + TLS (+ proxy CONNECT) again.
+ * Idle connections are held for POOL_MAX_IDLE_S with TCP keep-alive.
+ * The lock callbacks guard the share's data, but libcurl does not
+ * support a shared connection cache used from several threads at once:
+ * only one thread at a time may run transfers on pool.share. Others
+ * wait for it (the warm-up) or keep out of the share (hedges, below).
+ */
+
+enum api_host { HOST_GROQ, HOST_AAI, HOST_COUNT };
+
+#define POOL_HANDLES     2      /* idle easy handles kept per host */
+#define POOL_MAX_IDLE_S  300L   /* drop connections idle longer than this */
+
+static struct {
+    CURLSH         *share;
+    pthread_mutex_t locks[CURL_LOCK_DATA_LAST];
+    pthread_mutex_t lock;       /* idle lists */
+    CURL           *idle[HOST_COUNT][POOL_HANDLES];
+    int             nidle[HOST_COUNT];
+} pool = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static void pool_lock(CURL *h, curl_lock_data data, curl_lock_access access, void *u) {
+    (void)h; (void)access; (void)u;
+    pthread_mutex_lock(&pool.locks[data]);
+}
+
+static void pool_unlock(CURL *h, curl_lock_data data, void *u) {
+    (void)h; (void)u;
+    pthread_mutex_unlock(&pool.locks[data]);
+}
+
+/*
+ * A hedge thread (see Parallel chunk upload) runs while the uploader's
+ * multi is using the shared cache, which libcurl does not allow from two
+ * threads at once. On such a thread net_cancel is set: its handles stay
+ * out of the share, one is kept in solo_curl so the thread's own steps
+ * still reuse a connection, and every transfer gives up once *net_cancel
+ * is raised.
+ */
+static _Thread_local atomic_int *net_cancel;
+static _Thread_local CURL       *solo_curl;
+
+static int net_cancelled(void) {
+    return net_cancel && atomic_load(net_cancel);
+}
+
+static int cancel_xferinfo(void *p, curl_off_t dltotal, curl_off_t dlnow,
+                           curl_off_t ultotal, curl_off_t ulnow) {
+    (void)dltotal; (void)dlnow; (void)ultotal; (void)ulnow;
+    return atomic_load((atomic_int *)p);
+}
+
+/* Sleep between requests; -1 as soon as the thread is cancelled */
+static int net_sleep(long ms) {
+    while (ms > 0 && !net_cancelled()) {
+        long slice = ms < 20 ? ms : 20;
+        usleep((useconds_t)slice * 1000);
+        ms -= slice;
+    }
+    return net_cancelled() ? -1 : 0;
+}
+
+/* After curl_global_init(). Without a share handles still work, each
+ * with its own caches. */
+static void pool_init(void) {
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+        pthread_mutex_init(&pool.locks[i], NULL);
+    pool.share = curl_share_init();
+    if (!pool.share) return;
+    curl_share_setopt(pool.share, CURLSHOPT_LOCKFUNC, pool_lock);
+    curl_share_setopt(pool.share, CURLSHOPT_UNLOCKFUNC, pool_unlock);
+    curl_share_setopt(pool.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(pool.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    if (curl_share_setopt(pool.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT) != CURLSHE_OK)
+        fprintf(stderr, "dictator: libcurl cannot share connections, reuse is per handle\n");
+}
+
+/* A handle for `host` with the common options set; give it back with
+ * pool_put() */
+static CURL *pool_get(enum api_host host) {
+    CURL *curl = NULL;
+    if (net_cancel) {
+        curl = solo_curl;
+        solo_curl = NULL;
+    } else {
+        pthread_mutex_lock(&pool.lock);
+        if (pool.nidle[host] > 0)
+            curl = pool.idle[host][--pool.nidle[host]];
+        pthread_mutex_unlock(&pool.lock);
+    }
+    if (!curl && !(curl = curl_easy_init())) return NULL;
+
+    if (net_cancel) {
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, cancel_xferinfo);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, net_cancel);
+    } else if (pool.share) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, pool.share);
+    }
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, 30L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 15L);
+    curl_easy_setopt(curl, CURLOPT_MAXAGE_CONN, POOL_MAX_IDLE_S);
     if (cfg.proxy[0])
         curl_easy_setopt(curl, CURLOPT_PROXY, cfg.proxy);
+    return curl;
+}
+
+/* Return a handle: its options are reset, its connections stay open */
+static void pool_put(enum api_host host, CURL *curl) {
+    if (!curl) return;
+    curl_easy_reset(curl);
+    if (net_cancel) {
+        if (solo_curl) curl_easy_cleanup(solo_curl);
+        solo_curl = curl;
+        return;
+    }
+    pthread_mutex_lock(&pool.lock);
+    if (pool.nidle[host] < POOL_HANDLES) {
+        pool.idle[host][pool.nidle[host]++] = curl;
+        curl = NULL;
+    }
+    pthread_mutex_unlock(&pool.lock);
+    if (curl) curl_easy_cleanup(curl);
+}
+
+/* Before curl_global_cleanup() */
+static void pool_shutdown(void) {
+    for (int h = 0; h < HOST_COUNT; h++)
+        while (pool.nidle[h] > 0)
+            curl_easy_cleanup(pool.idle[h][--pool.nidle[h]]);
+    if (pool.share) curl_share_cleanup(pool.share);
+    pool.share = NULL;
+}
+
+/* One line per request: how much of it was connection setup */
+static void pool_log_timing(CURL *curl, const char *label) {
+    curl_off_t dns = 0, conn = 0, tls = 0, total = 0;
+    long fresh = 0;
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &conn);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &fresh);
+    printf("dictator: %s: %s, dns %.1f ms, connect %.1f ms, tls %.1f ms, total %.0f ms\n",
+           label, fresh ? "new connection" : "reused connection",
+           dns / 1000.0, conn / 1000.0, tls / 1000.0, total / 1000.0);
+}
+
+/* ── Session deadline ───────────────────────────────────────────────── */
+
+/*
+ * A dictation's text is due latency_slo_ms after release, plus
+ * DEADLINE_MS_PER_S for every second of audio. Every network stage
+ * after release runs against that one deadline: a transfer's timeout is
+ * what is left of it (never more than NET_TIMEOUT_MS), sleeps between
+ * retries and polls end at it, and a fallback only starts if it can
+ * plausibly finish before it. Missing it is reported once, as such,
+ * instead of as whatever error the cut-off transfer ran into. The
+ * deadline is per thread, like net_cancel; hedge threads inherit it.
+ * Threads started while recording (warm-up, live upload, realtime) pick
+ * it up from session_deadline once it is set.
+ */
+
+#define DEADLINE_MS_PER_S  250.0
+#define DEADLINE_SLACK_MS  20.0      /* curl's timers are not exact */
+#define NET_TIMEOUT_MS     120000.0  /* any one transfer */
+
+static _Thread_local double net_deadline;   /* mono_ms(), 0 = none */
+static _Atomic double       session_deadline;   /* the main thread's */
+static int deadline_reported;
+
+static void deadline_start(double audio_s) {
+    net_deadline = mono_ms() + cfg.latency_slo_ms + audio_s * DEADLINE_MS_PER_S;
+    session_deadline = net_deadline;
+    deadline_reported = 0;
+}
+
+static void deadline_end(void) {
+    net_deadline = 0;
+    session_deadline = 0;
+}
+
+/* In a thread started while recording: run against the session's
+ * deadline, if it has one yet */
+static void deadline_adopt(void) {
+    net_deadline = session_deadline;
+}
+
+/* ms until the deadline, HUGE_VAL without one */
+static double deadline_left(void) {
+    return net_deadline ? net_deadline - mono_ms() : HUGE_VAL;
+}
+
+static int deadline_passed(void) {
+    return deadline_left() <= DEADLINE_SLACK_MS;
+}
+
+/* Timeout for a transfer starting now */
+static long net_timeout_ms(void) {
+    double left = deadline_left();
+    if (left > NET_TIMEOUT_MS) left = NET_TIMEOUT_MS;
+    return left < 1 ? 1 : (long)ceil(left);
+}
+
+/* Progress callback of such a thread's transfer: abort at the deadline */
+static int deadline_xferinfo(void *p, curl_off_t dltotal, curl_off_t dlnow,
+                             curl_off_t ultotal, curl_off_t ulnow) {
+    (void)p; (void)dltotal; (void)dlnow; (void)ultotal; (void)ulnow;
+    deadline_adopt();
+    return deadline_passed();
+}
+
+/* `what` can't finish in time. The first report of a session also goes
+ * to the desktop; a hedge's never does, the main path will tell. */
+static void deadline_exceeded(const char *what) {
+    fprintf(stderr, "dictator: %s: deadline exceeded\n", what);
+    if (net_cancel || deadline_reported) return;
+    deadline_reported = 1;
+    notify("Deadline exceeded, transcription abandoned");
+}
+
+/* ── Connection warm-up ─────────────────────────────────────────────── */
+
+/*
+ * On key press a background HEAD request to the backend that will get
+ * the upload resolves DNS and finishes TCP + TLS (+ proxy CONNECT) while
+ * the user is still speaking. The connection lands in the shared cache
+ * and the upload after release reuses it. If the pool already holds a
+ * live connection the HEAD just goes out on it.
+ */
+
+#define WARM_TIMEOUT_MS 10000L
+
+static const char *host_base[HOST_COUNT] = {
+    [HOST_GROQ] = "https://api.groq.com/",
+    [HOST_AAI]  = "https://api.assemblyai.com/",
+};
+
+static const char *const host_label[HOST_COUNT] = {
+    [HOST_GROQ] = "groq",
+    [HOST_AAI]  = "aai",
+};
+
+static struct {
+    pthread_t     tid;
+    int           active;       /* thread not joined yet */
+    atomic_int    busy;         /* thread still connecting */
+    int           late;         /* cut off at the deadline */
+    enum api_host host;
+} warm;
+
+static size_t discard_cb(void *ptr, size_t size, size_t nmemb, void *userp) {
+    (void)ptr; (void)userp;
+    return size * nmemb;
+}
+
+static void *warm_thread(void *arg) {
+    (void)arg;
+    CURL *curl = pool_get(warm.host);
+    if (!curl) {
+        warm.busy = 0;
+        return NULL;
+    }
+    curl_easy_setopt(curl, CURLOPT_URL, host_base[warm.host]);
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard_cb);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, WARM_TIMEOUT_MS);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, deadline_xferinfo);
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    CURLcode res = curl_easy_perform(curl);
+    if (res == CURLE_ABORTED_BY_CALLBACK) {
+        warm.late = 1;   /* warm_join() reports it */
+    } else if (res != CURLE_OK) {
+        /* not fatal: the upload will connect on its own */
+        fprintf(stderr, "dictator: warm-up %s: %s\n", host_label[warm.host],
+                curl_easy_strerror(res));
+    } else {
+        curl_off_t conn = 0, tls = 0;
+        long fresh = 0;
+        curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &conn);
+        curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &tls);
+        curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &fresh);
+        if (fresh)
+            printf("dictator: warm-up %s: %.0f ms of DNS + TCP + TLS hidden behind speech\n",
+                   host_label[warm.host], (tls ? tls : conn) / 1000.0);
+        else
+            printf("dictator: warm-up %s: connection already open\n",
+                   host_label[warm.host]);
+    }
+    pool_put(warm.host, curl);
+    warm.busy = 0;
+    return NULL;
+}
+
+/* Wait for the previous warm-up, if any. It has the shared connection
+ * cache until it is done; past the deadline it aborts within a progress
+ * tick. */
+static void warm_join(void) {
+    if (!warm.active) return;
+    pthread_join(warm.tid, NULL);
+    warm.active = 0;
+    if (warm.late) deadline_exceeded("warm-up");
+    warm.late = 0;
+}
+
+/* Key pressed for `act`: connect to the backend that will get the upload.
+ * Never blocks the hotkey loop; a warm-up still in flight is left alone. */
+static void warm_start(enum action act) {
+    if (!have_groq && (act == ACT_TRANSLATE || !have_aai)) return;
+    if (warm.busy) return;
+    warm_join();
+    warm.host = have_groq ? HOST_GROQ : HOST_AAI;
+    warm.busy = 1;
+    warm.active = pthread_create(&warm.tid, NULL, warm_thread, NULL) == 0;
+    if (!warm.active) warm.busy = 0;
+}
+
+/* ── Circuit breaker ────────────────────────────────────────────────── */
+
+/*
+ * Every transcription call reports back to its backend's breaker. A
+ * failure retrying could fix (network error, timeout, 429, 5xx) or an
+ * answer slower than real time plus BREAKER_SLOW_MS counts against it.
+ * Once half of the last BREAKER_WINDOW calls (at least
+ * BREAKER_MIN_CALLS) went bad the circuit opens and the backend is
+ * skipped, so a press during an outage goes straight to the other one
+ * instead of paying the failure latency first. After the cooldown it is
+ * half-open: one probe call goes through, and its outcome closes the
+ * circuit or opens it again for twice as long.
+ */
+
+#define BREAKER_WINDOW          10
+#define BREAKER_MIN_CALLS       4
+#define BREAKER_SLOW_MS         10000.0   /* on top of the audio's length */
+#define BREAKER_COOLDOWN_MS     30000.0
+#define BREAKER_COOLDOWN_MAX_MS 300000.0
+
+enum breaker_state { BREAKER_CLOSED, BREAKER_OPEN, BREAKER_HALF_OPEN };
+
+static const char *const breaker_names[] = { "closed", "open", "half-open" };
+static const char *const host_names[HOST_COUNT] = { "Groq", "AssemblyAI" };
+
+static struct breaker {
+    enum breaker_state state;
+    uint8_t            bad[BREAKER_WINDOW];   /* recent calls, 1 = failed or slow */
+    int                n, next;
+    double             cooldown_ms;
+    struct timespec    since;                 /* opened, or probe sent */
+} breakers[HOST_COUNT];
+static pthread_mutex_t breaker_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* A state change, announced once breaker_lock is released: notify()
+ * runs a command */
+struct breaker_change {
+    enum breaker_state from, to;   /* equal when nothing changed */
+    double             cooldown_ms;
+};
+
+/* With breaker_lock held */
+static struct breaker_change breaker_set(enum api_host h, enum breaker_state state) {
+    struct breaker *b = &breakers[h];
+    struct breaker_change c = { b->state, state, b->cooldown_ms };
+    if (state == BREAKER_CLOSED) b->cooldown_ms = BREAKER_COOLDOWN_MS;
+    b->state = state;
+    b->n = b->next = 0;
+    clock_gettime(CLOCK_MONOTONIC, &b->since);
+    return c;
+}
+
+static void breaker_announce(enum api_host h, struct breaker_change c) {
+    if (c.from == c.to) return;
+    printf("dictator: %s circuit %s -> %s\n", host_names[h],
+           breaker_names[c.from], breaker_names[c.to]);
+    char msg[128];
+    if (c.to == BREAKER_OPEN) {
+        snprintf(msg, sizeof(msg), "%s is failing, skipping it for %.0f s",
+                 host_names[h], c.cooldown_ms / 1000.0);
+        notify(msg);
+    } else if (c.to == BREAKER_CLOSED) {
+        snprintf(msg, sizeof(msg), "%s is back", host_names[h]);
+        notify(msg);
+    }
+}
+
+/* Whether a call may go to h now. Past the cooldown this hands out the
+ * half-open probe; a probe that never reported is replaced after
+ * another cooldown. */
+static int breaker_allow(enum api_host h) {
+    struct breaker *b = &breakers[h];
+    pthread_mutex_lock(&breaker_lock);
+    struct breaker_change c = { b->state, b->state, 0 };
+    int ok = b->state == BREAKER_CLOSED;
+    if (!ok && ms_since(&b->since) >= b->cooldown_ms) {
+        if (b->state == BREAKER_OPEN) c = breaker_set(h, BREAKER_HALF_OPEN);
+        clock_gettime(CLOCK_MONOTONIC, &b->since);
+        ok = 1;
+    }
+    pthread_mutex_unlock(&breaker_lock);
+    breaker_announce(h, c);
+    return ok;
+}
+
+/* A probe is out; its verdict is worth waiting for */
+static int breaker_probing(enum api_host h) {
+    pthread_mutex_lock(&breaker_lock);
+    int probing = breakers[h].state == BREAKER_HALF_OPEN;
+    pthread_mutex_unlock(&breaker_lock);
+    return probing;
+}
+
+/* Outcome of one call to h on audio_s seconds of audio that took ms */
+static void breaker_record(enum api_host h, int failed, double ms, double audio_s) {
+    if (failed && deadline_passed()) return;   /* cut off by us, not down */
+    struct breaker *b = &breakers[h];
+    int bad = failed || ms > BREAKER_SLOW_MS + audio_s * 1000.0;
+    pthread_mutex_lock(&breaker_lock);
+    struct breaker_change c = { b->state, b->state, 0 };
+    if (!b->cooldown_ms) b->cooldown_ms = BREAKER_COOLDOWN_MS;
+    if (b->state == BREAKER_HALF_OPEN) {
+        if (bad) {
+            b->cooldown_ms *= 2;
+            if (b->cooldown_ms > BREAKER_COOLDOWN_MAX_MS) b->cooldown_ms = BREAKER_COOLDOWN_MAX_MS;
+            c = breaker_set(h, BREAKER_OPEN);
+        } else {
+            c = breaker_set(h, BREAKER_CLOSED);
+        }
+    } else if (b->state == BREAKER_CLOSED) {
+        b->bad[b->next] = (uint8_t)bad;
+        b->next = (b->next + 1) % BREAKER_WINDOW;
+        if (b->n < BREAKER_WINDOW) b->n++;
+        int nbad = 0;
+        for (int i = 0; i < b->n; i++) nbad += b->bad[i];
+        if (b->n >= BREAKER_MIN_CALLS && 2 * nbad >= b->n)
+            c = breaker_set(h, BREAKER_OPEN);
+    }
+    /* while open, late answers to calls sent before are ignored */
+    pthread_mutex_unlock(&breaker_lock);
+    breaker_announce(h, c);
+}
+
+/* ── Rate limits and retries ────────────────────────────────────────── */
+
+/*
+ * Requests to each backend are paced by a token bucket: groq_rpm /
+ * aai_rpm per minute with bursts of up to API_BURST_S worth, or
+ * unlimited at 0. The server's own word takes precedence. A 429, or a
+ * response saying the request budget is spent, pauses every request to
+ * that host until the Retry-After (or x-ratelimit-reset-*) time. Failed
+ * requests are retried after that hint or, without one, after an
+ * exponential backoff with jitter, so chunks that failed together do not
+ * come back together. Only requests safe to repeat are retried.
+ */
+
+#define API_RETRIES          3        /* extra attempts per request */
+#define API_BACKOFF_MS       250      /* first backoff, doubling */
+#define API_BACKOFF_MAX_MS   8000
+#define API_RETRY_BUDGET_MS  20000.0  /* no retry would end later than this */
+#define API_BURST_S          10.0
+
+/* What a failed request may be repeated for */
+enum api_retry {
+    RETRY_NEVER,
+    RETRY_REJECTED,     /* only if it was refused unprocessed: 429, 503, no connection */
+    RETRY_IDEMPOTENT,   /* also timeouts, dropped connections and other 5xx */
+};
+
+static struct bucket {
+    double tokens;
+    double refilled;     /* mono_ms() of the last refill, 0 = never used */
+    double paused;       /* no requests before this mono_ms() */
+} buckets[HOST_COUNT];
+static pthread_mutex_t bucket_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static _Thread_local uint32_t jitter_rng;
+
+static long jitter(long range) {
+    if (range <= 0) return 0;
+    if (!jitter_rng)
+        jitter_rng = (uint32_t)mono_ms() ^ (uint32_t)(uintptr_t)&jitter_rng ^ 0x9E3779B9u;
+    jitter_rng ^= jitter_rng << 13;   /* xorshift32 */
+    jitter_rng ^= jitter_rng >> 17;
+    jitter_rng ^= jitter_rng << 5;
+    return (long)(jitter_rng % (uint32_t)(range + 1));
+}
+
+static int host_rpm(enum api_host h) {
+    return h == HOST_GROQ ? cfg.groq_rpm : cfg.aai_rpm;
+}
+
+/* ms until a request to h may go out; 0 means now, and takes a token */
+static long bucket_take(enum api_host h) {
+    struct bucket *b = &buckets[h];
+    double now = mono_ms(), rate = host_rpm(h) / 60000.0, wait = 0;
+    pthread_mutex_lock(&bucket_lock);
+    if (b->paused > now) {
+        wait = b->paused - now;
+    } else if (rate > 0) {
+        double burst = rate * API_BURST_S * 1000.0;
+        if (burst < 1) burst = 1;
+        b->tokens = b->refilled ? b->tokens + (now - b->refilled) * rate : burst;
+        if (b->tokens > burst) b->tokens = burst;
+        b->refilled = now;
+        if (b->tokens >= 1)
+            b->tokens -= 1;
+        else
+            wait = (1 - b->tokens) / rate;
+    }
+    pthread_mutex_unlock(&bucket_lock);
+    return wait > 0 ? (long)ceil(wait) : 0;
+}
+
+/* Return a token bucket_take() handed out for a request that did not go */
+static void bucket_give_back(enum api_host h) {
+    if (host_rpm(h) <= 0) return;
+    pthread_mutex_lock(&bucket_lock);
+    buckets[h].tokens += 1;
+    pthread_mutex_unlock(&bucket_lock);
+}
+
+/* Sleep until a request to h may go. -1 if the thread was cancelled or
+ * the wait would outlast the retry budget (a daily limit, say) or the
+ * deadline. */
+static int bucket_wait(enum api_host h, const char *label) {
+    long wait;
+    while ((wait = bucket_take(h)) > 0) {
+        if (wait > API_RETRY_BUDGET_MS) {
+            fprintf(stderr, "dictator: %s: rate limited for %.0f s, not waiting\n",
+                    label, wait / 1000.0);
+            if (!net_cancel) notify("Rate limit reached");
+            return -1;
+        }
+        if (wait >= deadline_left()) {
+            deadline_exceeded(label);
+            return -1;
+        }
+        if (net_sleep(wait) < 0) return -1;
+    }
+    return 0;
+}
+
+static void bucket_pause(enum api_host h, long ms) {
+    double until = mono_ms() + (double)ms;
+    pthread_mutex_lock(&bucket_lock);
+    if (until > buckets[h].paused) buckets[h].paused = until;
+    pthread_mutex_unlock(&bucket_lock);
+}
+
+/* "2m59.56s", "7.66s", "250ms", "1h" or plain seconds, in ms; -1 if
+ * unparseable */
+static double parse_duration_ms(const char *s) {
+    double total = 0;
+    if (!*s) return -1;
+    while (*s) {
+        char *end;
+        double v = strtod(s, &end);
+        if (end == s || v < 0) return -1;
+        if (strncmp(end, "ms", 2) == 0)  { total += v;           end += 2; }
+        else if (*end == 's' || !*end)   { total += v * 1000.0;  end += !!*end; }
+        else if (*end == 'm')            { total += v * 60000.0; end++; }
+        else if (*end == 'h')            { total += v * 3.6e6;   end++; }
+        else return -1;
+        s = end;
+    }
+    return total;
+}
+
+static const char *header_value(CURL *curl, const char *name) {
+    struct curl_header *h;
+    if (curl_easy_header(curl, name, 0, CURLH_HEADER, -1, &h) != CURLHE_OK) return NULL;
+    return h->value;
+}
+
+/* When the server says to come back, in ms, or -1 if it doesn't: the
+ * Retry-After header (seconds or a date), else the reset time of a
+ * request or token budget it reports as spent */
+static long server_retry_ms(CURL *curl) {
+    curl_off_t after = -1;
+    if (curl_easy_getinfo(curl, CURLINFO_RETRY_AFTER, &after) == CURLE_OK && after > 0)
+        return (long)after * 1000;
+    static const char *const budgets[][2] = {
+        { "x-ratelimit-remaining-requests", "x-ratelimit-reset-requests" },
+        { "x-ratelimit-remaining-tokens",   "x-ratelimit-reset-tokens" },
+    };
+    double ms = -1;
+    for (size_t i = 0; i < sizeof(budgets) / sizeof(budgets[0]); i++) {
+        const char *left = header_value(curl, budgets[i][0]);
+        const char *reset = header_value(curl, budgets[i][1]);
+        if (!left || !reset || atof(left) > 0) continue;
+        double v = parse_duration_ms(reset);
+        if (v > ms) ms = v;
+    }
+    return ms < 0 ? -1 : (long)ceil(ms);
+}
+
+/* Learn from a finished transfer to host, then decide on a retry: the ms
+ * to wait before attempt+1, or -1 for no retry */
+static long api_retry_ms(CURL *curl, CURLcode res, enum api_host host,
+                         enum api_retry retry, int attempt) {
+    long code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+    long hint = res == CURLE_OK ? server_retry_ms(curl) : -1;
+    if (hint > 0 && (code == 429 || code == 503 || (code >= 200 && code < 300))) {
+        if (code == 429)
+            fprintf(stderr, "dictator: %s rate limited for %ld ms\n", host_names[host], hint);
+        bucket_pause(host, hint);   /* spent: hold the others back too */
+    }
+    if (res == CURLE_OK && code >= 200 && code < 300) return -1;
+    if (res == CURLE_ABORTED_BY_CALLBACK || retry == RETRY_NEVER || attempt > API_RETRIES)
+        return -1;
+    int rejected = res == CURLE_COULDNT_CONNECT || res == CURLE_COULDNT_RESOLVE_HOST ||
+                   (res == CURLE_OK && (code == 429 || code == 503));
+    int transient = res != CURLE_OK || code == 408 || code >= 500;
+    if (!rejected && !(retry == RETRY_IDEMPOTENT && transient)) return -1;
+    if (hint >= 0) return hint + jitter(API_BACKOFF_MS);
+    long cap = API_BACKOFF_MS << (attempt - 1);
+    if (cap > API_BACKOFF_MAX_MS) cap = API_BACKOFF_MAX_MS;
+    return cap / 2 + jitter(cap / 2);
+}
+
+/* ── Shared curl helper ─────────────────────────────────────────────── */
+
+/* Options every API request uses; the body goes to resp and the
+ * transfer gets what is left of the deadline. HTTP/2 is
+ * negotiated over TLS where the server offers it, so transfers to the
+ * same host multiplex on one connection. */
+static void api_setup(CURL *curl, struct curl_slist *headers, struct response *resp) {
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, resp);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, net_timeout_ms());
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+}
+
+/* Check a finished transfer. With `report` errors also go to a desktop
+ * notification. */
+static int api_check(CURL *curl, CURLcode res, struct response *resp,
+                     const char *label, int report) {
+    if (res != CURLE_OK) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "Network error: %s", curl_easy_strerror(res));
+        if (report) notify(msg);
+        fprintf(stderr, "dictator: %s curl: %s\n", label, curl_easy_strerror(res));
+        return -1;
+    }
+    pool_log_timing(curl, label);
+
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    if (http_code < 200 || http_code >= 300) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "API error %ld (%s)", http_code, label);
+        if (report) notify(msg);
+        fprintf(stderr, "dictator: %s: %s\n", msg, resp->data ? resp->data : "");
+        return -1;
+    }
+    return 0;
+}
+
+/* Perform request, check for errors, return response. A failure `retry`
+ * allows is repeated after api_retry_ms(), within API_RETRY_BUDGET_MS
+ * and the deadline; `body`, if the request reads one, is rewound first.
+ * Every attempt waits for a token from host's bucket.
+ * Caller must free resp->data. Returns 0 on success, -1 on failure. */
+static int api_request(CURL *curl, struct curl_slist *headers, struct response *resp,
+                       const char *label, enum api_host host, enum api_retry retry,
+                       struct body *body) {
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int attempt = 1;; attempt++) {
+        if (deadline_passed()) {
+            deadline_exceeded(label);
+            return -1;
+        }
+        if (bucket_wait(host, label) < 0) return -1;
+        api_setup(curl, headers, resp);
+        CURLcode res = curl_easy_perform(curl);
+        if (res == CURLE_OPERATION_TIMEDOUT && deadline_passed()) {
+            deadline_exceeded(label);
+            return -1;
+        }
+        long wait = api_retry_ms(curl, res, host, retry, attempt);
+        if (wait >= 0 && (ms_since(&t0) + (double)wait > API_RETRY_BUDGET_MS ||
+                          (double)wait >= deadline_left()))
+            wait = -1;
+        /* a hedge's errors are not the user's: the other backend may answer */
+        int rc = api_check(curl, res, resp, label, !net_cancel && wait < 0);
+        if (rc == 0 || wait < 0) return rc;
+        fprintf(stderr, "dictator: %s: retrying in %ld ms\n", label, wait);
+        free(resp->data);
+        *resp = (struct response){0};
+        if (body) body_seek(body, 0, SEEK_SET);
+        if (net_sleep(wait) < 0) return -1;
+    }
+}
+
+/* Trim leading and trailing whitespace in place */
+static void trim_text(char *s) {
+    if (!s) return;
+    size_t len = strlen(s);
+    while (len > 0 && (s[len-1] == '\n' || s[len-1] == '\r' || s[len-1] == ' '))
+        s[--len] = '\0';
+    char *start = s;
+    while (*start == ' ' || *start == '\n' || *start == '\r')
+        start++;
+    if (start != s)
+        memmove(s, start, strlen(start) + 1);
+}
+
+/* ── Groq Whisper API ──────────────────────────────────────────────── */
+
+/* Build the multipart upload of `a` on curl. The caller frees *mime and
+ * *headers. Returns -1 if the audio could not be encoded. */
+static int groq_setup(CURL *curl, struct audio *a, int translate,
+                      curl_mime **mime, struct curl_slist **headers) {
+    struct body *b = malloc(sizeof(*b));
+    if (!b || audio_body(a, cfg.groq_codec, b) < 0) {
+        free(b);
+        notify("Audio encoding failed");
+        return -1;
+    }
+    const struct codec_info *ci = &codecs[cfg.groq_codec];
+
+    *headers = curl_slist_append(NULL, groq_key);
+    *mime = curl_mime_init(curl);
+
+    /* the part owns b and frees it with the mime */
+    curl_mimepart *part = curl_mime_addpart(*mime);
+    curl_mime_name(part, "file");
+    curl_mime_data_cb(part, (curl_off_t)b->len, body_read, body_seek, free, b);
+    curl_mime_filename(part, ci->filename);
+    curl_mime_type(part, ci->mime);
+
+    part = curl_mime_addpart(*mime);
+    curl_mime_name(part, "model");
+    curl_mime_data(part, cfg.groq_model, CURL_ZERO_TERMINATED);
+
+    part = curl_mime_addpart(*mime);
+    curl_mime_name(part, "response_format");
+    curl_mime_data(part, a->timed ? "verbose_json" : "text", CURL_ZERO_TERMINATED);
+    if (a->timed) {
+        part = curl_mime_addpart(*mime);
+        curl_mime_name(part, "timestamp_granularities[]");
+        curl_mime_data(part, "word", CURL_ZERO_TERMINATED);
+    }
+
+    char url[256];
+    snprintf(url, sizeof(url), "%sopenai/v1/audio/%s", host_base[HOST_GROQ],
+             translate ? "translations" : "transcriptions");
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_MIMEPOST, *mime);
+    return 0;
+}
+
+/* Feed a finished Groq transfer to the breaker. A bad request says
+ * nothing about health, and rate limits are the buckets' business. */
+static void groq_record(CURL *curl, int rc, struct audio *a) {
+    long code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+    if (rc < 0 && code != 0 && code != 408 && (code < 500 || code == 429)) return;
+    curl_off_t us = 0;
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &us);
+    breaker_record(HOST_GROQ, rc < 0, (double)us / 1000.0, (double)a->n / SAMPLE_RATE);
+}
+
+static char *groq_audio(struct audio *a, int translate) {
+    CURL *curl = pool_get(HOST_GROQ);
+    if (!curl) return NULL;
+
+    curl_mime *mime = NULL;
+    struct curl_slist *headers = NULL;
+    struct response resp = {0};
+    int rc = groq_setup(curl, a, translate, &mime, &headers);
+    if (rc == 0) {
+        rc = api_request(curl, headers, &resp, "groq", HOST_GROQ, RETRY_IDEMPOTENT, NULL);
+        groq_record(curl, rc, a);
+    }
+    if (rc < 0) {
+        curl_mime_free(mime);
+        curl_slist_free_all(headers);
+        pool_put(HOST_GROQ, curl);
+        free(resp.data);
+        return NULL;
+    }
+
+    curl_mime_free(mime);
+    curl_slist_free_all(headers);
+    pool_put(HOST_GROQ, curl);
+
+    trim_text(resp.data);
+    return resp.data;
+}
+
+static char *transcribe_groq(struct audio *a) {
+    return groq_audio(a, 0);
+}
+
+static char *translate_groq(struct audio *a) {
+    return groq_audio(a, 1);
+}
+
+/* ── AssemblyAI transcription API ──────────────────────────────────── */
+
+/*
+ * Job polling. Jobs take a fraction of the audio length, short clips a
+ * few hundred ms, so the first poll goes out at about the expected job
+ * time and later ones back off geometrically. The expectation is a
+ * running average of observed job time per second of audio (+1 s for
+ * fixed overhead), so it follows how fast the service is today. The
+ * wait is bounded by a deadline that grows with the audio.
+ */
+
+#define AAI_POLL_MIN_MS   150
+#define AAI_POLL_MAX_MS   2000
+#define AAI_POLL_GROWTH   1.5
+#define AAI_JOB_PRIOR_MS  120.0    /* per second of audio + 1, until observed */
+#define AAI_JOB_ALPHA     0.3      /* weight of the newest observation */
+#define AAI_DEADLINE_MS   30000.0  /* plus the audio length */
+#define AAI_SETUP_MS      1500.0   /* upload and submit, before the job runs */
+
+static struct {
+    double ms_per_s;   /* job time per (second of audio + 1) */
+    int    observed;
+} aai_jobs = { .ms_per_s = AAI_JOB_PRIOR_MS };
+static pthread_mutex_t aai_jobs_lock = PTHREAD_MUTEX_INITIALIZER;   /* hedges poll too */
+
+static double aai_expected_ms(double audio_s) {
+    pthread_mutex_lock(&aai_jobs_lock);
+    double ms = aai_jobs.ms_per_s * (audio_s + 1.0);
+    pthread_mutex_unlock(&aai_jobs_lock);
+    return ms;
+}
+
+/* Delay from submit to the first poll */
+static long aai_first_poll_ms(double audio_s) {
+    double ms = 0.8 * aai_expected_ms(audio_s);
+    return ms < AAI_POLL_MIN_MS ? AAI_POLL_MIN_MS : (long)ms;
+}
+
+/* Gap before the second poll; each later one is AAI_POLL_GROWTH longer */
+static long aai_poll_step_ms(double audio_s) {
+    double ms = 0.1 * aai_expected_ms(audio_s);
+    if (ms < AAI_POLL_MIN_MS) ms = AAI_POLL_MIN_MS;
+    if (ms > AAI_POLL_MAX_MS) ms = AAI_POLL_MAX_MS;
+    return (long)ms;
+}
+
+static double aai_deadline_ms(double audio_s) {
+    return AAI_DEADLINE_MS + audio_s * 1000.0;
+}
+
+/* Whether a whole AssemblyAI round trip for audio_s fits in what is
+ * left of the deadline */
+static int aai_in_time(double audio_s) {
+    return AAI_SETUP_MS + aai_expected_ms(audio_s) < deadline_left();
+}
+
+static void aai_job_observed(double audio_s, double ms) {
+    double v = ms / (audio_s + 1.0);
+    pthread_mutex_lock(&aai_jobs_lock);
+    aai_jobs.ms_per_s = aai_jobs.observed++
+        ? (1.0 - AAI_JOB_ALPHA) * aai_jobs.ms_per_s + AAI_JOB_ALPHA * v : v;
+    pthread_mutex_unlock(&aai_jobs_lock);
+}
+
+/* Upload step: POST body b, set up on curl, to /v2/upload and return
+ * the upload_url, or NULL */
+static char *aai_post_upload(CURL *curl, struct curl_slist *headers, const char *label,
+                             struct body *b) {
+    char url[512];
+    snprintf(url, sizeof(url), "%sv2/upload", host_base[HOST_AAI]);
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+
+    struct response resp = {0};
+    if (api_request(curl, headers, &resp, label, HOST_AAI, RETRY_IDEMPOTENT, b) < 0) {
+        free(resp.data);
+        return NULL;
+    }
+    char *upload_url = json_get_string(resp.data, "upload_url");
+    free(resp.data);
+    if (!upload_url) notify("Upload failed: no URL returned");
+    return upload_url;
+}
+
+/* Submit a transcription job for audio_s seconds of uploaded audio and
+ * wait for its text, or with `timed` the whole transcript JSON */
+static char *aai_transcript(const char *upload_url, double audio_s, int timed) {
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int failed = 1;   /* for the breaker: a job error is the audio's fault */
+    struct curl_slist *headers = NULL;
+    headers = curl_slist_append(headers, aai_key);
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+
+    /* ── Step 2: Submit transcription job ─────────────────────────── */
+    CURL *curl = pool_get(HOST_AAI);
+    if (!curl) { curl_slist_free_all(headers); return NULL; }
+
+    char url[512];
+    snprintf(url, sizeof(url), "%sv2/transcript", host_base[HOST_AAI]);
+    char body[1024];
+    snprintf(body, sizeof(body),
+             "{\"audio_url\": \"%s\", \"speech_models\": [\"universal-3-pro\", \"universal-2\"]}", upload_url);
+
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body);
+
+    struct response resp = {0};
+    /* a repeated submit could start a second job */
+    if (api_request(curl, headers, &resp, "aai-submit", HOST_AAI, RETRY_REJECTED, NULL) < 0) {
+        free(resp.data);
+        pool_put(HOST_AAI, curl);
+        curl_slist_free_all(headers);
+        if (!net_cancelled()) breaker_record(HOST_AAI, 1, ms_since(&t0), audio_s);
+        return NULL;
+    }
+
+    char *transcript_id = json_get_string(resp.data, "id");
+    free(resp.data);
+    pool_put(HOST_AAI, curl);
+    struct timespec submitted;
+    clock_gettime(CLOCK_MONOTONIC, &submitted);
+
+    if (!transcript_id) {
+        notify("Transcription submit failed: no ID returned");
+        curl_slist_free_all(headers);
+        if (!net_cancelled()) breaker_record(HOST_AAI, 1, ms_since(&t0), audio_s);
+        return NULL;
+    }
+
+    /* ── Step 3: Poll for completion ──────────────────────────────── */
+    char poll_url[512];
+    snprintf(poll_url, sizeof(poll_url), "%sv2/transcript/%s",
+             host_base[HOST_AAI], transcript_id);
+    free(transcript_id);
+
+    /* Switch headers back (no Content-Type needed for GET) */
+    curl_slist_free_all(headers);
+    headers = NULL;
+    headers = curl_slist_append(headers, aai_key);
+
+    /* one handle for the whole loop: every poll reuses the connection */
+    char *result = NULL;
+    long wait = aai_first_poll_ms(audio_s), step = aai_poll_step_ms(audio_s);
+    double deadline = aai_deadline_ms(audio_s);
+    int polls = 0;
+    curl = pool_get(HOST_AAI);
+    while (curl) {
+        double left = deadline - ms_since(&submitted);
+        if (deadline_left() < left) {
+            left = deadline_left();
+            if (left <= DEADLINE_SLACK_MS) {
+                deadline_exceeded("aai-poll");
+                failed = 0;   /* out of our time, not the job's */
+                break;
+            }
+        } else if (left <= 0) {
+            notify("Transcription timed out");
+            fprintf(stderr, "dictator: aai job not done after %.0f s, giving up\n",
+                    deadline / 1000.0);
+            break;
+        }
+        if (wait > left) wait = (long)left + 1;
+        if (net_sleep(wait) < 0) break;
+        polls++;
+
+        curl_easy_setopt(curl, CURLOPT_URL, poll_url);
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+
+        resp = (struct response){0};
+        if (api_request(curl, headers, &resp, "aai-poll", HOST_AAI, RETRY_IDEMPOTENT, NULL) < 0) {
+            free(resp.data);
+            break;
+        }
+
+        char *status = json_get_string(resp.data, "status");
+        if (status && strcmp(status, "completed") == 0) {
+            if (timed) {
+                result = resp.data;   /* words and all */
+                resp.data = NULL;
+            } else {
+                result = json_get_string(resp.data, "text");
+            }
+            double ms = ms_since(&submitted);
+            printf("dictator: aai job done in %.0f ms (expected %.0f), %d polls\n",
+                   ms, aai_expected_ms(audio_s), polls);
+            aai_job_observed(audio_s, ms);
+            failed = 0;
+            free(status);
+            free(resp.data);
+            break;
+        }
+        if (status && strcmp(status, "error") == 0) {
+            char *err = json_get_string(resp.data, "error");
+            char msg[256];
+            snprintf(msg, sizeof(msg), "Transcription error: %s",
+                     err ? err : "unknown");
+            notify(msg);
+            fprintf(stderr, "dictator: %s\n", msg);
+            fprintf(stderr, "dictator: response: %s\n",
+                    resp.data ? resp.data : "(null)");
+            free(err);
+            free(status);
+            free(resp.data);
+            failed = 0;
+            break;
+        }
+        free(status);
+        free(resp.data);
+        wait = step;
+        step = (long)(step * AAI_POLL_GROWTH);
+        if (step > AAI_POLL_MAX_MS) step = AAI_POLL_MAX_MS;
+    }
+    pool_put(HOST_AAI, curl);
+
+    curl_slist_free_all(headers);
+    if (!net_cancelled()) breaker_record(HOST_AAI, failed, ms_since(&t0), audio_s);
+
+    /* Trim trailing whitespace */
+    if (result) {
+        size_t len = strlen(result);
+        while (len > 0 && (result[len-1] == '\n' || result[len-1] == '\r'
+                           || result[len-1] == ' '))
+            result[--len] = '\0';
+    }
+    return result;
+}
+
+static char *transcribe_aai(struct audio *a) {
+    struct body b;
+    if (audio_body(a, cfg.aai_codec, &b) < 0) {
+        notify("Audio encoding failed");
+        return NULL;
+    }
+
+    struct curl_slist *headers = NULL;
+    headers = curl_slist_append(headers, aai_key);
+    headers = curl_slist_append(headers, "Content-Type: application/octet-stream");
+
+    /* ── Step 1: Upload audio ─────────────────────────────────────── */
+    CURL *curl = pool_get(HOST_AAI);
+    if (!curl) { curl_slist_free_all(headers); return NULL; }
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, body_read);
+    curl_easy_setopt(curl, CURLOPT_READDATA, &b);
+    curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, body_seek);
+    curl_easy_setopt(curl, CURLOPT_SEEKDATA, &b);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)b.len);
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    char *upload_url = aai_post_upload(curl, headers, "aai-upload", &b);
+    pool_put(HOST_AAI, curl);
+    curl_slist_free_all(headers);
+    double audio_s = (double)a->n / SAMPLE_RATE;
+    if (!upload_url) {
+        if (!net_cancelled()) breaker_record(HOST_AAI, 1, ms_since(&t0), audio_s);
+        return NULL;
+    }
+
+    char *result = aai_transcript(upload_url, audio_s, a->timed);
+    free(upload_url);
+    return result;
+}
+
+/* ── Transcription with fallback ───────────────────────────────────── */
+
+static char *transcribe(struct audio *a) {
+    if (deadline_passed()) {
+        deadline_exceeded("transcription");
+        return NULL;
+    }
+    int groq = have_groq && breaker_allow(HOST_GROQ);
+    if (groq) {
+        char *result = transcribe_groq(a);
+        if (result) return result;
+        fprintf(stderr, "dictator: Groq failed\n");
+    }
+    if (have_aai && !aai_in_time((double)a->n / SAMPLE_RATE)) {
+        deadline_exceeded("AssemblyAI fallback");
+        return NULL;
+    }
+    if (have_aai && breaker_allow(HOST_AAI)) {
+        if (groq) notify("Groq failed, trying AssemblyAI...");
+        return transcribe_aai(a);
+    }
+    if (!groq && (have_groq || have_aai))
+        notify("Transcription is down, try again shortly");
+    return NULL;
+}
+
+/* ── Translation (Groq only — AssemblyAI doesn't support it) ───────── */
+
+static char *translate(struct audio *a) {
+    if (!have_groq) {
+        notify("Translation requires Groq API key");
+        return NULL;
+    }
+    if (deadline_passed()) {
+        deadline_exceeded("translation");
+        return NULL;
+    }
+    if (!breaker_allow(HOST_GROQ)) {
+        notify("Groq is down, translation paused");
+        return NULL;
+    }
+    char *r = translate_groq(a);
+    if (!r && !deadline_passed()) notify("Translation failed");
+    return r;
+}
 
+/* ── AssemblyAI upload during capture ───────────────────────────────── */
+
+/*
+ * When AssemblyAI is the backend (no Groq key), /v2/upload takes a raw
+ * octet stream, so the upload starts on key press: a curl read callback
+ * is one more capture-ring consumer and sends a streaming WAV header
+ * followed by the samples as they arrive, with chunked transfer
+ * encoding. On release only the last few periods are left to send and
+ * the job is submitted right away. The live body is the raw capture, so
+ * VAD and time compression don't apply to it. If the ring overflowed or
+ * the transfer failed, the normal upload after release takes over.
+ */
+
+#define AAI_LIVE_RING (PREROLL_RING + 15 * SAMPLE_RATE)   /* rides out a slow connect */
+
+static struct {
+    struct pcm_ring ring;
+    pthread_t       tid;
+    int             active;
+    uint8_t         hdr[WAV_HEADER];
+    size_t          hdr_sent;
+    size_t          sent;         /* samples sent */
+    char           *upload_url;   /* set by the thread on success */
+    int             late;         /* cut off at the deadline */
+    struct timespec released;
+} aai_live;
+
+static size_t aai_live_read(char *buf, size_t size, size_t nitems, void *userp) {
+    (void)userp;
+    size_t room = size * nitems;
+    if (aai_live.hdr_sent < WAV_HEADER) {
+        size_t n = WAV_HEADER - aai_live.hdr_sent;
+        if (n > room) n = room;
+        memcpy(buf, aai_live.hdr + aai_live.hdr_sent, n);
+        aai_live.hdr_sent += n;
+        return n;
+    }
+    int16_t tmp[PERIOD_FRAMES];
+    size_t max = room / FRAME_SIZE < PERIOD_FRAMES ? room / FRAME_SIZE : PERIOD_FRAMES;
+    for (;;) {
+        size_t n = pcm_ring_read(&aai_live.ring, tmp, max);
+        if (n) {
+            memcpy(buf, tmp, n * FRAME_SIZE);
+            aai_live.sent += n;
+            return n * FRAME_SIZE;
+        }
+        if (pcm_ring_done(&aai_live.ring)) return 0;   /* end of body */
+        usleep(10000);
+    }
+}
+
+static void *aai_live_thread(void *arg) {
+    (void)arg;
+    /* the warm-up has the shared connection cache until it is done */
+    while (warm.busy) usleep(10000);
+    CURL *curl = pool_get(HOST_AAI);
+    if (!curl) return NULL;
+    struct curl_slist *headers = NULL;
+    headers = curl_slist_append(headers, aai_key);
+    headers = curl_slist_append(headers, "Content-Type: application/octet-stream");
+    headers = curl_slist_append(headers, "Transfer-Encoding: chunked");
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, aai_live_read);
+    /* api_setup's 120 s cap would cut long dictations off; stall
+     * detection covers a dead connection instead, and after release
+     * the deadline ends it */
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 30L);
+    char url[512];
+    snprintf(url, sizeof(url), "%sv2/upload", host_base[HOST_AAI]);
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    struct response resp = {0};
+    api_setup(curl, headers, &resp);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 0L);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, deadline_xferinfo);
     CURLcode res = curl_easy_perform(curl);
-    if (res != CURLE_OK) {
-        char msg[256];
-        snprintf(msg, sizeof(msg), "Network error: %s", curl_easy_strerror(res));
-        notify(msg);
-        fprintf(stderr, "dictator: %s curl: %s\n", label, curl_easy_strerror(res));
+    if (res == CURLE_ABORTED_BY_CALLBACK)
+        aai_live.late = 1;
+    else if (api_check(curl, res, &resp, "aai-live-upload", 0) == 0)
+        aai_live.upload_url = json_get_string(resp.data, "upload_url");
+    free(resp.data);
+    pool_put(HOST_AAI, curl);
+    curl_slist_free_all(headers);
+    return NULL;
+}
+
+static void aai_live_init(void) {
+    if (!cfg.aai_live_upload || !have_aai || have_groq || cfg.realtime_url[0]) return;
+    if (pcm_ring_init(&aai_live.ring, AAI_LIVE_RING) < 0) return;
+    if (capture_attach(&aai_live.ring) < 0) pcm_ring_free(&aai_live.ring);
+}
+
+/* Join the thread of an earlier session that was never collected */
+static void aai_live_discard(void) {
+    if (aai_live.active) pthread_join(aai_live.tid, NULL);
+    aai_live.active = 0;
+    free(aai_live.upload_url);
+    aai_live.upload_url = NULL;
+}
+
+/* After capture_arm() and warm_start() */
+static void aai_live_start(enum action act) {
+    if (!aai_live.ring.buf || act == ACT_TRANSLATE) return;
+    aai_live_discard();
+    wav_header(aai_live.hdr, WAV_STREAMING);
+    aai_live.hdr_sent = 0;
+    aai_live.sent = 0;
+    aai_live.late = 0;
+    aai_live.active = pthread_create(&aai_live.tid, NULL, aai_live_thread, NULL) == 0;
+}
+
+/* After capture_disarm(): the ring is closed, the body ends once drained */
+static void aai_live_stop(void) {
+    if (aai_live.active) clock_gettime(CLOCK_MONOTONIC, &aai_live.released);
+}
+
+/* Wait for the live upload. Returns its upload_url if it carried the
+ * whole recording, NULL if the normal upload has to run. */
+static char *aai_live_finish(void) {
+    if (!aai_live.active) return NULL;
+    pthread_join(aai_live.tid, NULL);
+    aai_live.active = 0;
+    char *url = aai_live.upload_url;
+    aai_live.upload_url = NULL;
+    if (aai_live.late) deadline_exceeded("aai-live-upload");
+    if (url && aai_live.sent != pcm_pos) {
+        printf("dictator: live upload missed %zu samples, uploading again\n",
+               pcm_pos > aai_live.sent ? pcm_pos - aai_live.sent : 0);
+        free(url);
+        return NULL;
+    }
+    if (url)
+        printf("dictator: aai-live-upload: %.1fs streamed, done %.0f ms after release\n",
+               (double)aai_live.sent / SAMPLE_RATE, ms_since(&aai_live.released));
+    return url;
+}
+
+static void aai_live_shutdown(void) {
+    aai_live_discard();
+    if (!aai_live.ring.buf) return;
+    capture_detach(&aai_live.ring);
+    pcm_ring_free(&aai_live.ring);
+}
+
+/* ── WebSocket client ───────────────────────────────────────────────── */
+
+/*
+ * Just enough RFC 6455 for a streaming backend: libcurl makes the TCP
+ * (+ TLS, + proxy) connection with CURLOPT_CONNECT_ONLY and the upgrade
+ * handshake and framing run over curl_easy_send()/curl_easy_recv().
+ * Client frames are masked; fragmented messages are reassembled; pings
+ * are answered. One thread per connection.
+ */
+
+#define WS_IO_TIMEOUT_MS 5000
+#define WS_MAX_MESSAGE   (1u << 20)   /* larger frames or messages end the connection */
+#define WS_OP_CONT   0x0
+#define WS_OP_TEXT   0x1
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE  0x8
+#define WS_OP_PING   0x9
+#define WS_OP_PONG   0xA
+
+static uint32_t rol32(uint32_t x, int n) { return x << n | x >> (32 - n); }
+
+static void sha1(const uint8_t *data, size_t len, uint8_t out[20]) {
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    size_t nblocks = (len + 9 + 63) / 64;   /* data, 0x80, 64-bit length */
+    for (size_t blk = 0; blk < nblocks; blk++) {
+        uint8_t m[64];
+        for (size_t i = 0; i < 64; i++) {
+            size_t k = blk * 64 + i;
+            m[i] = k < len ? data[k] : k == len ? 0x80 : 0;
+        }
+        if (blk == nblocks - 1)
+            for (int i = 0; i < 8; i++) m[63 - i] = (uint8_t)((uint64_t)len * 8 >> (8 * i));
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++)
+            w[i] = (uint32_t)m[4 * i] << 24 | (uint32_t)m[4 * i + 1] << 16 |
+                   (uint32_t)m[4 * i + 2] << 8 | m[4 * i + 3];
+        for (int i = 16; i < 80; i++)
+            w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+            uint32_t t = rol32(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = rol32(b, 30); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+    for (int i = 0; i < 20; i++) out[i] = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+/* out needs 4 * ((n + 2) / 3) + 1 bytes */
+static void base64_encode(const uint8_t *in, size_t n, char *out) {
+    static const char tab[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t j = 0;
+    for (size_t i = 0; i < n; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < n) v |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < n) v |= in[i + 2];
+        out[j++] = tab[v >> 18 & 63];
+        out[j++] = tab[v >> 12 & 63];
+        out[j++] = i + 1 < n ? tab[v >> 6 & 63] : '=';
+        out[j++] = i + 2 < n ? tab[v & 63] : '=';
+    }
+    out[j] = '\0';
+}
+
+/* Sec-WebSocket-Accept for a Sec-WebSocket-Key */
+static void ws_accept_key(const char *key, char out[29]) {
+    char buf[128];
+    uint8_t digest[20];
+    snprintf(buf, sizeof(buf), "%s258EAFA5-E914-47DA-95CA-C5AB0DC85B11", key);
+    sha1((const uint8_t *)buf, strlen(buf), digest);
+    base64_encode(digest, sizeof(digest), out);
+}
+
+struct ws {
+    CURL          *curl;
+    curl_socket_t  fd;
+    uint8_t       *in;          /* received, not parsed yet */
+    size_t         in_len, in_cap;
+    uint8_t       *msg;         /* message being reassembled */
+    size_t         msg_len, msg_cap;
+    int            msg_op;
+    int            closed;      /* close frame seen or connection lost */
+    uint32_t       rng;         /* for mask keys */
+};
+
+static uint32_t ws_random(struct ws *w) {
+    w->rng ^= w->rng << 13;
+    w->rng ^= w->rng >> 17;
+    w->rng ^= w->rng << 5;
+    return w->rng;
+}
+
+/* Wait for the socket; 1 ready, 0 timeout, -1 error */
+static int ws_wait(struct ws *w, short events, int timeout_ms) {
+    struct pollfd pfd = { .fd = w->fd, .events = events };
+    int rc = poll(&pfd, 1, timeout_ms);
+    return rc < 0 && errno != EINTR ? -1 : rc > 0;
+}
+
+static int ws_write(struct ws *w, const void *buf, size_t len) {
+    const uint8_t *p = buf;
+    while (len) {
+        size_t n = 0;
+        CURLcode rc = curl_easy_send(w->curl, p, len, &n);
+        if (rc == CURLE_AGAIN) {
+            if (ws_wait(w, POLLOUT, WS_IO_TIMEOUT_MS) <= 0) return -1;
+            continue;
+        }
+        if (rc != CURLE_OK) return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Read what is available, waiting up to timeout_ms for something.
+ * Returns bytes read, -1 when the connection is gone, or 0 on timeout
+ * and also when the socket woke up for TLS bytes with no data yet. */
+static int ws_fill(struct ws *w, int timeout_ms) {
+    if (w->in_cap - w->in_len < 16384) {
+        size_t cap = w->in_cap ? w->in_cap * 2 : 32768;
+        void *tmp = realloc(w->in, cap);
+        if (!tmp) return -1;
+        w->in = tmp;
+        w->in_cap = cap;
+    }
+    for (int waited = 0;; waited = 1) {
+        size_t n = 0;
+        CURLcode rc = curl_easy_recv(w->curl, w->in + w->in_len, w->in_cap - w->in_len, &n);
+        if (rc == CURLE_OK) {
+            if (n == 0) return -1;   /* orderly shutdown */
+            w->in_len += n;
+            return (int)n;
+        }
+        if (rc != CURLE_AGAIN) return -1;
+        if (waited) return 0;
+        int r = ws_wait(w, POLLIN, timeout_ms);
+        if (r <= 0) return r;
+    }
+}
+
+/* Drop a connection without a closing handshake */
+static int ws_abort(struct ws *w) {
+    curl_easy_cleanup(w->curl);
+    free(w->in);
+    free(w->msg);
+    *w = (struct ws){ .fd = CURL_SOCKET_BAD };
+    return -1;
+}
+
+static int ws_send(struct ws *w, int op, const void *data, size_t len) {
+    uint8_t *frame = malloc(len + 14);
+    if (!frame) return -1;
+    size_t h = 0;
+    frame[h++] = (uint8_t)(0x80 | op);
+    if (len < 126) {
+        frame[h++] = (uint8_t)(0x80 | len);
+    } else if (len < 65536) {
+        frame[h++] = 0x80 | 126;
+        frame[h++] = (uint8_t)(len >> 8);
+        frame[h++] = (uint8_t)len;
+    } else {
+        frame[h++] = 0x80 | 127;
+        for (int i = 7; i >= 0; i--) frame[h++] = (uint8_t)((uint64_t)len >> (8 * i));
+    }
+    uint32_t key = ws_random(w);
+    uint8_t mask[4] = { (uint8_t)(key >> 24), (uint8_t)(key >> 16),
+                        (uint8_t)(key >> 8), (uint8_t)key };
+    memcpy(frame + h, mask, 4);
+    h += 4;
+    const uint8_t *src = data;
+    for (size_t i = 0; i < len; i++) frame[h + i] = src[i] ^ mask[i & 3];
+    int rc = ws_write(w, frame, h + len);
+    free(frame);
+    return rc;
+}
+
+/* Next text or binary message, within timeout_ms. Returns 1 with
+ * *data (NUL-terminated, valid until the next call), 0 on timeout,
+ * -1 once the peer closed or the connection failed. */
+static int ws_recv(struct ws *w, int timeout_ms, int *op, const char **data, size_t *len) {
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    while (!w->closed) {
+        /* one complete frame in the buffer? */
+        size_t need = 2, plen = 0;
+        int fop = 0, fin = 0, masked = 0, whole = 0;
+        if (w->in_len >= 2) {
+            fin = w->in[0] & 0x80;
+            fop = w->in[0] & 0x0F;
+            masked = w->in[1] & 0x80;
+            plen = w->in[1] & 0x7F;
+            if (plen == 126) need += 2;
+            else if (plen == 127) need += 8;
+            if (masked) need += 4;
+            if (w->in_len >= need) {
+                if (plen == 126) {
+                    plen = (size_t)w->in[2] << 8 | w->in[3];
+                } else if (plen == 127) {
+                    plen = 0;
+                    for (int i = 0; i < 8; i++) plen = plen << 8 | w->in[2 + i];
+                }
+                if (plen > WS_MAX_MESSAGE ||
+                    (fop == WS_OP_CONT && w->msg_len + plen > WS_MAX_MESSAGE)) {
+                    static const uint8_t too_big[2] = { 0x03, 0xF1 };   /* 1009 */
+                    fprintf(stderr, "dictator: websocket message over %u bytes, closing\n",
+                            WS_MAX_MESSAGE);
+                    ws_send(w, WS_OP_CLOSE, too_big, sizeof(too_big));
+                    ws_abort(w);
+                    w->closed = 1;
+                    return -1;
+                }
+                need += plen;
+                whole = w->in_len >= need;
+            }
+        }
+        if (!whole) {
+            double left = timeout_ms - ms_since(&t0);
+            int r = ws_fill(w, left > 0 ? (int)left : 0);
+            if (r < 0) { w->closed = 1; break; }
+            if (r == 0 && timeout_ms - ms_since(&t0) <= 0) return 0;
+            continue;
+        }
+        uint8_t *payload = w->in + need - plen;
+        if (masked) {
+            const uint8_t *mk = payload - 4;
+            for (size_t i = 0; i < plen; i++) payload[i] ^= mk[i & 3];
+        }
+        int done = 0;
+        if (fop == WS_OP_PING) {
+            ws_send(w, WS_OP_PONG, payload, plen);
+        } else if (fop == WS_OP_CLOSE) {
+            ws_send(w, WS_OP_CLOSE, payload, plen < 2 ? plen : 2);
+            w->closed = 1;
+        } else if (fop == WS_OP_TEXT || fop == WS_OP_BINARY || fop == WS_OP_CONT) {
+            if (fop != WS_OP_CONT) {
+                w->msg_op = fop;
+                w->msg_len = 0;
+            }
+            if (w->msg_len + plen + 1 > w->msg_cap) {
+                size_t cap = (w->msg_len + plen + 1) * 2;
+                void *tmp = realloc(w->msg, cap);
+                if (!tmp) { w->closed = 1; break; }
+                w->msg = tmp;
+                w->msg_cap = cap;
+            }
+            memcpy(w->msg + w->msg_len, payload, plen);
+            w->msg_len += plen;
+            w->msg[w->msg_len] = '\0';
+            done = fin != 0;
+        }
+        memmove(w->in, w->in + need, w->in_len - need);
+        w->in_len -= need;
+        if (done) {
+            *op = w->msg_op;
+            *data = (const char *)w->msg;
+            *len = w->msg_len;
+            return 1;
+        }
+    }
+    return -1;
+}
+
+/* Connect and upgrade. url is ws:// or wss://; extra_header (may be
+ * NULL) is sent with the handshake. Returns 0 or -1. */
+static int ws_connect(struct ws *w, const char *url, const char *extra_header) {
+    *w = (struct ws){ .fd = CURL_SOCKET_BAD };
+    const char *scheme = strncmp(url, "wss://", 6) == 0 ? "https://"
+                       : strncmp(url, "ws://", 5) == 0  ? "http://" : NULL;
+    if (!scheme) {
+        fprintf(stderr, "dictator: %s: not a ws:// or wss:// URL\n", url);
+        return -1;
+    }
+    const char *host = strstr(url, "://") + 3;
+    size_t hlen = strcspn(host, "/?");
+    const char *path = host + hlen;
+    char origin[512];
+    snprintf(origin, sizeof(origin), "%s%.*s/", scheme, (int)hlen, host);
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    w->rng = (uint32_t)t.tv_nsec ^ (uint32_t)getpid() << 16 ^ 0x9E3779B9u;
+    w->curl = curl_easy_init();
+    if (!w->curl) return -1;
+    curl_easy_setopt(w->curl, CURLOPT_URL, origin);
+    curl_easy_setopt(w->curl, CURLOPT_CONNECT_ONLY, 1L);
+    /* The Upgrade request below is HTTP/1.1: keep h2 out of ALPN */
+    curl_easy_setopt(w->curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_1_1);
+    curl_easy_setopt(w->curl, CURLOPT_CONNECTTIMEOUT_MS, (long)WS_IO_TIMEOUT_MS);
+    if (cfg.proxy[0]) curl_easy_setopt(w->curl, CURLOPT_PROXY, cfg.proxy);
+    CURLcode rc = curl_easy_perform(w->curl);
+    if (rc != CURLE_OK ||
+        curl_easy_getinfo(w->curl, CURLINFO_ACTIVESOCKET, &w->fd) != CURLE_OK ||
+        w->fd == CURL_SOCKET_BAD) {
+        fprintf(stderr, "dictator: websocket connect: %s\n", curl_easy_strerror(rc));
+        curl_easy_cleanup(w->curl);
+        w->curl = NULL;
         return -1;
     }
 
-    long http_code = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-    if (http_code < 200 || http_code >= 300) {
-        char msg[256];
-        snprintf(msg, sizeof(msg), "API error %ld (%s)", http_code, label);
-        notify(msg);
-        fprintf(stderr, "dictator: %s: %s\n", msg, resp->data ? resp->data : "");
+    uint8_t nonce[16];
+    for (int i = 0; i < 16; i += 4) {
+        uint32_t r = ws_random(w);
+        memcpy(nonce + i, &r, 4);
+    }
+    char key[25], expect[29];
+    base64_encode(nonce, sizeof(nonce), key);
+    ws_accept_key(key, expect);
+    char req[2048];
+    int n = snprintf(req, sizeof(req),
+                     "GET %s%s HTTP/1.1\r\nHost: %.*s\r\nUpgrade: websocket\r\n"
+                     "Connection: Upgrade\r\nSec-WebSocket-Key: %s\r\n"
+                     "Sec-WebSocket-Version: 13\r\n%s%s\r\n",
+                     *path == '/' ? "" : "/", path, (int)hlen, host, key,
+                     extra_header ? extra_header : "", extra_header ? "\r\n" : "");
+    if (n >= (int)sizeof(req) || ws_write(w, req, (size_t)n) < 0) return ws_abort(w);
+
+    /* response head; anything after it is already frames */
+    char *end = NULL;
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (size_t scanned = 0;; ) {
+        for (; !end && scanned + 4 <= w->in_len; scanned++)
+            if (memcmp(w->in + scanned, "\r\n\r\n", 4) == 0) end = (char *)w->in + scanned;
+        if (end) break;
+        double left = WS_IO_TIMEOUT_MS - ms_since(&t0);
+        /* 0 can be a TLS record with no data in it yet: keep waiting */
+        if (left <= 0 || ws_fill(w, (int)left) < 0) return ws_abort(w);
+    }
+    end[2] = '\0';   /* keep the last header's CRLF */
+    char *head = (char *)w->in;
+    const char *acc = NULL;
+    for (char *line = strstr(head, "\r\n"); line && line[2]; line = strstr(line + 2, "\r\n"))
+        if (strncasecmp(line + 2, "Sec-WebSocket-Accept:", 21) == 0) acc = line + 23;
+    if (strncmp(head, "HTTP/1.1 101", 12) != 0 || !acc) {
+        fprintf(stderr, "dictator: websocket upgrade refused: %.*s\n",
+                (int)strcspn(head, "\r"), head);
+        return ws_abort(w);
+    }
+    while (*acc == ' ') acc++;
+    if (strncmp(acc, expect, 28) != 0) {
+        fprintf(stderr, "dictator: websocket upgrade: bad Sec-WebSocket-Accept\n");
+        return ws_abort(w);
+    }
+    size_t used = (size_t)(end + 4 - head);
+    memmove(w->in, w->in + used, w->in_len - used);
+    w->in_len -= used;
+    return 0;
+}
+
+static void ws_close(struct ws *w) {
+    if (!w->curl) return;
+    if (!w->closed) {
+        static const uint8_t normal[2] = { 0x03, 0xE8 };   /* 1000 */
+        ws_send(w, WS_OP_CLOSE, normal, sizeof(normal));
+    }
+    curl_easy_cleanup(w->curl);
+    free(w->in);
+    free(w->msg);
+    *w = (struct ws){ .fd = CURL_SOCKET_BAD };
+}
+
+/* ── Real-time streaming backend ────────────────────────────────────── */
+
+/*
+ * With realtime_url set, transcription streams over a WebSocket while
+ * the key is held, using the AssemblyAI v3 streaming protocol: binary
+ * PCM messages up, JSON "Turn" messages (partial, then final, per
+ * turn_order) down, {"type":"Terminate"} on release answered by a
+ * "Termination". The text is ready a few hundred ms after release,
+ * whatever the length. Another capture-ring consumer feeds it. If the
+ * socket fails or the ring overflowed, the batch path runs as usual.
+ */
+
+#define RT_RING          (PREROLL_RING + 15 * SAMPLE_RATE)
+#define RT_MSG_SAMPLES   (SAMPLE_RATE / 10)   /* 100 ms per message */
+#define RT_FINAL_MS      5000                 /* wait for Termination */
+
+static struct {
+    struct pcm_ring ring;
+    pthread_t       tid;
+    int             active;
+    size_t          sent;        /* samples sent */
+    int             finished;    /* server acknowledged the end of the audio */
+    int             late;        /* the deadline came before the Termination */
+    int             partials;
+    char          **turns;       /* latest transcript per turn_order */
+    size_t          nturns;
+    struct timespec released;
+} rt;
+
+static void rt_turn(size_t order, const char *text) {
+    if (order >= 4096) return;
+    if (order >= rt.nturns) {
+        void *tmp = realloc(rt.turns, (order + 1) * sizeof(*rt.turns));
+        if (!tmp) return;
+        rt.turns = tmp;
+        memset(rt.turns + rt.nturns, 0, (order + 1 - rt.nturns) * sizeof(*rt.turns));
+        rt.nturns = order + 1;
+    }
+    char *dup = strdup(text);
+    if (!dup) return;
+    free(rt.turns[order]);
+    rt.turns[order] = dup;
+}
+
+static void rt_message(const char *json) {
+    char *type = json_get_string(json, "type");
+    if (!type) {
+        char *err = json_get_string(json, "error");
+        if (err) fprintf(stderr, "dictator: realtime: %s\n", err);
+        free(err);
+        return;
+    }
+    if (strcmp(type, "Turn") == 0) {
+        char *text = json_get_string(json, "transcript");
+        double order = 0;
+        json_get_number(json, "turn_order", &order);
+        if (text) rt_turn((size_t)order, text);
+        rt.partials++;
+        free(text);
+    } else if (strcmp(type, "Termination") == 0) {
+        rt.finished = 1;
+    }
+    free(type);
+}
+
+/* Hand every complete message waiting on w to rt_message(); -1 once the
+ * connection is gone */
+static int rt_drain(struct ws *w, int timeout_ms) {
+    int op;
+    const char *data;
+    size_t len;
+    int r;
+    while ((r = ws_recv(w, timeout_ms, &op, &data, &len)) > 0) {
+        if (op == WS_OP_TEXT) rt_message(data);
+        timeout_ms = 0;
+    }
+    return r;
+}
+
+static void *rt_thread(void *arg) {
+    (void)arg;
+    struct ws w;
+    if (ws_connect(&w, cfg.realtime_url, have_aai ? aai_key : NULL) < 0) return NULL;
+    int16_t *msg = malloc(RT_MSG_SAMPLES * sizeof(int16_t));
+    size_t fill = 0;
+    int ok = msg != NULL;
+    while (ok) {
+        size_t n = pcm_ring_read(&rt.ring, msg + fill, RT_MSG_SAMPLES - fill);
+        fill += n;
+        int last = n == 0 && pcm_ring_done(&rt.ring);
+        if (fill == RT_MSG_SAMPLES || (last && fill)) {
+            if (ws_send(&w, WS_OP_BINARY, msg, fill * sizeof(int16_t)) < 0) ok = 0;
+            else rt.sent += fill;
+            fill = 0;
+        }
+        if (last || rt_drain(&w, n ? 0 : 20) < 0) break;
+    }
+    if (ok && !w.closed) {
+        static const char terminate[] = "{\"type\": \"Terminate\"}";
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        int sent = ws_send(&w, WS_OP_TEXT, terminate, sizeof(terminate) - 1) == 0;
+        while (sent && !rt.finished) {
+            double left = RT_FINAL_MS - ms_since(&t0);
+            if (left <= 0) break;
+            deadline_adopt();
+            if (deadline_passed()) {
+                rt.late = 1;
+                break;
+            }
+            if (left > deadline_left()) left = deadline_left();
+            if (left > 100) left = 100;   /* the deadline may be set meanwhile */
+            if (rt_drain(&w, (int)left + 1) < 0) break;
+        }
+    }
+    ws_close(&w);
+    free(msg);
+    return NULL;
+}
+
+static void rt_init(void) {
+    if (!cfg.realtime_url[0]) return;
+    if (pcm_ring_init(&rt.ring, RT_RING) < 0) return;
+    if (capture_attach(&rt.ring) < 0) pcm_ring_free(&rt.ring);
+}
+
+static void rt_reset(void) {
+    if (rt.active) pthread_join(rt.tid, NULL);
+    rt.active = 0;
+    for (size_t i = 0; i < rt.nturns; i++) free(rt.turns[i]);
+    free(rt.turns);
+    rt.turns = NULL;
+    rt.nturns = 0;
+}
+
+/* After capture_arm() */
+static void rt_start(enum action act) {
+    if (!rt.ring.buf || act == ACT_TRANSLATE) return;
+    rt_reset();
+    rt.sent = 0;
+    rt.finished = 0;
+    rt.late = 0;
+    rt.partials = 0;
+    rt.active = pthread_create(&rt.tid, NULL, rt_thread, NULL) == 0;
+}
+
+/* After capture_disarm(): the thread sends the rest and terminates */
+static void rt_stop(void) {
+    if (rt.active) clock_gettime(CLOCK_MONOTONIC, &rt.released);
+}
+
+/* Wait for the final transcript. Returns it (malloc'd, possibly empty)
+ * if the server heard the whole recording, NULL to use the batch path. */
+static char *rt_finish(void) {
+    if (!rt.active) return NULL;
+    pthread_join(rt.tid, NULL);
+    rt.active = 0;
+    if (rt.late) {
+        deadline_exceeded("realtime");
+        rt_reset();
+        return NULL;
+    }
+    if (!rt.finished || rt.sent != pcm_pos) {
+        fprintf(stderr, "dictator: realtime session incomplete (%zu of %zu samples), "
+                "using batch upload\n", rt.sent, pcm_pos);
+        rt_reset();
+        return NULL;
+    }
+    struct strbuf sb = {0};
+    for (size_t i = 0; i < rt.nturns; i++)
+        if (rt.turns[i] && *rt.turns[i] && strbuf_append_words(&sb, rt.turns[i]) < 0)
+            notify("Out of memory assembling transcript");
+    printf("dictator: realtime: %zu turns from %d messages, final %.0f ms after release\n",
+           rt.nturns, rt.partials, ms_since(&rt.released));
+    rt_reset();
+    return sb.data ? sb.data : strdup("");
+}
+
+static void rt_shutdown(void) {
+    rt_reset();
+    if (!rt.ring.buf) return;
+    capture_detach(&rt.ring);
+    pcm_ring_free(&rt.ring);
+}
+
+/* ── Overlapping chunks ─────────────────────────────────────────────── */
+
+/*
+ * A chunk after the first starts CHUNK_OVERLAP_MS before the previous
+ * one's cut, so a word the cut went through is heard whole by one of
+ * them. Such chunks are sent `timed`: the backend returns its words
+ * with timestamps (Groq's verbose_json, AssemblyAI's words array), and
+ * the words both chunks heard in the overlap are aligned. The longest
+ * run that matches, case and punctuation aside, at about the same time
+ * is where the texts are joined, halfway through the run. Without a
+ * match the overlap is split at its middle by timestamp. The words only
+ * place the seam: each side is cut from the chunk's own transcript text,
+ * which keeps the punctuation Whisper leaves out of its words.
+ */
+
+#define CHUNK_OVERLAP_MS  2000
+#define MERGE_SLACK_S     0.5   /* words this far outside the overlap may match */
+#define MERGE_TOLERANCE_S 1.0   /* matched words start about this close */
+
+struct word {
+    char  *text;
+    double start, end;   /* seconds into the chunk as uploaded */
+    size_t at;           /* where it starts in the list's text */
+};
+
+struct word_list {
+    struct word *v;
+    size_t n, cap;
+    char  *text;         /* the transcript, NULL if the words aren't found in it */
+};
+
+static void word_list_free(struct word_list *w) {
+    for (size_t i = 0; i < w->n; i++) free(w->v[i].text);
+    free(w->v);
+    free(w->text);
+    *w = (struct word_list){0};
+}
+
+static int word_list_add(struct word_list *w, struct word wd) {
+    if (w->n == w->cap) {
+        size_t cap = w->cap ? w->cap * 2 : 64;
+        void *tmp = realloc(w->v, cap * sizeof(*w->v));
+        if (!tmp) return -1;
+        w->v = tmp;
+        w->cap = cap;
+    }
+    w->v[w->n++] = wd;
+    return 0;
+}
+
+/* Find each word in the transcript's "text", in order, punctuation
+ * around it aside. An opening bracket or quote goes with its word. */
+static void word_list_locate(const char *json, struct word_list *w) {
+    char *text = json_get_string(json, "text");
+    size_t pos = 0;
+    for (size_t i = 0; i < w->n && text; i++) {
+        const char *s = w->v[i].text;
+        size_t len = strlen(s);
+        while (len && ispunct((unsigned char)*s)) { s++; len--; }
+        while (len && ispunct((unsigned char)s[len - 1])) len--;
+        size_t at = pos;
+        if (len) {
+            while (text[at] && strncmp(text + at, s, len) != 0) at++;
+            if (!text[at]) {
+                free(text);
+                text = NULL;
+                break;
+            }
+        }
+        size_t end = at + len;
+        while (at > pos && strchr("([{\"'", text[at - 1])) at--;
+        w->v[i].at = at;
+        pos = end;
+    }
+    w->text = text;
+}
+
+/* The words of a timed transcript: Groq's {"word", "start", "end"} in
+ * seconds or AssemblyAI's {"text", "start", "end"} in ms. Returns -1 if
+ * there is no words array or no memory. */
+static int word_list_parse(const char *json, struct word_list *w) {
+    *w = (struct word_list){0};
+    const char *p = json_value(json, "words");
+    if (!p || *p != '[') return -1;
+    for (p++;; ) {
+        while (*p == ' ' || *p == ',' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+        if (*p != '{') break;
+        size_t len = json_span(p);
+        char *obj = len ? malloc(len + 1) : NULL;
+        if (!obj) break;
+        memcpy(obj, p, len);
+        obj[len] = '\0';
+        p += len;
+        struct word wd = {0};
+        double unit = 1.0;
+        wd.text = json_get_string(obj, "word");
+        if (!wd.text) {
+            wd.text = json_get_string(obj, "text");
+            unit = 0.001;
+        }
+        int ok = wd.text && json_get_number(obj, "start", &wd.start) == 0 &&
+                 json_get_number(obj, "end", &wd.end) == 0;
+        free(obj);
+        trim_text(wd.text);
+        wd.start *= unit;
+        wd.end *= unit;
+        if (!ok || !*wd.text || word_list_add(w, wd) < 0)
+            free(wd.text);
+    }
+    if (*p != ']') {
+        word_list_free(w);
         return -1;
     }
+    word_list_locate(json, w);
     return 0;
 }
 
-/* ── Groq Whisper API ──────────────────────────────────────────────── */
-
-static char *groq_audio(uint8_t *wav, size_t wav_len, const char *endpoint) {
-    CURL *curl = curl_easy_init();
-    if (!curl) return NULL;
+/* Same word, case and punctuation aside */
+static int word_same(const char *a, const char *b) {
+    for (;; a++, b++) {
+        while (ispunct((unsigned char)*a)) a++;
+        while (ispunct((unsigned char)*b)) b++;
+        if (!*a || !*b) return !*a && !*b;
+        if (tolower((unsigned char)*a) != tolower((unsigned char)*b)) return 0;
+    }
+}
 
-    struct curl_slist *headers = NULL;
-    headers = curl_slist_append(headers, groq_key);
+/* Where chunk `prev`, prev_s long, and `next`, which repeats its last
+ * overlap_s, join: prev's first *keep words, then next's from *skip */
+static void chunk_join_point(const struct word_list *prev, double prev_s,
+                             const struct word_list *next, double overlap_s,
+                             size_t *keep, size_t *skip) {
+    double shift = prev_s - overlap_s;   /* next's 0 in prev's time */
+    size_t best_i = 0, best_j = 0, best_k = 0;
+    double best_d = HUGE_VAL;
+    for (size_t i = 0; i < prev->n; i++) {
+        if (prev->v[i].end < shift - MERGE_SLACK_S) continue;
+        for (size_t j = 0; j < next->n && next->v[j].start < overlap_s + MERGE_SLACK_S; j++) {
+            double d = fabs(prev->v[i].start - shift - next->v[j].start);
+            if (d > MERGE_TOLERANCE_S) continue;
+            size_t k = 0;
+            while (i + k < prev->n && j + k < next->n &&
+                   word_same(prev->v[i + k].text, next->v[j + k].text))
+                k++;
+            if (k > best_k || (k && k == best_k && d < best_d)) {
+                best_i = i;
+                best_j = j;
+                best_k = k;
+                best_d = d;
+            }
+        }
+    }
+    if (best_k) {
+        *keep = best_i + best_k / 2;
+        *skip = best_j + best_k / 2;
+        return;
+    }
+    double mid = overlap_s / 2;
+    *keep = prev->n;
+    while (*keep > 0 && (prev->v[*keep - 1].start + prev->v[*keep - 1].end) / 2 - shift >= mid)
+        (*keep)--;
+    *skip = 0;
+    while (*skip < next->n && (next->v[*skip].start + next->v[*skip].end) / 2 < mid)
+        (*skip)++;
+}
 
-    curl_mime *mime = curl_mime_init(curl);
+/* Chunk texts joined in order. The words of a timed chunk wait for the
+ * next chunk, which decides where its own words take over. */
+struct chunk_merge {
+    struct word_list prev;
+    size_t           from;      /* prev's words before this were the chunk before's */
+    double           prev_s;
+    int              open;      /* prev's words are still to be appended */
+};
 
-    curl_mimepart *part = curl_mime_addpart(mime);
-    curl_mime_name(part, "file");
-    curl_mime_data(part, (char *)wav, wav_len);
-    curl_mime_filename(part, "audio.wav");
-    curl_mime_type(part, "audio/wav");
+static int chunk_merge_flush(struct chunk_merge *m, struct strbuf *sb, size_t keep) {
+    int rc = 0;
+    const char *t = m->prev.text;
+    if (t && keep > m->from) {
+        /* prev's text from its word `from` up to its word `keep` */
+        size_t b = m->from ? m->prev.v[m->from].at : 0;
+        size_t e = keep < m->prev.n ? m->prev.v[keep].at : strlen(t);
+        while (b < e && isspace((unsigned char)t[b])) b++;
+        while (e > b && isspace((unsigned char)t[e - 1])) e--;
+        if (e > b && sb->len > 0) rc = strbuf_append(sb, " ", 1);
+        if (e > b && rc == 0) rc = strbuf_append(sb, t + b, e - b);
+    }
+    for (size_t i = m->from; !t && i < keep && rc == 0; i++)
+        rc = strbuf_append_words(sb, m->prev.v[i].text);
+    word_list_free(&m->prev);
+    m->from = 0;
+    m->open = 0;
+    return rc;
+}
 
-    part = curl_mime_addpart(mime);
-    curl_mime_name(part, "model");
-    curl_mime_data(part, cfg.groq_model, CURL_ZERO_TERMINATED);
+/* Append the next chunk's text (NULL if it failed): `seconds` of audio
+ * as uploaded, the first overlap_s of it repeated from the chunk before.
+ * Returns -1 on OOM. */
+static int chunk_merge_add(struct chunk_merge *m, struct strbuf *sb, const char *text,
+                           int timed, double seconds, double overlap_s) {
+    struct word_list cur = {0};
+    int words = text && timed && word_list_parse(text, &cur) == 0;
+    size_t keep = m->prev.n, skip = 0;
+    if (m->open && words && overlap_s > 0)
+        chunk_join_point(&m->prev, m->prev_s, &cur, overlap_s, &keep, &skip);
+    if (keep < m->from) keep = m->from;
+    int rc = chunk_merge_flush(m, sb, keep);
+    if (words) {
+        m->prev = cur;
+        m->from = skip;
+        m->prev_s = seconds;
+        m->open = 1;
+        return rc;
+    }
+    if (!text) return rc;
+    /* no words came back: the plain text, joined as is */
+    char *plain = timed ? json_get_string(text, "text") : NULL;
+    trim_text(plain);
+    const char *t = plain ? plain : text;
+    if (rc == 0 && *t) rc = strbuf_append_words(sb, t);
+    free(plain);
+    return rc;
+}
 
-    part = curl_mime_addpart(mime);
-    curl_mime_name(part, "response_format");
-    curl_mime_data(part, "text", CURL_ZERO_TERMINATED);
+static int chunk_merge_end(struct chunk_merge *m, struct strbuf *sb) {
+    return chunk_merge_flush(m, sb, m->prev.n);
+}
 
-    struct response resp = {0};
+/* ── Parallel chunk upload ──────────────────────────────────────────── */
 
-    curl_easy_setopt(curl, CURLOPT_URL, endpoint);
-    curl_easy_setopt(curl, CURLOPT_MIMEPOST, mime);
+/*
+ * Chunks of a long dictation go to Groq concurrently through one
+ * curl_multi, at most upload_concurrency at a time, multiplexed over a
+ * single HTTP/2 connection where the server allows it. A chunk that
+ * fails with a network error, 429 or 5xx is queued again after
+ * api_retry_ms() while the others keep going; once its retries are used up it
+ * falls back to the sequential path (AssemblyAI for transcription).
+ * Texts are kept per chunk and joined in order.
+ *
+ * A chunk Groq is slow to answer is hedged: after hedge_after_ms, or
+ * the p95 of recent Groq latencies scaled to the chunk's length, the
+ * same chunk also goes to AssemblyAI on a thread of its own. Whichever
+ * answers first is used and the other is cancelled.
+ */
 
-    if (api_request(curl, headers, &resp, "groq") < 0) {
-        curl_mime_free(mime);
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
-        free(resp.data);
-        return NULL;
-    }
+#define HEDGE_PRIOR_MS    4000     /* hedge delay until Groq has been timed */
+#define HEDGE_MIN_MS      500
+#define HEDGE_SAMPLES     32       /* recent Groq latencies kept */
+#define HEDGE_MIN_SAMPLES 5
+
+enum job_state { JOB_QUEUED, JOB_RUNNING, JOB_DONE, JOB_FAILED };
+
+/* AssemblyAI racing a slow Groq transfer for the same chunk */
+struct hedge {
+    pthread_t  tid;
+    int        active;        /* thread started and not joined yet */
+    int        tried;         /* AssemblyAI already had this chunk */
+    atomic_int done;
+    atomic_int cancel;
+    CURLM     *multi;         /* woken when the thread is done */
+    double     deadline;      /* the firing thread's net_deadline */
+    char      *text;
+};
 
-    curl_mime_free(mime);
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
-
-    /* Trim leading and trailing whitespace */
-    if (resp.data) {
-        size_t len = strlen(resp.data);
-        while (len > 0 && (resp.data[len-1] == '\n' || resp.data[len-1] == '\r'
-                           || resp.data[len-1] == ' '))
-            resp.data[--len] = '\0';
-        char *start = resp.data;
-        while (*start == ' ' || *start == '\n' || *start == '\r')
-            start++;
-        if (start != resp.data)
-            memmove(resp.data, start, strlen(start) + 1);
-    }
-    return resp.data;
+/* Groq latency per second of audio, and hedges since start */
+static struct {
+    double ms_per_s[HEDGE_SAMPLES];
+    int    n, next;
+    int    fired, won;
+} hedges;
+
+static void groq_latency_observed(double audio_s, double ms) {
+    hedges.ms_per_s[hedges.next] = ms / (audio_s + 1.0);
+    hedges.next = (hedges.next + 1) % HEDGE_SAMPLES;
+    if (hedges.n < HEDGE_SAMPLES) hedges.n++;
 }
 
-static char *transcribe_groq(uint8_t *wav, size_t wav_len) {
-    return groq_audio(wav, wav_len,
-                      "https://api.groq.com/openai/v1/audio/transcriptions");
+/* How long Groq gets on a chunk of audio_s before it is hedged */
+static double hedge_after_ms(double audio_s) {
+    if (cfg.hedge_after_ms > 0) return cfg.hedge_after_ms;
+    if (hedges.n < HEDGE_MIN_SAMPLES) return HEDGE_PRIOR_MS;
+    double v[HEDGE_SAMPLES];
+    int n = hedges.n;
+    memcpy(v, hedges.ms_per_s, (size_t)n * sizeof(v[0]));
+    for (int i = 1; i < n; i++)
+        for (int k = i; k > 0 && v[k - 1] > v[k]; k--) {
+            double t = v[k]; v[k] = v[k - 1]; v[k - 1] = t;
+        }
+    double ms = v[(n * 95 + 99) / 100 - 1] * (audio_s + 1.0);
+    return ms < HEDGE_MIN_MS ? HEDGE_MIN_MS : ms;
 }
 
-static char *translate_groq(uint8_t *wav, size_t wav_len) {
-    return groq_audio(wav, wav_len,
-                      "https://api.groq.com/openai/v1/audio/translations");
-}
+struct upload_job {
+    size_t             idx;        /* chunk number */
+    struct audio       a;
+    char              *text;
+    enum job_state     state;
+    int                tries;
+    struct timespec    not_before;
+    struct timespec    launched;   /* first attempt */
+    int                timed;      /* text is the backend's JSON, for the merge */
+    double             seconds, overlap_s;
+    struct hedge       hedge;
+    CURL              *curl;
+    curl_mime         *mime;
+    struct curl_slist *headers;
+    struct response    resp;
+};
 
-/* ── AssemblyAI transcription API ──────────────────────────────────── */
+struct uploader {
+    CURLM              *multi;
+    enum action         act;
+    struct upload_job **jobs;      /* in chunk order */
+    size_t              njobs, cap;
+    int                 inflight;
+    int                 hedged, hedge_won;
+    struct timespec     t0;
+};
 
-static char *transcribe_aai(uint8_t *wav, size_t wav_len) {
-    struct curl_slist *headers = NULL;
-    headers = curl_slist_append(headers, aai_key);
+static void uploader_init(struct uploader *u, enum action act) {
+    *u = (struct uploader){ .act = act };
+    clock_gettime(CLOCK_MONOTONIC, &u->t0);
+    if (!have_groq) return;
+    u->multi = curl_multi_init();
+    if (!u->multi) return;
+    curl_multi_setopt(u->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(u->multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)cfg.upload_concurrency);
+}
 
-    /* ── Step 1: Upload audio ─────────────────────────────────────── */
-    CURL *curl = curl_easy_init();
-    if (!curl) { curl_slist_free_all(headers); return NULL; }
+/* Queue one chunk; the uploader takes over *a. Returns -1 on OOM. */
+static int uploader_add(struct uploader *u, struct audio *a) {
+    if (u->njobs == u->cap) {
+        size_t cap = u->cap ? u->cap * 2 : 16;
+        void *tmp = realloc(u->jobs, cap * sizeof(*u->jobs));
+        if (!tmp) return -1;
+        u->jobs = tmp;
+        u->cap = cap;
+    }
+    struct upload_job *j = calloc(1, sizeof(*j));
+    if (!j) return -1;
+    j->idx = u->njobs;
+    j->timed = a->timed;
+    j->seconds = (double)a->n / SAMPLE_RATE;
+    j->overlap_s = a->overlap_s;
+    j->a = *a;
+    *a = (struct audio){0};
+    /* without a multi handle everything takes the sequential path */
+    j->state = u->multi ? JOB_QUEUED : JOB_FAILED;
+    u->jobs[u->njobs++] = j;
+    return 0;
+}
 
-    headers = curl_slist_append(headers, "Content-Type: application/octet-stream");
-    curl_easy_setopt(curl, CURLOPT_URL, "https://api.assemblyai.com/v2/upload");
-    curl_easy_setopt(curl, CURLOPT_POST, 1L);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, (char *)wav);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)wav_len);
+static void uploader_detach(struct uploader *u, struct upload_job *j) {
+    curl_multi_remove_handle(u->multi, j->curl);
+    curl_mime_free(j->mime);
+    curl_slist_free_all(j->headers);
+    pool_put(HOST_GROQ, j->curl);
+    j->curl = NULL;
+    j->mime = NULL;
+    j->headers = NULL;
+    u->inflight--;
+}
 
-    struct response resp = {0};
-    if (api_request(curl, headers, &resp, "aai-upload") < 0) {
-        free(resp.data);
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(headers);
-        return NULL;
+static void uploader_launch(struct uploader *u, struct upload_job *j) {
+    if (!j->tries++) clock_gettime(CLOCK_MONOTONIC, &j->launched);
+    j->resp = (struct response){0};
+    j->curl = pool_get(HOST_GROQ);
+    if (!j->curl) { j->state = JOB_FAILED; return; }
+    u->inflight++;
+    if (groq_setup(j->curl, &j->a, u->act == ACT_TRANSLATE, &j->mime, &j->headers) < 0) {
+        uploader_detach(u, j);
+        j->state = JOB_FAILED;
+        return;
     }
+    api_setup(j->curl, j->headers, &j->resp);
+    curl_easy_setopt(j->curl, CURLOPT_PRIVATE, j);
+    if (curl_multi_add_handle(u->multi, j->curl) != CURLM_OK) {
+        uploader_detach(u, j);
+        j->state = JOB_FAILED;
+        return;
+    }
+    j->state = JOB_RUNNING;
+}
 
-    char *upload_url = json_get_string(resp.data, "upload_url");
-    free(resp.data);
-    curl_easy_cleanup(curl);
+static void *hedge_thread(void *arg) {
+    struct upload_job *j = arg;
+    net_cancel = &j->hedge.cancel;
+    net_deadline = j->hedge.deadline;
+    j->hedge.text = transcribe_aai(&j->a);
+    if (solo_curl) curl_easy_cleanup(solo_curl);
+    solo_curl = NULL;
+    atomic_store(&j->hedge.done, 1);
+    curl_multi_wakeup(j->hedge.multi);
+    return NULL;
+}
 
-    if (!upload_url) {
-        notify("Upload failed: no URL returned");
-        curl_slist_free_all(headers);
-        return NULL;
+static void hedge_fire(struct uploader *u, struct upload_job *j) {
+    j->hedge.tried = 1;
+    j->hedge.multi = u->multi;
+    j->hedge.deadline = net_deadline;
+    if (pthread_create(&j->hedge.tid, NULL, hedge_thread, j) != 0) return;
+    j->hedge.active = 1;
+    u->hedged++;
+    hedges.fired++;
+    printf("dictator: groq #%zu slow after %.0f ms, hedging with AssemblyAI\n",
+           j->idx + 1, ms_since(&j->launched));
+}
+
+/* Join a finished (or cancelled) hedge; its text wins if the chunk is
+ * still open */
+static void hedge_reap(struct uploader *u, struct upload_job *j) {
+    pthread_join(j->hedge.tid, NULL);
+    j->hedge.active = 0;
+    char *text = j->hedge.text;
+    j->hedge.text = NULL;
+    if (j->state == JOB_DONE) {
+        free(text);
+    } else if (text) {
+        if (j->curl) {                        /* cancels the Groq transfer */
+            breaker_record(HOST_GROQ, 1, ms_since(&j->launched),
+                           (double)j->a.n / SAMPLE_RATE);   /* outrun counts as bad */
+            uploader_detach(u, j);
+        }
+        j->text = text;
+        j->state = JOB_DONE;
+        u->hedge_won++;
+        hedges.won++;
+        printf("dictator: chunk %zu: AssemblyAI answered first, after %.0f ms\n",
+               j->idx + 1, ms_since(&j->launched));
+    } else if (!j->curl && j->state == JOB_RUNNING) {
+        j->state = JOB_FAILED;                /* Groq gave up before */
     }
+    if (j->state == JOB_DONE) audio_free(&j->a);
+}
 
-    /* ── Step 2: Submit transcription job ─────────────────────────── */
-    curl = curl_easy_init();
-    if (!curl) { free(upload_url); curl_slist_free_all(headers); return NULL; }
+/* Keep j queued for at least ms */
+static void job_defer(struct upload_job *j, long ms) {
+    clock_gettime(CLOCK_MONOTONIC, &j->not_before);
+    j->not_before.tv_sec += ms / 1000;
+    j->not_before.tv_nsec += (ms % 1000) * 1000000L;
+    if (j->not_before.tv_nsec >= 1000000000L) {
+        j->not_before.tv_sec++;
+        j->not_before.tv_nsec -= 1000000000L;
+    }
+}
 
-    /* Replace Content-Type for JSON body */
-    curl_slist_free_all(headers);
-    headers = NULL;
-    headers = curl_slist_append(headers, aai_key);
-    headers = curl_slist_append(headers, "Content-Type: application/json");
+static void uploader_finished(struct uploader *u, struct upload_job *j, CURLcode res) {
+    char label[32];
+    snprintf(label, sizeof(label), "groq #%zu", j->idx + 1);
+    long wait = api_retry_ms(j->curl, res, HOST_GROQ, RETRY_IDEMPOTENT, j->tries);
+    if (wait >= 0 && (ms_since(&j->launched) + (double)wait > API_RETRY_BUDGET_MS ||
+                      (double)wait >= deadline_left()))
+        wait = -1;
+    int rc = api_check(j->curl, res, &j->resp, label, 0);
+    groq_record(j->curl, rc, &j->a);
+    uploader_detach(u, j);
+    if (rc == 0) {
+        trim_text(j->resp.data);
+        j->text = j->resp.data;
+        j->state = JOB_DONE;
+        groq_latency_observed((double)j->a.n / SAMPLE_RATE, ms_since(&j->launched));
+        if (j->hedge.active)
+            atomic_store(&j->hedge.cancel, 1);   /* reaped once it stops */
+        else
+            audio_free(&j->a);   /* done with the samples and encodings */
+        return;
+    }
+    free(j->resp.data);
+    j->resp.data = NULL;
+    if (wait >= 0) {
+        job_defer(j, wait);
+        j->state = JOB_QUEUED;
+        fprintf(stderr, "dictator: %s: retrying in %ld ms\n", label, wait);
+    } else {
+        /* with a hedge out the chunk waits for that instead */
+        j->state = j->hedge.active ? JOB_RUNNING : JOB_FAILED;
+    }
+}
 
-    char body[1024];
-    snprintf(body, sizeof(body),
-             "{\"audio_url\": \"%s\", \"speech_models\": [\"universal-3-pro\", \"universal-2\"]}", upload_url);
-    free(upload_url);
+/* Whether Groq takes a chunk now. It waits for a token from the bucket;
+ * a pause longer than the retry budget or the deadline, or an open
+ * circuit, sends it the sequential way (AssemblyAI) after the others.
+ * While a probe is out it waits for the verdict. A chunk the circuit
+ * holds back gives its token back. */
+static int uploader_may_launch(struct upload_job *j) {
+    long wait = bucket_take(HOST_GROQ);
+    if (wait > API_RETRY_BUDGET_MS || (double)wait >= deadline_left()) {
+        j->state = JOB_FAILED;
+        return 0;
+    }
+    if (wait > 0) {
+        job_defer(j, wait);
+        return 0;
+    }
+    if (breaker_allow(HOST_GROQ)) return 1;
+    bucket_give_back(HOST_GROQ);
+    if (!breaker_probing(HOST_GROQ)) j->state = JOB_FAILED;
+    return 0;
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL, "https://api.assemblyai.com/v2/transcript");
-    curl_easy_setopt(curl, CURLOPT_POST, 1L);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body);
+/* Out of time: stop every chunk still queued or running. Transfers
+ * launched before the deadline was set (while recording) don't time out
+ * by themselves. */
+static void uploader_expire(struct uploader *u) {
+    size_t stopped = 0;
+    for (size_t i = 0; i < u->njobs; i++) {
+        struct upload_job *j = u->jobs[i];
+        if (j->state != JOB_QUEUED && j->state != JOB_RUNNING) continue;
+        if (j->curl) uploader_detach(u, j);
+        if (j->hedge.active) atomic_store(&j->hedge.cancel, 1);   /* joined on free */
+        j->state = JOB_FAILED;
+        stopped++;
+    }
+    if (stopped) {
+        char what[64];
+        snprintf(what, sizeof(what), "%zu of %zu chunks", stopped, u->njobs);
+        deadline_exceeded(what);
+    }
+}
 
-    resp = (struct response){0};
-    if (api_request(curl, headers, &resp, "aai-submit") < 0) {
-        free(resp.data);
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(headers);
-        return NULL;
+/* Launch what may run, move transfers along for up to timeout_ms and
+ * collect finished ones. Returns the number of jobs still queued or
+ * running. */
+static size_t uploader_poll(struct uploader *u, int timeout_ms) {
+    if (deadline_passed()) {
+        uploader_expire(u);
+        return 0;
+    }
+    int can_hedge = cfg.hedge && have_aai && u->act != ACT_TRANSLATE;
+    size_t pending = 0;
+    for (size_t i = 0; i < u->njobs; i++) {
+        struct upload_job *j = u->jobs[i];
+        if (j->hedge.active && atomic_load(&j->hedge.done))
+            hedge_reap(u, j);
+        if (j->state == JOB_QUEUED && u->inflight < cfg.upload_concurrency &&
+            ms_since(&j->not_before) >= 0 && uploader_may_launch(j))
+            uploader_launch(u, j);
+        if (can_hedge && !j->hedge.tried && j->tries &&
+            (j->state == JOB_QUEUED || j->state == JOB_RUNNING) &&
+            ms_since(&j->launched) >= hedge_after_ms((double)j->a.n / SAMPLE_RATE) &&
+            aai_in_time((double)j->a.n / SAMPLE_RATE) && breaker_allow(HOST_AAI))
+            hedge_fire(u, j);
+        pending += j->state == JOB_QUEUED || j->state == JOB_RUNNING;
+    }
+    if (!pending) return 0;
+
+    int running;
+    curl_multi_perform(u->multi, &running);
+    curl_multi_poll(u->multi, NULL, 0, timeout_ms, NULL);
+    curl_multi_perform(u->multi, &running);
+
+    CURLMsg *msg;
+    int left;
+    while ((msg = curl_multi_info_read(u->multi, &left))) {
+        if (msg->msg != CURLMSG_DONE) continue;
+        struct upload_job *j = NULL;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&j);
+        if (j) uploader_finished(u, j, msg->data.result);
     }
 
-    char *transcript_id = json_get_string(resp.data, "id");
-    free(resp.data);
-    curl_easy_cleanup(curl);
+    pending = 0;
+    for (size_t i = 0; i < u->njobs; i++) {
+        struct upload_job *j = u->jobs[i];
+        if (j->hedge.active && atomic_load(&j->hedge.done))
+            hedge_reap(u, j);
+        pending += j->state == JOB_QUEUED || j->state == JOB_RUNNING;
+    }
+    return pending;
+}
 
-    if (!transcript_id) {
-        notify("Transcription submit failed: no ID returned");
-        curl_slist_free_all(headers);
-        return NULL;
+/* Run everything queued to completion (or the deadline), then give
+ * failed chunks the sequential path with its fallback if there is time */
+static void uploader_wait(struct uploader *u) {
+    while (u->multi && uploader_poll(u, 100) > 0)
+        ;
+    int notified = 0;
+    for (size_t i = 0; i < u->njobs; i++) {
+        struct upload_job *j = u->jobs[i];
+        if (j->state != JOB_FAILED) continue;
+        if (!u->multi) {              /* Groq was never tried */
+            j->text = u->act == ACT_TRANSLATE ? translate(&j->a) : transcribe(&j->a);
+        } else if (deadline_passed()) {
+            if (!notified++) deadline_exceeded("fallback");
+        } else if (!j->tries && u->act != ACT_TRANSLATE) {
+            j->text = transcribe(&j->a);  /* skipped: Groq's circuit is open */
+        } else if (u->act == ACT_TRANSLATE) {
+            if (!notified++) notify("Translation failed");
+        } else if (have_aai && !j->hedge.tried && !aai_in_time((double)j->a.n / SAMPLE_RATE)) {
+            if (!notified++) deadline_exceeded("AssemblyAI fallback");
+        } else if (have_aai && !j->hedge.tried && breaker_allow(HOST_AAI)) {
+            if (!notified++) {
+                fprintf(stderr, "dictator: Groq failed\n");
+                notify("Groq failed, trying AssemblyAI...");
+            }
+            j->text = transcribe_aai(&j->a);
+        } else if (j->hedge.tried || have_aai) {
+            if (!notified++) notify("Transcription failed");
+        }
+        if (j->text) j->state = JOB_DONE;
     }
+    if (u->njobs > 1)
+        printf("dictator: %zu chunks uploaded in %.0f ms, up to %d at a time\n",
+               u->njobs, ms_since(&u->t0), cfg.upload_concurrency);
+    if (u->hedged)
+        printf("dictator: %d of %zu chunks hedged, AssemblyAI won %d "
+               "(%d of %d since start)\n", u->hedged, u->njobs, u->hedge_won,
+               hedges.won, hedges.fired);
+}
 
-    /* ── Step 3: Poll for completion ──────────────────────────────── */
-    char poll_url[512];
-    snprintf(poll_url, sizeof(poll_url),
-             "https://api.assemblyai.com/v2/transcript/%s", transcript_id);
-    free(transcript_id);
+/* Append the chunk texts, in order and overlaps merged, to sb */
+static void uploader_collect(struct uploader *u, struct strbuf *sb) {
+    struct chunk_merge m = {0};
+    int rc = 0;
+    for (size_t i = 0; i < u->njobs; i++) {
+        struct upload_job *j = u->jobs[i];
+        rc |= chunk_merge_add(&m, sb, j->text, j->timed, j->seconds, j->overlap_s);
+    }
+    rc |= chunk_merge_end(&m, sb);
+    if (rc < 0) notify("Out of memory assembling transcript");
+}
 
-    /* Switch headers back (no Content-Type needed for GET) */
-    curl_slist_free_all(headers);
-    headers = NULL;
-    headers = curl_slist_append(headers, aai_key);
+static void uploader_free(struct uploader *u) {
+    for (size_t i = 0; i < u->njobs; i++) {
+        struct upload_job *j = u->jobs[i];
+        if (j->hedge.active) {
+            atomic_store(&j->hedge.cancel, 1);
+            pthread_join(j->hedge.tid, NULL);
+            free(j->hedge.text);
+        }
+        if (j->curl) uploader_detach(u, j);
+        audio_free(&j->a);
+        free(j->text);
+        free(j);
+    }
+    free(u->jobs);
+    if (u->multi) curl_multi_cleanup(u->multi);
+    *u = (struct uploader){0};
+}
 
-    char *result = NULL;
-    for (int attempt = 0; attempt < 120; attempt++) {
-        sleep(1);
+/* ── Streaming upload ───────────────────────────────────────────────── */
 
-        curl = curl_easy_init();
-        if (!curl) break;
+/*
+ * With stream_upload a long dictation starts going out while the key is
+ * still held: as soon as a full chunk has been captured it is cut at a
+ * quiet point, VAD-trimmed on its own and queued on an uploader driven
+ * by this thread. After release only the audio since the last cut is
+ * left to send. The thread is one more ring consumer; whatever it has
+ * read is already in pcm_buf, and the capture thread never writes below
+ * that again, so the chunk can be trimmed in place.
+ */
 
-        curl_easy_setopt(curl, CURLOPT_URL, poll_url);
-        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+#define STREAM_RING (PREROLL_RING + 8 * PERIOD_FRAMES)
 
-        resp = (struct response){0};
-        if (api_request(curl, headers, &resp, "aai-poll") < 0) {
-            free(resp.data);
-            curl_easy_cleanup(curl);
-            break;
+static struct {
+    struct pcm_ring ring;
+    pthread_t       tid;
+    int             active;
+    size_t          seen;        /* samples known to be in pcm_buf */
+    size_t          committed;   /* capture offset where unsent audio starts */
+    struct uploader up;          /* owned by the thread while it runs */
+    int             have_up;
+} stream;
+
+/* Queue pcm_buf[committed..cut) for upload and move committed to cut */
+static void stream_cut(size_t cut) {
+    int16_t *pcm = pcm_buf + stream.committed;
+    size_t n = cut - stream.committed;
+    struct span_list origin = {0};
+    if (cfg.vad) {
+        struct vad_stats vs;
+        n = vad_compact(pcm, n, &vs, &origin);
+        span_list_shift(&origin, stream.committed);
+    } else {
+        span_add(&origin, stream.committed, n);
+    }
+    if (n) {
+        struct audio a;
+        audio_chunk(&a, pcm, 0, n, &origin);
+        if (uploader_add(&stream.up, &a) < 0) {
+            audio_free(&a);
+            fprintf(stderr, "dictator: out of memory, chunk dropped\n");
+        } else {
+            printf("dictator: chunk %zu (%.1fs) queued while recording\n",
+                   stream.up.njobs, (double)n / SAMPLE_RATE);
         }
+    }
+    span_list_free(&origin);
+    stream.committed = cut;
+}
 
-        char *status = json_get_string(resp.data, "status");
-        if (status && strcmp(status, "completed") == 0) {
-            result = json_get_string(resp.data, "text");
-            free(status);
-            free(resp.data);
-            curl_easy_cleanup(curl);
-            break;
-        }
-        if (status && strcmp(status, "error") == 0) {
-            char *err = json_get_string(resp.data, "error");
-            char msg[256];
-            snprintf(msg, sizeof(msg), "Transcription error: %s",
-                     err ? err : "unknown");
-            notify(msg);
-            fprintf(stderr, "dictator: %s\n", msg);
-            fprintf(stderr, "dictator: response: %s\n",
-                    resp.data ? resp.data : "(null)");
-            free(err);
-            free(status);
-            free(resp.data);
-            curl_easy_cleanup(curl);
-            break;
-        }
-        free(status);
-        free(resp.data);
-        curl_easy_cleanup(curl);
+static void *stream_thread(void *arg) {
+    (void)arg;
+    size_t win = (size_t)CHUNK_SEARCH_MS * SAMPLE_RATE / 1000;
+    while (!pcm_ring_done(&stream.ring)) {
+        int16_t sink[PERIOD_FRAMES];
+        size_t n = pcm_ring_read(&stream.ring, sink, PERIOD_FRAMES);
+        stream.seen += n;
+        /* the warm-up thread has the shared connection cache until it
+         * is done; it must not be used from two threads at once */
+        int idle_net = !warm.busy;
+        if (idle_net && stream.seen >= stream.committed + CHUNK_SAMPLES + win + VAD_FRAME)
+            stream_cut(chunk_quiet_cut(pcm_buf, stream.seen,
+                                       stream.committed + CHUNK_SAMPLES));
+        if (n) continue;
+        if (!idle_net || !stream.up.multi || !uploader_poll(&stream.up, 20))
+            usleep(20000);
     }
+    return NULL;
+}
 
-    curl_slist_free_all(headers);
+static void stream_init(void) {
+    if (!cfg.stream_upload || !have_groq) return;   /* chunks go to Groq */
+    if (pcm_ring_init(&stream.ring, STREAM_RING) < 0) return;
+    if (capture_attach(&stream.ring) < 0) pcm_ring_free(&stream.ring);
+}
 
-    /* Trim trailing whitespace */
-    if (result) {
-        size_t len = strlen(result);
-        while (len > 0 && (result[len-1] == '\n' || result[len-1] == '\r'
-                           || result[len-1] == ' '))
-            result[--len] = '\0';
-    }
-    return result;
+/* After capture_arm() and warm_start() */
+static void stream_start(enum action act) {
+    if (!stream.ring.buf) return;
+    if (stream.have_up) uploader_free(&stream.up);   /* session was abandoned */
+    stream.have_up = 0;
+    /* the realtime session transcribes it; translations still need Groq */
+    if (rt.ring.buf && act != ACT_TRANSLATE) return;
+    stream.seen = 0;
+    stream.committed = 0;
+    uploader_init(&stream.up, act);
+    stream.have_up = 1;
+    stream.active = pthread_create(&stream.tid, NULL, stream_thread, NULL) == 0;
 }
 
-/* ── Transcription with fallback ───────────────────────────────────── */
+/* After capture_disarm() */
+static void stream_stop(void) {
+    if (!stream.active) return;
+    pthread_join(stream.tid, NULL);
+    stream.active = 0;
+}
 
-static char *transcribe(uint8_t *wav, size_t wav_len) {
-    if (have_groq) {
-        char *result = transcribe_groq(wav, wav_len);
-        if (result) return result;
-        fprintf(stderr, "dictator: Groq failed\n");
-        if (have_aai)
-            notify("Groq failed, trying AssemblyAI...");
+/* Hand the session's uploader over once the thread is stopped, or start
+ * a fresh one. Returns the capture offset where unsent audio begins. */
+static size_t stream_take(struct uploader *u, enum action act) {
+    if (!stream.have_up) {
+        uploader_init(u, act);
+        return 0;
     }
-    if (have_aai)
-        return transcribe_aai(wav, wav_len);
-    return NULL;
+    *u = stream.up;
+    stream.have_up = 0;
+    clock_gettime(CLOCK_MONOTONIC, &u->t0);   /* time after release */
+    return stream.committed;
 }
 
-/* ── Translation (Groq only — AssemblyAI doesn't support it) ───────── */
+static void stream_shutdown(void) {
+    if (stream.have_up) uploader_free(&stream.up);
+    stream.have_up = 0;
+    if (!stream.ring.buf) return;
+    capture_detach(&stream.ring);
+    pcm_ring_free(&stream.ring);
+}
 
-static char *translate(uint8_t *wav, size_t wav_len) {
-    if (!have_groq) {
-        notify("Translation requires Groq API key");
-        return NULL;
-    }
-    char *r = translate_groq(wav, wav_len);
-    if (!r) notify("Translation failed");
-    return r;
+/* Ring consumers that follow each session. The stream thread stops
+ * first: its chunks must not see the FLAC cache turn valid under them. */
+static void consumers_start(enum action act) {
+    pthread_mutex_lock(&enc_stats_lock);
+    memset(&enc_stats, 0, sizeof(enc_stats));
+    pthread_mutex_unlock(&enc_stats_lock);
+    meter_start();
+    flac_tap_start();
+    stream_start(act);
+    aai_live_start(act);
+    rt_start(act);
+}
+
+static void consumers_stop(void) {
+    stream_stop();
+    aai_live_stop();
+    rt_stop();
+    meter_stop();
+    flac_tap_stop();
 }
 
 /* ── Clipboard + paste ──────────────────────────────────────────────── */
@@ -767,56 +5811,151 @@ static void handle_signal(int sig) {
 
 /* ── Shared post-recording logic ─────────────────────────────────────── */
 
-static void handle_recording_done(enum action act) {
+/* VAD, chunk and upload pcm_buf[from..pcm_pos) on up, after the chunks
+ * it already holds, and append the texts to result. Returns -1 if there
+ * was nothing to send. */
+static int upload_recording(struct uploader *up, size_t from, struct strbuf *result) {
+    int16_t *tail = pcm_buf + from;
+    size_t n = pcm_pos - from;
+    struct span_list origin = {0};   /* where the upload's samples were captured */
+    if (cfg.vad) {
+        struct vad_stats vs;
+        n = vad_compact(tail, n, &vs, &origin);
+        span_list_shift(&origin, from);
+        if (n == 0 && up->njobs == 0) {
+            printf("dictator: VAD found no speech (floor %.0f dBFS), nothing uploaded\n",
+                   vs.floor_db);
+            notify("No speech detected");
+            span_list_free(&origin);
+            return -1;
+        }
+        printf("dictator: VAD kept %.1fs of %.1fs (floor %.0f dBFS, threshold %.0f dBFS)\n",
+               (double)vs.out / SAMPLE_RATE, (double)vs.in / SAMPLE_RATE,
+               vs.floor_db, vs.threshold_db);
+    } else {
+        span_add(&origin, from, n);
+    }
+
+    if (cfg.time_compress > 1.0)
+        printf("dictator: time compression %.2fx: %.1fs uploads as ~%.1fs\n",
+               cfg.time_compress, (double)n / SAMPLE_RATE,
+               (double)n / SAMPLE_RATE / cfg.time_compress);
+
+    size_t *ends = malloc((chunk_count(n) + 1) * sizeof(size_t));
+    if (!ends) {
+        notify("Out of memory");
+        span_list_free(&origin);
+        return -1;
+    }
+    size_t nchunks = chunk_plan(tail, n, ends);
+    /* a translation can't be aligned word for word: cut without overlap */
+    int overlap = nchunks > 1 && up->act != ACT_TRANSLATE;
+    for (size_t i = 0; i < nchunks; i++) {
+        size_t offset = i ? ends[i - 1] : 0;
+        size_t lead = overlap && i ? (size_t)CHUNK_OVERLAP_MS * SAMPLE_RATE / 1000 : 0;
+        if (lead > offset) lead = offset;
+        size_t len = ends[i] - offset + lead;
+        struct audio a;
+        audio_chunk(&a, tail, offset - lead, len, &origin);
+        a.timed = overlap;
+        a.overlap_s = (double)lead / SAMPLE_RATE * (double)a.n / (double)len;
+        if (uploader_add(up, &a) < 0) {
+            audio_free(&a);
+            notify("Out of memory");
+            break;
+        }
+    }
+    uploader_wait(up);
+    uploader_collect(up, result);
+    free(ends);
+    span_list_free(&origin);
+    return 0;
+}
+
+static void finish_recording(enum action act) {
+    warm_join();   /* a warm-up still connecting is the connection we want */
+    struct uploader up;
+    size_t from = stream_take(&up, act);   /* audio before this is already queued */
+    char *rt_text = rt_finish();
+    char *live_url = aai_live_finish();
     if (pcm_pos == 0) {
         notify("No audio captured");
+        uploader_free(&up);
+        free(rt_text);
+        free(live_url);
         return;
     }
 
     printf("dictator: captured %zu samples (%.1fs)\n",
            pcm_pos, (double)pcm_pos / SAMPLE_RATE);
-
-    size_t nchunks = (pcm_pos + CHUNK_SAMPLES - 1) / CHUNK_SAMPLES;
-    char result[16384] = "";
-    size_t result_len = 0;
-
-    for (size_t i = 0; i < nchunks; i++) {
-        size_t offset = i * CHUNK_SAMPLES;
-        size_t chunk_samples = pcm_pos - offset;
-        if (chunk_samples > CHUNK_SAMPLES) chunk_samples = CHUNK_SAMPLES;
-
-        uint8_t *wav;
-        size_t wav_len = build_wav(pcm_buf + offset, chunk_samples, &wav);
-        if (!wav_len) { notify("WAV build failed"); return; }
-
-        char *text = (act == ACT_TRANSLATE) ? translate(wav, wav_len)
-                                            : transcribe(wav, wav_len);
-        free(wav);
-
-        if (text && strlen(text) > 0) {
-            if (result_len > 0 && result_len + 1 < sizeof(result)) {
-                result[result_len++] = ' ';
-            }
-            size_t tlen = strlen(text);
-            if (result_len + tlen < sizeof(result)) {
-                memcpy(result + result_len, text, tlen);
-                result_len += tlen;
-                result[result_len] = '\0';
-            }
-        }
+    if (from)
+        printf("dictator: %zu chunks sent while recording, %.1fs left after release\n",
+               up.njobs, (double)(pcm_pos - from) / SAMPLE_RATE);
+    pthread_mutex_lock(&enc_stats_lock);
+    enc_stats.capture_ms = flac_tap.ms;
+    pthread_mutex_unlock(&enc_stats_lock);
+
+    struct strbuf result = {0};
+    char *text = rt_text ? rt_text
+               : live_url ? aai_transcript(live_url, (double)pcm_pos / SAMPLE_RATE, 0) : NULL;
+    free(live_url);
+    int rc = 0;
+    if (text) {
+        if (*text && strbuf_append_words(&result, text) < 0)
+            notify("Out of memory assembling transcript");
         free(text);
+    } else {
+        rc = upload_recording(&up, from, &result);
+    }
+    uploader_free(&up);
+    if (rc == 0) enc_stats_print();
+    flac_cache_clear();
+    pcm_store_reset(); /* give the audio memory back while idle */
+    if (rc < 0) {
+        strbuf_free(&result);
+        return;
     }
 
-    if (result_len > 0) {
-        paste_text(result, act != ACT_COPY);
+    if (result.len > 0) {
+        paste_text(result.data, act != ACT_COPY);
         const char *msg = (act == ACT_TRANSLATE) ? "Done — translated & pasted"
                         : (act == ACT_PASTE)     ? "Done — pasted"
                         :                          "Done — copied to clipboard";
         notify(msg);
-        printf("dictator: %s\n", result);
+        printf("dictator: %s\n", result.data);
     } else {
         notify("No text returned");
     }
+    strbuf_free(&result);
+}
+
+/* Everything after release runs against one deadline */
+static void handle_recording_done(enum action act) {
+    deadline_start((double)pcm_pos / SAMPLE_RATE);
+    finish_recording(act);
+    deadline_end();
+}
+
+/* ── Headless single run ─────────────────────────────────────────────── */
+
+/* --once: one press→paste cycle without a keyboard. Records from the
+ * capture source until it ends (or max_duration / Ctrl-C), then runs the
+ * normal transcription path. Meant for file and synthetic sources. */
+static int run_once(enum action act) {
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    capture_arm();
+    warm_start(act);
+    consumers_start(act);
+    while (capture_busy() && !quit)
+        usleep(20 * 1000);
+    capture_disarm();
+    consumers_stop();
+    double rec_ms = ms_since(&t0);
+    handle_recording_done(act);
+    printf("dictator: recorded %.0f ms, release→done %.0f ms\n",
+           rec_ms, ms_since(&t0) - rec_ms);
+    return pcm_pos ? 0 : 1;
 }
 
 /* ── Hotkey display helper ───────────────────────────────────────────── */
@@ -921,26 +6060,55 @@ static int run_x11(void) {
     print_hotkey(&cfg.speech2text_key,      copy_str,      sizeof(copy_str));
     print_hotkey(&cfg.speech2text_paste_key,     paste_str,     sizeof(paste_str));
     print_hotkey(&cfg.speech2text_translate_paste_key, translate_str,  sizeof(translate_str));
-    printf("dictator: ready (X11) — hold %s to copy, %s to paste, %s to translate\n",
-           copy_str, paste_str, translate_str);
+    printf("dictator: ready (X11) — %s %s to copy, %s to paste, %s to translate\n",
+           cfg.hands_free ? "press" : "hold", copy_str, paste_str, translate_str);
 
-    pthread_t tid;
     int is_recording = 0;
     enum action active_action = ACT_COPY;
     KeyCode active_kc = 0;
+    KeyCode held_kc = 0;   /* key currently down, to drop auto-repeat presses */
 
     int xfd = ConnectionNumber(dpy);
     XFlush(dpy); /* flush grab requests before entering poll loop */
     while (!quit) {
         /* Poll X fd with timeout so we can check quit flag */
-        struct pollfd xpfd = { .fd = xfd, .events = POLLIN };
-        int pr = poll(&xpfd, 1, 200);
+        struct pollfd xpfd[2] = {
+            { .fd = xfd,          .events = POLLIN },
+            { .fd = cap.done_fd,  .events = POLLIN },
+        };
+        int pr = poll(xpfd, 2, 200);
         if (pr <= 0) continue;
+        /* hands-free take ended by silence (or max_duration) */
+        if ((xpfd[1].revents & POLLIN) && capture_ended() &&
+            is_recording && cfg.hands_free) {
+            capture_disarm();
+            consumers_stop();
+            is_recording = 0;
+            handle_recording_done(active_action);
+        }
         while (XEventsQueued(dpy, QueuedAfterReading) > 0 && !quit) {
             XEvent ev;
             XNextEvent(dpy, &ev);
 
-            if (ev.type == KeyPress && !is_recording) {
+            /* Detectable auto-repeat sends repeated KeyPress with no
+             * KeyRelease in between: only a press of a key that was up
+             * may start or stop a take */
+            if (ev.type == KeyPress) {
+                if (ev.xkey.keycode == held_kc) continue;
+                held_kc = ev.xkey.keycode;
+            } else if (ev.type == KeyRelease && ev.xkey.keycode == held_kc) {
+                held_kc = 0;
+            }
+
+            if (ev.type == KeyPress && is_recording && cfg.hands_free &&
+                ev.xkey.keycode == active_kc) {
+                /* hands-free: a second press stops early */
+                capture_disarm();
+                consumers_stop();
+                is_recording = 0;
+                handle_recording_done(active_action);
+            }
+            else if (ev.type == KeyPress && !is_recording) {
                 /* Strip lock-key bits to match our configured modifiers */
                 unsigned clean = ev.xkey.state & ~(Mod2Mask | LockMask);
 
@@ -961,20 +6129,15 @@ static int run_x11(void) {
                 }
 
                 is_recording = 1;
-                recording = 1;
+                capture_arm();
+                warm_start(active_action);
+                consumers_start(active_action);
                 notify("Recording...");
-                if (pthread_create(&tid, NULL, record_thread, NULL) != 0) {
-                    perror("dictator: pthread_create");
-                    notify("Failed to start recording");
-                    is_recording = 0;
-                    recording = 0;
-                    continue;
-                }
             }
-            else if (ev.type == KeyRelease && is_recording &&
+            else if (ev.type == KeyRelease && is_recording && !cfg.hands_free &&
                      ev.xkey.keycode == active_kc) {
-                recording = 0;
-                pthread_join(tid, NULL);
+                capture_disarm();
+                consumers_stop();
                 is_recording = 0;
                 handle_recording_done(active_action);
             }
@@ -982,8 +6145,8 @@ static int run_x11(void) {
     }
 
     if (is_recording) {
-        recording = 0;
-        pthread_join(tid, NULL);
+        capture_disarm();
+        consumers_stop();
     }
     ungrab_hotkey(dpy, root, copy_kc,      cfg.speech2text_key.mod_mask);
     ungrab_hotkey(dpy, root, paste_kc,     cfg.speech2text_paste_key.mod_mask);
@@ -1133,20 +6296,31 @@ static int run_evdev(void) {
     print_hotkey(&cfg.speech2text_key,      copy_str,      sizeof(copy_str));
     print_hotkey(&cfg.speech2text_paste_key,     paste_str,     sizeof(paste_str));
     print_hotkey(&cfg.speech2text_translate_paste_key, translate_str,  sizeof(translate_str));
-    printf("dictator: ready (evdev/Wayland) — hold %s to copy, %s to paste, %s to translate\n",
-           copy_str, paste_str, translate_str);
+    printf("dictator: ready (evdev/Wayland) — %s %s to copy, %s to paste, %s to translate\n",
+           cfg.hands_free ? "press" : "hold", copy_str, paste_str, translate_str);
 
-    pthread_t tid;
     int is_recording = 0;
     enum action active_action = ACT_COPY;
     int active_code = 0;
 
-    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    struct pollfd pfd[2] = {
+        { .fd = fd,          .events = POLLIN },
+        { .fd = cap.done_fd, .events = POLLIN },
+    };
 
     while (!quit) {
-        int ret = poll(&pfd, 1, 200); /* 200ms timeout to check quit */
+        int ret = poll(pfd, 2, 200); /* 200ms timeout to check quit */
         if (ret <= 0) continue;
 
+        /* hands-free take ended by silence (or max_duration) */
+        if ((pfd[1].revents & POLLIN) && capture_ended() &&
+            is_recording && cfg.hands_free) {
+            capture_disarm();
+            consumers_stop();
+            is_recording = 0;
+            handle_recording_done(active_action);
+        }
+
         struct input_event ev;
         int rc;
         while ((rc = libevdev_next_event(dev, LIBEVDEV_READ_FLAG_NORMAL, &ev))
@@ -1157,7 +6331,15 @@ static int run_evdev(void) {
             /* Update modifier state for all key events */
             update_mod_state(ev.code, ev.value != 0);
 
-            if (ev.value == 1 && !is_recording) {
+            if (ev.value == 1 && is_recording && cfg.hands_free &&
+                (int)ev.code == active_code) {
+                /* hands-free: a second press stops early */
+                capture_disarm();
+                consumers_stop();
+                is_recording = 0;
+                handle_recording_done(active_action);
+            }
+            else if (ev.value == 1 && !is_recording) {
                 /* Key press (not repeat) */
                 int matched = 0;
                 if ((int)ev.code == translate_code &&
@@ -1179,21 +6361,16 @@ static int run_evdev(void) {
                 if (!matched) continue;
 
                 is_recording = 1;
-                recording = 1;
+                capture_arm();
+                warm_start(active_action);
+                consumers_start(active_action);
                 notify("Recording...");
-                if (pthread_create(&tid, NULL, record_thread, NULL) != 0) {
-                    perror("dictator: pthread_create");
-                    notify("Failed to start recording");
-                    is_recording = 0;
-                    recording = 0;
-                    continue;
-                }
             }
-            else if (ev.value == 0 && is_recording &&
+            else if (ev.value == 0 && is_recording && !cfg.hands_free &&
                      (int)ev.code == active_code) {
                 /* Key release */
-                recording = 0;
-                pthread_join(tid, NULL);
+                capture_disarm();
+                consumers_stop();
                 is_recording = 0;
                 handle_recording_done(active_action);
             }
@@ -1201,8 +6378,8 @@ static int run_evdev(void) {
     }
 
     if (is_recording) {
-        recording = 0;
-        pthread_join(tid, NULL);
+        capture_disarm();
+        consumers_stop();
     }
     libevdev_free(dev);
     close(fd);
@@ -1213,18 +6390,60 @@ static int run_evdev(void) {
 
 /* ── Main ───────────────────────────────────────────────────────────── */
 
-int main(void) {
+static void usage(void) {
+    fprintf(stderr,
+            "usage: dictator [--source SPEC] [--once [copy|paste|translate]]\n"
+            "  --source SPEC  capture from alsa, wav:PATH, raw:PATH, fd:N,\n"
+            "                 tone[:HZ] or noise (overrides capture_source)\n"
+            "  --once         record until the source ends, transcribe, exit\n");
+}
+
+int main(int argc, char **argv) {
     load_config();
+
+    int once = 0;
+    enum action once_act = ACT_COPY;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--source") == 0 && i + 1 < argc) {
+            snprintf(cfg.capture_source, sizeof(cfg.capture_source), "%s", argv[++i]);
+        } else if (strcmp(argv[i], "--once") == 0) {
+            once = 1;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                const char *a = argv[++i];
+                if (strcmp(a, "copy") == 0)           once_act = ACT_COPY;
+                else if (strcmp(a, "paste") == 0)     once_act = ACT_PASTE;
+                else if (strcmp(a, "translate") == 0) once_act = ACT_TRANSLATE;
+                else { usage(); return 1; }
+            }
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
     if (load_env() < 0) return 1;
     curl_global_init(CURL_GLOBAL_ALL);
+    pool_init();
 
     signal(SIGINT,  handle_signal);
     signal(SIGTERM, handle_signal);
 
     active_backend = detect_backend();
+    if (capture_init() < 0) {
+        pool_shutdown();
+        curl_global_cleanup();
+        return 1;
+    }
+    meter_init();
+    flac_tap_init();
+    stream_init();
+    aai_live_init();
+    rt_init();
 
     int rc = 1;
-    switch (active_backend) {
+    if (once)
+        rc = run_once(once_act);
+    else switch (active_backend) {
 #ifdef USE_X11
     case BACKEND_X11:
         rc = run_x11();
@@ -1240,6 +6459,14 @@ int main(void) {
         break;
     }
 
+    rt_shutdown();
+    aai_live_shutdown();
+    stream_shutdown();
+    flac_tap_shutdown();
+    meter_shutdown();
+    capture_shutdown();
+    warm_join();
+    pool_shutdown();
     curl_global_cleanup();
     printf("dictator: shutdown\n");
     return rc;
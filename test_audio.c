@@ -1,5 +1,5 @@
 /*
- * test_audio — unit tests for WAV building and audio chunking
+ * test_audio — unit tests for WAV/FLAC building and audio chunking
  * Build: make test_audio
  * Run:   ./test_audio
  *
@@ -43,11 +43,13 @@ static int    mock_paste_autopaste;
 
 /* ── Mock implementations ────────────────────────────────────────────── */
 
-static char *test_transcribe(uint8_t *wav, size_t wav_len) {
+static char *test_transcribe(struct audio *a) {
     mock_transcribe_calls++;
 
     /* Validate WAV header */
-    if (wav_len < 44) return NULL;
+    size_t wav_len;
+    const uint8_t *wav = audio_encode(a, CODEC_WAV, &wav_len);
+    if (!wav || wav_len < 44) return NULL;
     if (memcmp(wav, "RIFF", 4) != 0) return NULL;
     if (memcmp(wav + 8, "WAVE", 4) != 0) return NULL;
     if (memcmp(wav + 12, "fmt ", 4) != 0) return NULL;
@@ -59,11 +61,13 @@ static char *test_transcribe(uint8_t *wav, size_t wav_len) {
     return result;
 }
 
-static char *test_translate(uint8_t *wav, size_t wav_len) {
+static char *test_translate(struct audio *a) {
     mock_translate_calls++;
 
     /* Validate WAV header */
-    if (wav_len < 44) return NULL;
+    size_t wav_len;
+    const uint8_t *wav = audio_encode(a, CODEC_WAV, &wav_len);
+    if (!wav || wav_len < 44) return NULL;
     if (memcmp(wav, "RIFF", 4) != 0) return NULL;
 
     char *result = malloc(32);
@@ -85,40 +89,40 @@ static void test_paste_text(const char *text, int autopaste) {
 static void mock_handle_recording_done(enum action act) {
     if (pcm_pos == 0) return;
 
-    size_t nchunks = (pcm_pos + CHUNK_SAMPLES - 1) / CHUNK_SAMPLES;
-    char result[16384] = "";
-    size_t result_len = 0;
+    struct span_list origin = {0};
+    if (cfg.vad) {
+        pcm_pos = vad_compact(pcm_buf, pcm_pos, NULL, &origin);
+        if (pcm_pos == 0) { span_list_free(&origin); return; }
+    } else {
+        span_add(&origin, 0, pcm_pos);
+    }
 
-    for (size_t i = 0; i < nchunks; i++) {
-        size_t offset = i * CHUNK_SAMPLES;
-        size_t chunk_samples = pcm_pos - offset;
-        if (chunk_samples > CHUNK_SAMPLES) chunk_samples = CHUNK_SAMPLES;
+    size_t *ends = malloc(chunk_count(pcm_pos) * sizeof(size_t));
+    if (!ends) { span_list_free(&origin); return; }
+    size_t nchunks = chunk_plan(pcm_buf, pcm_pos, ends);
+    struct strbuf result = {0};
 
-        uint8_t *wav;
-        size_t wav_len = build_wav(pcm_buf + offset, chunk_samples, &wav);
-        if (!wav_len) return;
+    for (size_t i = 0; i < nchunks; i++) {
+        size_t offset = i ? ends[i - 1] : 0;
+        size_t chunk_samples = ends[i] - offset;
 
-        char *text = (act == ACT_TRANSLATE) ? test_translate(wav, wav_len)
-                                            : test_transcribe(wav, wav_len);
-        free(wav);
+        struct audio a;
+        audio_chunk(&a, pcm_buf, offset, chunk_samples, &origin);
+        char *text = (act == ACT_TRANSLATE) ? test_translate(&a)
+                                            : test_transcribe(&a);
+        audio_free(&a);
 
-        if (text && strlen(text) > 0) {
-            if (result_len > 0 && result_len + 1 < sizeof(result)) {
-                result[result_len++] = ' ';
-            }
-            size_t tlen = strlen(text);
-            if (result_len + tlen < sizeof(result)) {
-                memcpy(result + result_len, text, tlen);
-                result_len += tlen;
-                result[result_len] = '\0';
-            }
-        }
+        if (text && strlen(text) > 0)
+            strbuf_append_words(&result, text);
         free(text);
     }
+    free(ends);
+    span_list_free(&origin);
 
-    if (result_len > 0) {
-        test_paste_text(result, act != ACT_COPY);
+    if (result.len > 0) {
+        test_paste_text(result.data, act != ACT_COPY);
     }
+    strbuf_free(&result);
 }
 
 /* ── Test harness ────────────────────────────────────────────────────── */
@@ -139,8 +143,14 @@ static void reset_mocks(void) {
     mock_paste_calls = 0;
     mock_paste_buf[0] = '\0';
     mock_paste_autopaste = -1;
-    pcm_pos = 0;
-    memset(pcm_buf, 0, sizeof(pcm_buf));
+    cfg.vad = 0;       /* chunking tests record pure silence */
+    pcm_store_reset(); /* fresh store: every sample reads back as zero */
+}
+
+/* Pretend the capture thread recorded `samples` samples of silence */
+static void set_recorded(size_t samples) {
+    pcm_store_reserve(samples);
+    pcm_pos = samples;
 }
 
 /* ── build_wav tests ─────────────────────────────────────────────────── */
@@ -220,13 +230,48 @@ static void test_build_wav_single_sample(void) {
     free(wav);
 }
 
+/* The callback body sends the same bytes as build_wav, without a copy */
+static void test_wav_body_matches_build_wav(void) {
+    printf("test_wav_body_matches_build_wav\n");
+    reset_mocks();
+
+    size_t n = 4001;
+    int16_t *samples = malloc(n * sizeof(int16_t));
+    for (size_t i = 0; i < n; i++) samples[i] = (int16_t)(i * 37);
+    uint8_t *wav = NULL;
+    size_t wav_len = build_wav(samples, n, &wav);
+
+    struct audio a = { .pcm = samples, .n = n };
+    struct body b;
+    ASSERT(audio_body(&a, CODEC_WAV, &b) == 0, "body set up");
+    ASSERT(b.len == wav_len, "body length = WAV length");
+    ASSERT(b.data == (const uint8_t *)samples, "samples read in place");
+
+    /* odd read sizes straddle the header/data boundary */
+    uint8_t *out = malloc(wav_len + 16);
+    size_t got = 0, r;
+    while ((r = body_read((char *)out + got, 1, 7, &b)) > 0) got += r;
+    ASSERT(got == wav_len, "read whole body");
+    ASSERT(memcmp(out, wav, wav_len) == 0, "bytes match build_wav");
+
+    /* rewound for a retry, it reads the same again */
+    ASSERT(body_seek(&b, 0, SEEK_SET) == CURL_SEEKFUNC_OK, "rewind");
+    ASSERT(body_read((char *)out, 1, wav_len + 16, &b) == wav_len, "re-read in one go");
+    ASSERT(memcmp(out, wav, wav_len) == 0, "re-read bytes match");
+    ASSERT(body_seek(&b, 1, SEEK_END) == CURL_SEEKFUNC_FAIL, "seek past end refused");
+
+    free(out);
+    free(wav);
+    free(samples);
+}
+
 /* ── Chunking tests ──────────────────────────────────────────────────── */
 
 static void test_chunk_short_recording(void) {
     printf("test_chunk_short_recording\n");
     reset_mocks();
 
-    pcm_pos = SAMPLE_RATE * 10; /* 10 seconds */
+    set_recorded(SAMPLE_RATE * 10); /* 10 seconds */
     mock_handle_recording_done(ACT_COPY);
 
     ASSERT(mock_transcribe_calls == 1, "short recording: 1 transcribe call");
@@ -239,7 +284,7 @@ static void test_chunk_exactly_30s(void) {
     printf("test_chunk_exactly_30s\n");
     reset_mocks();
 
-    pcm_pos = CHUNK_SAMPLES; /* exactly 30s */
+    set_recorded(CHUNK_SAMPLES); /* exactly 30s */
     mock_handle_recording_done(ACT_PASTE);
 
     ASSERT(mock_transcribe_calls == 1, "30s: 1 transcribe call");
@@ -252,7 +297,7 @@ static void test_chunk_45s(void) {
     printf("test_chunk_45s\n");
     reset_mocks();
 
-    pcm_pos = SAMPLE_RATE * 45; /* 2 chunks: 30s + 15s */
+    set_recorded(SAMPLE_RATE * 45); /* 2 chunks: 30s + 15s */
     mock_handle_recording_done(ACT_COPY);
 
     ASSERT(mock_transcribe_calls == 2, "45s: 2 transcribe calls");
@@ -264,7 +309,7 @@ static void test_chunk_60s(void) {
     printf("test_chunk_60s\n");
     reset_mocks();
 
-    pcm_pos = SAMPLE_RATE * 60; /* 60s = 2 chunks of 30s */
+    set_recorded(SAMPLE_RATE * 60); /* 60s = 2 chunks of 30s */
     mock_handle_recording_done(ACT_PASTE);
 
     ASSERT(mock_transcribe_calls == 2, "60s: 2 transcribe calls");
@@ -278,7 +323,7 @@ static void test_chunk_300s(void) {
     reset_mocks();
 
     cfg.max_duration = 300;
-    pcm_pos = BUF_SAMPLES; /* 300s = 10 chunks of 30s */
+    set_recorded(SAMPLE_RATE * 300); /* 300s = 10 chunks of 30s */
     mock_handle_recording_done(ACT_PASTE);
 
     ASSERT(mock_transcribe_calls == 10, "300s: 10 transcribe calls");
@@ -302,19 +347,19 @@ static void test_chunk_autopaste_flag(void) {
 
     /* ACT_COPY → autopaste=0 */
     reset_mocks();
-    pcm_pos = SAMPLE_RATE;
+    set_recorded(SAMPLE_RATE);
     mock_handle_recording_done(ACT_COPY);
     ASSERT(mock_paste_autopaste == 0, "ACT_COPY: no autopaste");
 
     /* ACT_PASTE → autopaste=1 */
     reset_mocks();
-    pcm_pos = SAMPLE_RATE;
+    set_recorded(SAMPLE_RATE);
     mock_handle_recording_done(ACT_PASTE);
     ASSERT(mock_paste_autopaste == 1, "ACT_PASTE: autopaste set");
 
     /* ACT_TRANSLATE → autopaste=1 */
     reset_mocks();
-    pcm_pos = SAMPLE_RATE;
+    set_recorded(SAMPLE_RATE);
     mock_handle_recording_done(ACT_TRANSLATE);
     ASSERT(mock_paste_autopaste == 1, "ACT_TRANSLATE: autopaste set");
 }
@@ -323,7 +368,7 @@ static void test_chunk_translate(void) {
     printf("test_chunk_translate\n");
     reset_mocks();
 
-    pcm_pos = SAMPLE_RATE * 10; /* 10 seconds */
+    set_recorded(SAMPLE_RATE * 10); /* 10 seconds */
     mock_handle_recording_done(ACT_TRANSLATE);
 
     ASSERT(mock_transcribe_calls == 0, "translate: no transcribe calls");
@@ -333,6 +378,863 @@ static void test_chunk_translate(void) {
     ASSERT(mock_paste_autopaste == 1, "translate: autopaste set");
 }
 
+/* ── Capture store tests ─────────────────────────────────────────────── */
+
+static void test_store_spill_roundtrip(void) {
+    printf("test_store_spill_roundtrip\n");
+    reset_mocks();
+
+    /* past the RAM segments, into the spill file */
+    size_t n = (STORE_RAM_SEGS + 2) * (size_t)STORE_SEG_SAMPLES + 123;
+    ASSERT(pcm_store_reserve(n) == 0, "reserve beyond RAM segments");
+    ASSERT(store.fd >= 0, "spill file created");
+    for (size_t i = 0; i < n; i++) pcm_buf[i] = (int16_t)(i * 31);
+    pcm_store_release(n);
+    ASSERT(store.released > STORE_RAM_SEGS * (size_t)STORE_SEG_SAMPLES,
+           "filled spill segments released from RSS");
+
+    int ok = 1;
+    for (size_t i = 0; i < n; i++)
+        if (pcm_buf[i] != (int16_t)(i * 31)) { ok = 0; break; }
+    ASSERT(ok, "samples read back intact after release");
+
+    pcm_store_reset();
+    ASSERT(store.nsegs == 0 && pcm_pos == 0, "reset empties store");
+    pcm_store_reserve(n);
+    ASSERT(pcm_buf[n - 1] == 0 && pcm_buf[0] == 0, "reused store reads back as zero");
+    reset_mocks();
+}
+
+static void test_store_max_duration_bound(void) {
+    printf("test_store_max_duration_bound\n");
+    reset_mocks();
+    ASSERT(pcm_store_reserve(STORE_MAX_SEGS * (size_t)STORE_SEG_SAMPLES + 1) == -1,
+           "cannot grow past STORE_MAX_SEGS");
+    reset_mocks();
+}
+
+static void test_transcript_not_truncated(void) {
+    printf("test_transcript_not_truncated\n");
+    struct strbuf sb = {0};
+    for (int i = 0; i < 5000; i++)
+        strbuf_append_words(&sb, "word");
+    ASSERT(sb.len == 5000 * 5 - 1, "25 KB transcript kept whole");
+    ASSERT(strncmp(sb.data, "word word", 9) == 0, "space separated");
+    strbuf_free(&sb);
+    ASSERT(sb.data == NULL && sb.len == 0, "strbuf_free resets");
+}
+
+/* ── Resampler and capture source tests ──────────────────────────────── */
+
+/* Peak of a resampled sine after the filter has settled */
+static int resample_tone_peak(unsigned rate, unsigned channels, double hz,
+                              float (*dot)(const float *, const float *, unsigned)) {
+    struct resampler rs;
+    if (resampler_init(&rs, rate, SAMPLE_RATE) < 0) return -1;
+    if (dot) rs.dot = dot;
+    size_t frames = rate / 2;
+    int16_t *in = malloc(frames * channels * sizeof(int16_t));
+    int16_t *out = malloc(resampler_max_out(&rs, frames) * sizeof(int16_t));
+    for (size_t i = 0; i < frames; i++)
+        for (unsigned c = 0; c < channels; c++)
+            in[i * channels + c] = (int16_t)lrint(10000 * sin(2 * M_PI * hz * i / rate));
+    size_t n = resampler_process(&rs, in, frames, channels, out);
+    int peak = 0;
+    for (size_t i = n / 4; i < n; i++)
+        if (abs(out[i]) > peak) peak = abs(out[i]);
+    free(in);
+    free(out);
+    resampler_free(&rs);
+    return peak;
+}
+
+static void test_resample_48k_stereo(void) {
+    printf("test_resample_48k_stereo\n");
+    struct resampler rs;
+    ASSERT(resampler_init(&rs, 48000, SAMPLE_RATE) == 0, "48k init");
+    ASSERT(rs.L == 1 && rs.M == 3, "48k is 1/3");
+    ASSERT(rs.taps % 8 == 0, "taps multiple of 8");
+    /* block size must not change the output count */
+    int16_t in[3 * 1000 * 2] = {0}, out[2100];
+    size_t total = 0;
+    for (int i = 0; i < 6; i++)
+        total += resampler_process(&rs, in + i * 1000, 500, 2, out);
+    ASSERT(total == 1000, "3000 frames → 1000 samples");
+    resampler_free(&rs);
+
+    int peak = resample_tone_peak(48000, 2, 1000, NULL);
+    ASSERT(peak > 9700 && peak < 10300, "1 kHz passes at unity gain");
+    peak = resample_tone_peak(48000, 2, 12000, NULL);
+    ASSERT(peak < 100, "12 kHz rejected (would alias to 4 kHz)");
+}
+
+static void test_resample_44k1(void) {
+    printf("test_resample_44k1\n");
+    struct resampler rs;
+    ASSERT(resampler_init(&rs, 44100, SAMPLE_RATE) == 0, "44.1k init");
+    ASSERT(rs.L == 160 && rs.M == 441, "44.1k is 160/441");
+    resampler_free(&rs);
+    int peak = resample_tone_peak(44100, 1, 440, NULL);
+    ASSERT(peak > 9700 && peak < 10300, "440 Hz passes at unity gain");
+    ASSERT(resampler_init(&rs, 44101, SAMPLE_RATE) == -1, "unreasonable ratio refused");
+}
+
+static void test_resample_simd_matches_scalar(void) {
+    printf("test_resample_simd_matches_scalar\n");
+    int ref = resample_tone_peak(44100, 2, 3000, dot_scalar);
+    int best = resample_tone_peak(44100, 2, 3000, resampler_pick_dot());
+    ASSERT(abs(ref - best) <= 1, "selected kernel matches scalar");
+#ifdef HAVE_X86_SIMD
+    int sse = resample_tone_peak(44100, 2, 3000, dot_sse2);
+    ASSERT(abs(ref - sse) <= 1, "SSE2 matches scalar");
+#endif
+}
+
+static void test_source_wav_roundtrip(void) {
+    printf("test_source_wav_roundtrip\n");
+    int16_t in[4000];
+    for (int i = 0; i < 4000; i++) in[i] = (int16_t)(i * 7 - 14000);
+    uint8_t *wav;
+    size_t wav_len = build_wav(in, 4000, &wav);
+    char path[] = "/tmp/test_audio_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0 && write(fd, wav, wav_len) == (ssize_t)wav_len, "temp wav written");
+    close(fd);
+    free(wav);
+
+    char spec[64];
+    snprintf(spec, sizeof(spec), "wav:%s", path);
+    ASSERT(capture_select_source(spec) == 0, "wav source selected");
+    ASSERT(capture_open() == 0, "wav source opens");
+    ASSERT(cap.rate == SAMPLE_RATE && cap.channels == 1 && !cap.convert,
+           "16 kHz mono wav needs no conversion");
+    ASSERT(capture_stream_start() == 0, "wav source starts");
+    int16_t out[4096];
+    size_t got = 0;
+    snd_pcm_sframes_t n;
+    while ((n = capture_pull(out + got, 1024)) > 0) got += (size_t)n;
+    ASSERT(n == 0 && got == 4000, "whole data chunk read, then EOF");
+    ASSERT(memcmp(in, out, sizeof(in)) == 0, "samples identical");
+    capture_stream_stop();
+    ASSERT(capture_stream_start() == 0 && capture_pull(out, 16) == 16 && out[0] == in[0],
+           "replays from the start on the next press");
+    capture_stream_stop();
+    capture_close();
+    unlink(path);
+}
+
+/* A 48 kHz file is resampled; a one-frame read may yield no output yet,
+ * and only the source itself says when the input ends */
+static void test_source_resampled_short_reads(void) {
+    printf("test_source_resampled_short_reads\n");
+    int16_t in[4800] = {0};
+    uint8_t *wav;
+    size_t wav_len = build_wav(in, 4800, &wav);
+    uint32_t rate = 48000, byte_rate = 96000;
+    memcpy(wav + 24, &rate, 4);
+    memcpy(wav + 28, &byte_rate, 4);
+    char path[] = "/tmp/test_audio_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0 && write(fd, wav, wav_len) == (ssize_t)wav_len, "temp wav written");
+    close(fd);
+    free(wav);
+
+    char spec[64];
+    snprintf(spec, sizeof(spec), "wav:%s", path);
+    ASSERT(capture_select_source(spec) == 0 && capture_open() == 0, "48 kHz wav opens");
+    ASSERT(cap.convert && capture_stream_start() == 0, "resampled");
+    int16_t out[16];
+    int empty_midway = 0;
+    size_t got = 0;
+    snd_pcm_sframes_t n;
+    for (int i = 0; i < 4800; i++) {
+        n = capture_pull(out, 1);
+        if (n == 0 && !cap.src_ended) empty_midway = 1;
+        if (n > 0) got += (size_t)n;
+    }
+    ASSERT(empty_midway, "short read: nothing out, but not the end");
+    n = capture_pull(out, 1);
+    ASSERT(n == 0 && cap.src_ended, "then the source reports its end");
+    ASSERT(got > 1500 && got <= 1601, "a third of the frames came out");
+    capture_stream_stop();
+    capture_close();
+    unlink(path);
+}
+
+static void test_source_tone(void) {
+    printf("test_source_tone\n");
+    ASSERT(capture_select_source("tone:1000") == 0, "tone source selected");
+    ASSERT(capture_open() == 0 && capture_stream_start() == 0, "tone source starts");
+    int16_t out[1024];
+    ASSERT(capture_pull(out, 1024) == 1024, "one period");
+    int peak = 0;
+    for (int i = 0; i < 1024; i++) if (abs(out[i]) > peak) peak = abs(out[i]);
+    ASSERT(peak > SYNTH_AMPLITUDE - 100 && peak <= SYNTH_AMPLITUDE, "-12 dBFS sine");
+    capture_stream_stop();
+    capture_close();
+
+    ASSERT(capture_select_source("bogus") == -1, "unknown source rejected");
+    ASSERT(capture_select_source("wav") == -1, "wav without a path rejected");
+    ASSERT(capture_select_source("noise") == 0 && capture_open() == 0, "noise source opens");
+    capture_close();
+    ASSERT(capture_select_source("tone:9000") == 0 && capture_open() == -1,
+           "tone above Nyquist refused");
+}
+
+static void test_plan_balanced(void) {
+    printf("test_plan_balanced\n");
+    reset_mocks();
+    size_t ends[16];
+    set_recorded(SAMPLE_RATE * 31);
+    ASSERT(chunk_plan(pcm_buf, pcm_pos, ends) == 2, "31s: 2 chunks");
+    ASSERT(ends[0] >= SAMPLE_RATE * 15 && ends[0] <= SAMPLE_RATE * 16,
+           "31s: split in the middle, no 1 s sliver");
+    ASSERT(ends[1] == pcm_pos, "last chunk ends at the recording end");
+
+    reset_mocks();
+    set_recorded(SAMPLE_RATE * 300);
+    size_t n = chunk_plan(pcm_buf, pcm_pos, ends);
+    ASSERT(n == 10, "300s: 10 chunks");
+    int ok = 1;
+    for (size_t i = 0; i < n; i++) {
+        size_t len = ends[i] - (i ? ends[i - 1] : 0);
+        if (len > CHUNK_SAMPLES + VAD_FRAME || len < CHUNK_SAMPLES - VAD_FRAME) ok = 0;
+    }
+    ASSERT(ok, "300s: every chunk ~30 s");
+
+    reset_mocks();
+    set_recorded(SAMPLE_RATE * 12);
+    ASSERT(chunk_plan(pcm_buf, pcm_pos, ends) == 1 && ends[0] == pcm_pos,
+           "short recording: one chunk, no cut");
+    reset_mocks();
+}
+
+static void test_plan_cuts_in_pause(void) {
+    printf("test_plan_cuts_in_pause\n");
+    reset_mocks();
+    set_recorded(SAMPLE_RATE * 45);
+    /* continuous "speech" except a 200 ms pause 1.2 s before nominal 22.5 s */
+    for (size_t i = 0; i < pcm_pos; i++)
+        pcm_buf[i] = (int16_t)(6000 * sin(2 * M_PI * 300 * i / SAMPLE_RATE));
+    size_t gap = (size_t)(21.2 * SAMPLE_RATE);
+    memset(pcm_buf + gap, 0, SAMPLE_RATE / 5 * sizeof(int16_t));
+
+    size_t ends[4];
+    ASSERT(chunk_plan(pcm_buf, pcm_pos, ends) == 2, "45s: 2 chunks");
+    ASSERT(ends[0] >= gap && ends[0] < gap + SAMPLE_RATE / 5, "cut lands in the pause");
+
+    /* pause outside the search window: cut stays near nominal */
+    memset(pcm_buf + gap, 0x10, SAMPLE_RATE / 5 * sizeof(int16_t));
+    size_t far = 15 * SAMPLE_RATE;
+    memset(pcm_buf + far, 0, SAMPLE_RATE / 5 * sizeof(int16_t));
+    chunk_plan(pcm_buf, pcm_pos, ends);
+    size_t nominal = pcm_pos / 2;
+    ASSERT(ends[0] + CHUNK_SEARCH_MS * SAMPLE_RATE / 1000 >= nominal &&
+           ends[0] <= nominal + CHUNK_SEARCH_MS * SAMPLE_RATE / 1000,
+           "cut never leaves the search window");
+    reset_mocks();
+}
+
+/* ── VAD tests ───────────────────────────────────────────────────────── */
+
+/* Fill [from, to) seconds with low hiss or a 300 Hz vowel-ish tone */
+static void fill_seconds(double from, double to, int tone) {
+    size_t a = (size_t)(from * SAMPLE_RATE), b = (size_t)(to * SAMPLE_RATE);
+    for (size_t i = a; i < b; i++)
+        pcm_buf[i] = tone ? (int16_t)(6000 * sin(2 * M_PI * 300 * i / SAMPLE_RATE))
+                          : (int16_t)(rand() % 61 - 30);
+}
+
+static void test_vad_frame_stats(void) {
+    printf("test_vad_frame_stats\n");
+    int16_t x[203];
+    for (int i = 0; i < 203; i++) x[i] = (int16_t)(rand() % 65536 - 32768);
+    x[5] = x[6] = -32768;   /* pmaddwd worst case */
+    size_t lens[] = { 1, 9, VAD_FRAME, 203 };
+    for (int k = 0; k < 4; k++) {
+        uint64_t e_ref = 0, e;
+        unsigned z_ref = 0, z;
+        for (size_t i = 0; i < lens[k]; i++) {
+            e_ref += (uint64_t)((int32_t)x[i] * x[i]);
+            if (i && ((x[i] < 0) != (x[i - 1] < 0))) z_ref++;
+        }
+        vad_frame_stats(x, lens[k], &e, &z);
+        ASSERT(e == e_ref && z == z_ref, "frame stats match scalar reference");
+    }
+}
+
+static void test_vad_silence_skips_upload(void) {
+    printf("test_vad_silence_skips_upload\n");
+    reset_mocks();
+    cfg.vad = 1;
+    set_recorded(SAMPLE_RATE * 5);
+    fill_seconds(0, 5, 0);
+    pcm_buf[SAMPLE_RATE] = 20000;   /* a key click is not speech */
+    pcm_buf[SAMPLE_RATE + 1] = -20000;
+    mock_handle_recording_done(ACT_PASTE);
+    ASSERT(mock_transcribe_calls == 0, "silence: nothing uploaded");
+    ASSERT(mock_paste_calls == 0, "silence: nothing pasted");
+    reset_mocks();
+}
+
+static void test_vad_trims_and_compacts(void) {
+    printf("test_vad_trims_and_compacts\n");
+    reset_mocks();
+    cfg.vad = 1;
+    set_recorded(SAMPLE_RATE * 9);
+    fill_seconds(0, 2, 0);
+    fill_seconds(2, 3, 1);
+    fill_seconds(3, 6, 0);
+    fill_seconds(6, 7, 1);
+    fill_seconds(7, 9, 0);
+
+    struct vad_stats vs;
+    size_t n = vad_compact(pcm_buf, pcm_pos, &vs, NULL);
+    double expect = 2 * VAD_PAD_MS / 1000.0 + 2.0 + cfg.vad_max_pause_ms / 1000.0;
+    ASSERT(fabs((double)n / SAMPLE_RATE - expect) < 0.05,
+           "leading/trailing silence trimmed, 3 s pause shortened");
+    ASSERT(vs.in == pcm_pos && vs.out == n, "stats report sizes");
+    ASSERT(vs.voiced >= 195 && vs.voiced <= 205, "2 s of speech frames");
+    size_t lead = VAD_PAD_MS * SAMPLE_RATE / 1000;
+    ASSERT(abs(pcm_buf[lead - 10]) <= 30 && abs(pcm_buf[lead + 40]) > 1000,
+           "speech starts right after the pad");
+
+    /* a short pause is left alone */
+    pcm_store_reset();
+    set_recorded(SAMPLE_RATE * 3);
+    fill_seconds(0, 1, 1);
+    fill_seconds(1, 1.4, 0);
+    fill_seconds(1.4, 3, 1);
+    ASSERT(vad_compact(pcm_buf, pcm_pos, NULL, NULL) == pcm_pos, "400 ms pause kept");
+    reset_mocks();
+}
+
+/* Chunks cut while recording: trimmed in place, spans in capture offsets */
+static void test_stream_cut_spans(void) {
+    printf("test_stream_cut_spans\n");
+    reset_mocks();
+    cfg.vad = 1;
+    set_recorded(SAMPLE_RATE * 65);
+    fill_seconds(0, 65, 1);
+    fill_seconds(40, 45, 0);   /* long pause inside the second chunk */
+    uploader_init(&stream.up, ACT_COPY);
+    stream.committed = 0;
+
+    size_t cut = chunk_quiet_cut(pcm_buf, pcm_pos, CHUNK_SAMPLES);
+    stream_cut(cut);
+    ASSERT(stream.committed == cut && stream.up.njobs == 1, "first chunk queued");
+    struct audio *a = &stream.up.jobs[0]->a;
+    ASSERT(a->nspans == 1 && a->spans[0].raw == 0 && a->spans[0].len == cut,
+           "all speech: one span from the start");
+
+    size_t cut2 = chunk_quiet_cut(pcm_buf, pcm_pos, cut + CHUNK_SAMPLES);
+    stream_cut(cut2);
+    ASSERT(stream.committed == cut2 && stream.up.njobs == 2, "second chunk queued");
+    a = &stream.up.jobs[1]->a;
+    ASSERT(a->nspans == 2 && a->spans[0].raw == cut, "pause splits the origin");
+    ASSERT(a->n < cut2 - cut && a->spans[0].len + a->spans[1].len == a->n,
+           "pause shortened, spans cover the upload");
+    ASSERT(a->spans[1].raw + a->spans[1].len == cut2, "second span ends at the cut");
+    ASSERT(a->pcm == pcm_buf + cut, "trimmed in place");
+    uploader_free(&stream.up);
+    reset_mocks();
+}
+
+/* ── Endpoint detector tests ────────────────────────────────────────── */
+
+/* Feed pcm_buf[from..to) seconds in 1024-sample periods; returns the
+ * time in seconds at which the endpoint fired, or -1 */
+static double feed_endpoint(struct endpoint *ep, double from, double to) {
+    size_t a = (size_t)(from * SAMPLE_RATE), b = (size_t)(to * SAMPLE_RATE);
+    for (size_t i = a; i < b; i += 1024) {
+        size_t n = b - i < 1024 ? b - i : 1024;
+        if (endpoint_feed(ep, pcm_buf + i, n))
+            return (double)(i + n) / SAMPLE_RATE;
+    }
+    return -1;
+}
+
+static void test_endpoint_trailing_silence(void) {
+    printf("test_endpoint_trailing_silence\n");
+    reset_mocks();
+    set_recorded(SAMPLE_RATE * 6);
+    fill_seconds(0, 1, 0);
+    fill_seconds(1, 2, 1);
+    fill_seconds(2, 2.5, 0);   /* short pause mid-sentence */
+    fill_seconds(2.5, 3.5, 1);
+    fill_seconds(3.5, 6, 0);
+
+    struct endpoint ep;
+    endpoint_reset(&ep);
+    double t = feed_endpoint(&ep, 0, 6);
+    double expect = 3.5 + cfg.endpoint_ms / 1000.0;
+    ASSERT(t > 0, "endpoint fires");
+    ASSERT(t >= expect && t < expect + 0.1, "after endpoint_ms of trailing silence");
+    reset_mocks();
+}
+
+static void test_endpoint_waits_for_speech(void) {
+    printf("test_endpoint_waits_for_speech\n");
+    reset_mocks();
+    set_recorded(SAMPLE_RATE * 10);
+    fill_seconds(0, 10, 0);
+    pcm_buf[SAMPLE_RATE] = 20000;   /* click */
+
+    struct endpoint ep;
+    endpoint_reset(&ep);
+    double t = feed_endpoint(&ep, 0, 10);
+    ASSERT(t >= ENDPOINT_NO_SPEECH_MS / 1000.0 && t < ENDPOINT_NO_SPEECH_MS / 1000.0 + 0.1,
+           "silence alone only gives up after ENDPOINT_NO_SPEECH_MS");
+
+    /* speech starting late is not cut off by the leading silence */
+    fill_seconds(4, 6, 1);
+    endpoint_reset(&ep);
+    t = feed_endpoint(&ep, 0, 10);
+    ASSERT(t >= 6 + cfg.endpoint_ms / 1000.0, "leading silence does not end the take");
+    reset_mocks();
+}
+
+/* ── Time compression tests ──────────────────────────────────────────── */
+
+/* Dominant period of x via autocorrelation over 2..20 ms */
+static int tone_period(const int16_t *x, size_t n) {
+    int best_lag = 0;
+    double best = -1;
+    for (int lag = SAMPLE_RATE / 500; lag <= SAMPLE_RATE / 50; lag++) {
+        double r = 0;
+        for (size_t i = 0; i + (size_t)lag < n; i++) r += (double)x[i] * x[i + lag];
+        if (r > best) { best = r; best_lag = lag; }
+    }
+    return best_lag;
+}
+
+static void test_wsola_length_and_pitch(void) {
+    printf("test_wsola_length_and_pitch\n");
+    size_t n = SAMPLE_RATE * 4;
+    int16_t *in = malloc(n * sizeof(int16_t));
+    for (size_t i = 0; i < n; i++)   /* 200 Hz: period 80 samples */
+        in[i] = (int16_t)(8000 * sin(2 * M_PI * 200 * i / SAMPLE_RATE));
+
+    int16_t *out;
+    size_t m = time_compress(in, n, 1.5, &out);
+    ASSERT(out != NULL, "compressed buffer returned");
+    ASSERT(fabs((double)m / n - 1 / 1.5) < 0.01, "1.5x: length is 2/3");
+    ASSERT(tone_period(out + SAMPLE_RATE, SAMPLE_RATE / 2) == 80, "pitch unchanged");
+    int peak = 0;
+    for (size_t i = WSOLA_WIN; i < m - WSOLA_WIN; i++)
+        if (abs(out[i]) > peak) peak = abs(out[i]);
+    ASSERT(peak > 7600 && peak < 8400, "level unchanged (frames stay in phase)");
+    free(out);
+
+    m = time_compress(in, n, 1.25, &out);
+    ASSERT(fabs((double)m / n - 1 / 1.25) < 0.01, "1.25x: length is 4/5");
+    free(out);
+
+    ASSERT(time_compress(in, n, 1.0, &out) == 0 && out == NULL, "1.0x: left as is");
+    ASSERT(time_compress(in, WSOLA_WIN, 1.5, &out) == 0, "too short: left as is");
+    free(in);
+}
+
+static void test_chunk_time_compressed(void) {
+    printf("test_chunk_time_compressed\n");
+    reset_mocks();
+    set_recorded(SAMPLE_RATE * 10);
+    fill_seconds(0, 10, 1);
+    struct audio a;
+    cfg.time_compress = 1.25;
+    audio_chunk(&a, pcm_buf, 0, pcm_pos, NULL);
+    cfg.time_compress = 1.0;
+    size_t len;
+    ASSERT(audio_encode(&a, CODEC_WAV, &len) != NULL, "wav built");
+    ASSERT(fabs((double)(len - 44) / FRAME_SIZE / SAMPLE_RATE - 8.0) < 0.05,
+           "10 s at 1.25x uploads as 8 s");
+    audio_free(&a);
+    reset_mocks();
+}
+
+/* ── Chunk overlap merge ────────────────────────────────────────────── */
+
+/* Merge chunk texts as uploader_collect() does */
+static char *merge_chunks(const char **texts, const double *seconds,
+                          const double *overlap_s, size_t n) {
+    struct chunk_merge m = {0};
+    struct strbuf sb = {0};
+    for (size_t i = 0; i < n; i++)
+        chunk_merge_add(&m, &sb, texts[i], 1, seconds[i], overlap_s[i]);
+    chunk_merge_end(&m, &sb);
+    return sb.data;
+}
+
+static void test_word_list_parse(void) {
+    printf("test_word_list_parse\n");
+    struct word_list w;
+    ASSERT(word_list_parse("{\"text\": \" Hi, there.\", \"segments\": [{\"text\": \"x\", "
+                           "\"tokens\": [1, 2]}], \"words\": [{\"word\": \" Hi,\", "
+                           "\"start\": 0.5, \"end\": 0.75}, {\"word\": \"there.\", "
+                           "\"start\": 1, \"end\": 1.5}]}", &w) == 0, "Groq words parsed");
+    ASSERT(w.n == 2 && strcmp(w.v[0].text, "Hi,") == 0 && strcmp(w.v[1].text, "there.") == 0,
+           "Groq words trimmed, in order");
+    ASSERT(w.v[0].start == 0.5 && w.v[1].end == 1.5, "Groq times in seconds");
+    ASSERT(w.text && w.v[0].at == 1 && w.v[1].at == 5, "Groq words found in the text");
+    word_list_free(&w);
+    ASSERT(word_list_parse("{\"status\": \"completed\", \"text\": \"Hi\", \"words\": "
+                           "[{\"text\": \"Hi\", \"start\": 250, \"end\": 750, "
+                           "\"confidence\": 0.9, \"speaker\": null}]}", &w) == 0,
+           "AssemblyAI words parsed");
+    ASSERT(w.n == 1 && w.v[0].start == 0.25 && w.v[0].end == 0.75, "AssemblyAI ms to seconds");
+    word_list_free(&w);
+    ASSERT(word_list_parse("{\"words\": []}", &w) == 0 && w.n == 0, "no words heard");
+    ASSERT(word_list_parse("{\"text\": \"Hi\"}", &w) < 0, "no words array");
+    ASSERT(word_list_parse("plain text", &w) < 0, "not JSON");
+}
+
+static void test_merge_aligned_overlap(void) {
+    printf("test_merge_aligned_overlap\n");
+    /* the 10 s cut went through "five": chunk 2 repeats 8..10 s */
+    const char *texts[] = {
+        "{\"words\": [{\"word\": \"one\", \"start\": 7.0, \"end\": 7.3}, "
+        "{\"word\": \"two\", \"start\": 7.5, \"end\": 7.8}, "
+        "{\"word\": \"three\", \"start\": 8.2, \"end\": 8.6}, "
+        "{\"word\": \"four\", \"start\": 8.9, \"end\": 9.3}, "
+        "{\"word\": \"fi-\", \"start\": 9.7, \"end\": 10.0}]}",
+        /* from AssemblyAI (a hedge), in ms, timestamps a little off */
+        "{\"words\": [{\"text\": \"Three,\", \"start\": 350, \"end\": 700}, "
+        "{\"text\": \"four\", \"start\": 900, \"end\": 1300}, "
+        "{\"text\": \"five\", \"start\": 1700, \"end\": 2100}, "
+        "{\"text\": \"six.\", \"start\": 2500, \"end\": 2900}]}",
+    };
+    double seconds[] = { 10, 5 }, overlap[] = { 0, 2 };
+    char *text = merge_chunks(texts, seconds, overlap, 2);
+    ASSERT(text && strcmp(text, "one two three four five six.") == 0,
+           "overlap said once, the word cut in two taken whole");
+    free(text);
+}
+
+static void test_merge_splits_unmatched_overlap(void) {
+    printf("test_merge_splits_unmatched_overlap\n");
+    /* the chunks heard the overlap differently: split it at 9 s */
+    const char *texts[] = {
+        "{\"words\": [{\"word\": \"start\", \"start\": 1, \"end\": 2}, "
+        "{\"word\": \"alpha\", \"start\": 8.4, \"end\": 8.8}, "
+        "{\"word\": \"beta\", \"start\": 9.2, \"end\": 9.6}]}",
+        "{\"words\": [{\"word\": \"gamma\", \"start\": 0.4, \"end\": 0.8}, "
+        "{\"word\": \"delta\", \"start\": 1.2, \"end\": 1.6}, "
+        "{\"word\": \"end\", \"start\": 3, \"end\": 4}]}",
+    };
+    double seconds[] = { 10, 5 }, overlap[] = { 0, 2 };
+    char *text = merge_chunks(texts, seconds, overlap, 2);
+    ASSERT(text && strcmp(text, "start alpha delta end") == 0, "each half from one chunk");
+    free(text);
+}
+
+static void test_merge_keeps_punctuation(void) {
+    printf("test_merge_keeps_punctuation\n");
+    /* Whisper's words carry no punctuation; the text around them does */
+    const char *texts[] = {
+        "{\"text\": \" Well, one, two. Three, four\", \"words\": ["
+        "{\"word\": \"Well\", \"start\": 6.5, \"end\": 6.8}, "
+        "{\"word\": \"one\", \"start\": 7.0, \"end\": 7.3}, "
+        "{\"word\": \"two\", \"start\": 7.5, \"end\": 7.8}, "
+        "{\"word\": \"Three\", \"start\": 8.2, \"end\": 8.6}, "
+        "{\"word\": \"four\", \"start\": 8.9, \"end\": 9.3}]}",
+        "{\"text\": \" Three, four, \\\"five\\\". Six!\", \"words\": ["
+        "{\"word\": \"Three\", \"start\": 0.2, \"end\": 0.6}, "
+        "{\"word\": \"four\", \"start\": 0.9, \"end\": 1.3}, "
+        "{\"word\": \"five\", \"start\": 1.7, \"end\": 2.1}, "
+        "{\"word\": \"Six\", \"start\": 2.5, \"end\": 2.9}]}",
+    };
+    double seconds[] = { 10, 5 }, overlap[] = { 0, 2 };
+    char *text = merge_chunks(texts, seconds, overlap, 2);
+    ASSERT(text && strcmp(text, "Well, one, two. Three, four, \"five\". Six!") == 0,
+           "each side cut from its own punctuated text");
+    free(text);
+    /* no spaces put between CJK words */
+    const char *cjk[] = {
+        "{\"text\": \"你好，世界。\", \"words\": ["
+        "{\"word\": \"你好\", \"start\": 0.2, \"end\": 0.6}, "
+        "{\"word\": \"世界\", \"start\": 0.7, \"end\": 1.1}]}",
+    };
+    double cjk_s[] = { 2 }, cjk_o[] = { 0 };
+    text = merge_chunks(cjk, cjk_s, cjk_o, 1);
+    ASSERT(text && strcmp(text, "你好，世界。") == 0, "CJK text as transcribed");
+    free(text);
+    /* words missing from the text: joined as words */
+    const char *odd[] = {
+        "{\"text\": \" something else\", \"words\": ["
+        "{\"word\": \"hello\", \"start\": 0.2, \"end\": 0.6}]}",
+    };
+    text = merge_chunks(odd, cjk_s, cjk_o, 1);
+    ASSERT(text && strcmp(text, "hello") == 0, "unlocated words fall back");
+    free(text);
+}
+
+static void test_merge_without_words(void) {
+    printf("test_merge_without_words\n");
+    struct chunk_merge m = {0};
+    struct strbuf sb = {0};
+    chunk_merge_add(&m, &sb, "{\"words\": [{\"word\": \"a\", \"start\": 1, \"end\": 2}]}",
+                    1, 30, 0);
+    chunk_merge_add(&m, &sb, NULL, 1, 30, 2);                          /* failed */
+    chunk_merge_add(&m, &sb, "{\"text\": \" b c \"}", 1, 30, 2);       /* no words */
+    chunk_merge_add(&m, &sb, "d e", 0, 30, 0);                         /* streamed */
+    chunk_merge_end(&m, &sb);
+    ASSERT(sb.data && strcmp(sb.data, "a b c d e") == 0, "texts joined as before");
+    strbuf_free(&sb);
+}
+
+/* upload_recording() with no keys: the chunks are cut and queued, and
+ * nothing is sent */
+static void test_chunks_overlap(void) {
+    printf("test_chunks_overlap\n");
+    reset_mocks();
+    cfg.vad = 0;
+    cfg.notify = 0;
+    set_recorded(SAMPLE_RATE * 60);
+    fill_seconds(0, 60, 1);
+    struct uploader up;
+    struct strbuf sb = {0};
+    uploader_init(&up, ACT_COPY);
+    upload_recording(&up, 0, &sb);
+    ASSERT(up.njobs == 2, "60 s: 2 chunks");
+    struct audio *a = &up.jobs[0]->a, *b = &up.jobs[1]->a;
+    size_t lead = (size_t)CHUNK_OVERLAP_MS * SAMPLE_RATE / 1000;
+    ASSERT(b->pcm + lead == a->pcm + a->n, "second chunk starts 2 s before the cut");
+    ASSERT(b->pcm + b->n == pcm_buf + pcm_pos, "and runs to the end");
+    ASSERT(up.jobs[0]->overlap_s == 0 && up.jobs[1]->overlap_s == CHUNK_OVERLAP_MS / 1000.0,
+           "overlap recorded");
+    ASSERT(up.jobs[0]->timed && up.jobs[1]->timed, "timestamps requested");
+    uploader_free(&up);
+
+    uploader_init(&up, ACT_TRANSLATE);
+    upload_recording(&up, 0, &sb);
+    a = &up.jobs[0]->a;
+    b = &up.jobs[1]->a;
+    ASSERT(b->pcm == a->pcm + a->n && !up.jobs[1]->timed, "translation: no overlap");
+    uploader_free(&up);
+    strbuf_free(&sb);
+    reset_mocks();
+}
+
+/* ── FLAC tests ─────────────────────────────────────────────────────── */
+
+struct bitreader { const uint8_t *p; size_t len, pos; };   /* pos in bits */
+
+static uint32_t br_get(struct bitreader *br, unsigned bits) {
+    uint32_t v = 0;
+    while (bits--) {
+        if (br->pos >= br->len * 8) return 0;
+        v = (v << 1) | ((br->p[br->pos / 8] >> (7 - br->pos % 8)) & 1);
+        br->pos++;
+    }
+    return v;
+}
+
+static int32_t br_signed(struct bitreader *br, unsigned bits) {
+    uint32_t v = br_get(br, bits);
+    return (int32_t)(v << (32 - bits)) >> (32 - bits);
+}
+
+static uint64_t br_coded(struct bitreader *br) {
+    uint32_t b = br_get(br, 8);
+    int extra = 0;
+    while (extra < 7 && (b & (0x80 >> extra))) extra++;
+    if (extra == 0) return b;
+    uint64_t v = b & (0x7F >> extra);
+    for (int i = 1; i < extra; i++) v = (v << 6) | (br_get(br, 8) & 0x3F);
+    return v;
+}
+
+/* Decode a stream from flac_encode(), checking sync codes, both CRCs and
+ * frame sample numbers. Returns samples decoded or -1. */
+static long flac_decode(const uint8_t *buf, size_t len, int16_t *out, size_t cap) {
+    if (len < 42 || memcmp(buf, "fLaC", 4) != 0 || buf[4] != 0x80) return -1;
+    struct bitreader br = { buf, len, 8 * 8 + 16 * 2 + 24 * 2 };
+    if (br_get(&br, 20) != SAMPLE_RATE || br_get(&br, 3) != 0 ||
+        br_get(&br, 5) != 15)
+        return -1;
+    uint64_t total = (uint64_t)br_get(&br, 4) << 32;
+    total |= br_get(&br, 32);
+    size_t n = 0;
+    br.pos = 42 * 8;
+    while (br.pos < len * 8) {
+        size_t start = br.pos / 8;
+        if (br_get(&br, 16) != 0xFFF9) return -1;
+        unsigned bs = br_get(&br, 4);
+        if (br_get(&br, 4) != 5 || br_get(&br, 4) != 0 || br_get(&br, 4) != 8) return -1;
+        if (br_coded(&br) != n) return -1;
+        size_t blk = (bs == 6 ? br_get(&br, 8) : br_get(&br, 16)) + 1;
+        if (flac_crc8(buf + start, br.pos / 8 - start) != br_get(&br, 8)) return -1;
+        if (n + blk > cap) return -1;
+        int16_t *x = out + n;
+
+        unsigned type = br_get(&br, 8) >> 1;
+        if (type == 0) {
+            int16_t v = (int16_t)br_signed(&br, 16);
+            for (size_t i = 0; i < blk; i++) x[i] = v;
+        } else if (type == 1) {
+            for (size_t i = 0; i < blk; i++) x[i] = (int16_t)br_signed(&br, 16);
+        } else if (type >= 8 && type <= 12) {
+            unsigned order = type - 8;
+            for (unsigned i = 0; i < order; i++) x[i] = (int16_t)br_signed(&br, 16);
+            if (br_get(&br, 2) != 0) return -1;
+            unsigned porder = br_get(&br, 4);
+            size_t i = order;
+            for (unsigned part = 0; part < (1u << porder); part++) {
+                unsigned k = br_get(&br, 4);
+                size_t end = (part + 1) * (blk >> porder);
+                for (; i < end; i++) {
+                    uint32_t q = 0;
+                    while (!br_get(&br, 1)) q++;
+                    uint32_t u = (q << k) | br_get(&br, k);
+                    int32_t r = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+                    int32_t p = order == 0 ? 0
+                              : order == 1 ? x[i - 1]
+                              : order == 2 ? 2 * x[i - 1] - x[i - 2]
+                              : order == 3 ? 3 * x[i - 1] - 3 * x[i - 2] + x[i - 3]
+                              : 4 * x[i - 1] - 6 * x[i - 2] + 4 * x[i - 3] - x[i - 4];
+                    x[i] = (int16_t)(p + r);
+                }
+            }
+        } else {
+            return -1;
+        }
+        br.pos = (br.pos + 7) / 8 * 8;
+        size_t end = br.pos / 8;
+        if (flac_crc16(buf + start, end - start) != br_get(&br, 16)) return -1;
+        n += blk;
+    }
+    return n == total ? (long)n : -1;
+}
+
+static void test_flac_roundtrip(void) {
+    printf("test_flac_roundtrip\n");
+    size_t n = SAMPLE_RATE * 3 + 1234;          /* not a block multiple */
+    int16_t *in = malloc(n * sizeof(int16_t)), *out = malloc(n * sizeof(int16_t));
+    for (size_t i = 0; i < n; i++) {
+        double t = (double)i / SAMPLE_RATE;
+        in[i] = t < 1 ? (int16_t)(6000 * sin(2 * M_PI * 300 * t) + rand() % 200 - 100)
+              : t < 2 ? 0                                     /* constant */
+              :         (int16_t)(rand() % 65536 - 32768);    /* verbatim */
+    }
+    in[n - 1] = -32768;
+    uint8_t *flac;
+    size_t len = flac_encode(in, n, NULL, 0, &flac);
+    ASSERT(len > 0, "encoded");
+    ASSERT(flac_decode(flac, len, out, n) == (long)n, "decodes with valid CRCs");
+    ASSERT(memcmp(in, out, n * sizeof(int16_t)) == 0, "lossless");
+    free(flac);
+
+    /* the speech-like second alone packs well below WAV */
+    len = flac_encode(in, SAMPLE_RATE, NULL, 0, &flac);
+    ASSERT(len < SAMPLE_RATE * FRAME_SIZE * 6 / 10, "tone + hiss under 60% of PCM");
+    free(flac);
+
+    len = flac_encode(in, 5, NULL, 0, &flac);
+    ASSERT(flac_decode(flac, len, out, n) == 5 && memcmp(in, out, 10) == 0,
+           "tiny input");
+    free(flac);
+    free(in);
+    free(out);
+}
+
+/* Feed pcm_buf[0..pcm_pos) through the real encoder tap, as the capture
+ * thread would, minus `lost` samples at the end */
+static void run_flac_tap(size_t lost) {
+    pcm_ring_init(&flac_tap.ring, FLAC_TAP_RING);
+    flac_tap_start();
+    for (size_t at = 0; at < pcm_pos - lost;) {
+        size_t w = pcm_ring_write(&flac_tap.ring, pcm_buf + at,
+                                  pcm_pos - lost - at < PERIOD_FRAMES ? pcm_pos - lost - at
+                                                                 : PERIOD_FRAMES);
+        if (!w) usleep(1000);
+        at += w;
+    }
+    pcm_ring_close(&flac_tap.ring);
+    flac_tap_stop();
+    pcm_ring_free(&flac_tap.ring);
+}
+
+static void test_flac_stitched_from_capture(void) {
+    printf("test_flac_stitched_from_capture\n");
+    reset_mocks();
+    set_recorded(SAMPLE_RATE * 9);
+    fill_seconds(0, 2, 0);
+    fill_seconds(2, 3, 1);
+    fill_seconds(3, 6, 0);
+    fill_seconds(6, 7, 1);
+    fill_seconds(7, 9, 0);
+    run_flac_tap(0);
+    ASSERT(flac_cache.valid, "tap kept up");
+    ASSERT(flac_cache.nblocks == pcm_pos / FLAC_BLOCK, "one payload per full block");
+
+    cfg.vad = 1;
+    struct span_list origin = {0};
+    pcm_pos = vad_compact(pcm_buf, pcm_pos, NULL, &origin);
+    ASSERT(origin.n == 2, "VAD kept two capture ranges");
+
+    /* two chunks, cut off a frame boundary */
+    size_t cut = pcm_pos / 2 + 37, ok = 1;
+    int16_t *out = malloc(pcm_pos * sizeof(int16_t));
+    for (int c = 0; c < 2; c++) {
+        size_t off = c ? cut : 0, n = c ? pcm_pos - cut : cut;
+        struct audio a, fresh;
+        audio_chunk(&a, pcm_buf, off, n, &origin);
+        audio_chunk(&fresh, pcm_buf, off, n, &origin);
+        size_t len, flen;
+        const uint8_t *flac = audio_encode(&a, CODEC_FLAC, &len);
+        flac_cache.valid = 0;
+        const uint8_t *ref = audio_encode(&fresh, CODEC_FLAC, &flen);
+        flac_cache.valid = 1;
+        ok &= flac && ref && len == flen && memcmp(flac, ref, len) == 0;
+        ok &= flac_decode(flac, len, out, pcm_pos) == (long)n &&
+              memcmp(out, pcm_buf + off, n * sizeof(int16_t)) == 0;
+        audio_free(&a);
+        audio_free(&fresh);
+    }
+    ASSERT(ok, "stitched chunks match a fresh encode and decode losslessly");
+    ASSERT(enc_stats.bytes[CODEC_FLAC] < enc_stats.wav_bytes[CODEC_FLAC] / 2,
+           "stats: FLAC under half of WAV");
+
+    free(out);
+    span_list_free(&origin);
+    flac_cache_clear();
+    memset(&enc_stats, 0, sizeof(enc_stats));
+    reset_mocks();
+}
+
+static void test_flac_tap_dropped_samples(void) {
+    printf("test_flac_tap_dropped_samples\n");
+    reset_mocks();
+    set_recorded(SAMPLE_RATE * 2);
+    fill_seconds(0, 2, 1);
+    run_flac_tap(0);
+    ASSERT(flac_cache.valid, "complete take: cache valid");
+    run_flac_tap(1);    /* a full ring dropped a sample the store kept */
+    ASSERT(!flac_cache.valid, "incomplete take: cache not used");
+    size_t len;
+    ASSERT(flac_cached_block(0, &len) == NULL, "no cached frames served");
+    flac_cache_clear();
+    reset_mocks();
+}
+
+/* A hands-free take that ended on its own just as a press stopped it
+ * leaves its event behind; the next take must not see it */
+static void test_stale_end_event_dropped(void) {
+    printf("test_stale_end_event_dropped\n");
+    snprintf(cfg.capture_source, sizeof(cfg.capture_source), "tone");
+    ASSERT(capture_init() == 0, "capture thread started");
+    eventfd_write(cap.done_fd, 1);
+    capture_arm();
+    ASSERT(!capture_ended(), "new take starts without the old event");
+    usleep(50 * 1000);
+    capture_disarm();
+    capture_shutdown();
+    ASSERT(pcm_pos > 0, "and records");
+    cap.quit = 0;
+    snprintf(cfg.capture_source, sizeof(cfg.capture_source), "alsa");
+    reset_mocks();
+}
+
 /* ── Main ───────────────────────────────────────────────────────────── */
 
 int main(void) {
@@ -340,6 +1242,7 @@ int main(void) {
     test_build_wav_1s();
     test_build_wav_chunk_size();
     test_build_wav_single_sample();
+    test_wav_body_matches_build_wav();
 
     /* chunking tests */
     test_chunk_short_recording();
@@ -350,6 +1253,51 @@ int main(void) {
     test_chunk_zero_samples();
     test_chunk_autopaste_flag();
     test_chunk_translate();
+    test_plan_balanced();
+    test_plan_cuts_in_pause();
+
+    /* capture store */
+    test_store_spill_roundtrip();
+    test_store_max_duration_bound();
+    test_transcript_not_truncated();
+
+    /* voice activity detection */
+    test_vad_frame_stats();
+    test_vad_silence_skips_upload();
+    test_vad_trims_and_compacts();
+    test_stream_cut_spans();
+
+    /* endpoint detector */
+    test_endpoint_trailing_silence();
+    test_endpoint_waits_for_speech();
+
+    /* time compression */
+    test_wsola_length_and_pitch();
+    test_chunk_time_compressed();
+
+    /* overlap merge */
+    test_word_list_parse();
+    test_merge_aligned_overlap();
+    test_merge_splits_unmatched_overlap();
+    test_merge_keeps_punctuation();
+    test_merge_without_words();
+    test_chunks_overlap();
+
+    /* FLAC */
+    test_flac_roundtrip();
+    test_flac_stitched_from_capture();
+    test_flac_tap_dropped_samples();
+
+    /* resampler */
+    test_resample_48k_stereo();
+    test_resample_44k1();
+    test_resample_simd_matches_scalar();
+
+    /* capture sources */
+    test_source_wav_roundtrip();
+    test_source_resampled_short_reads();
+    test_source_tone();
+    test_stale_end_event_dropped();
 
     printf("\n%d tests, %d failed\n", tests_run, tests_failed);
     return tests_failed ? 1 : 0;
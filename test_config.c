@@ -36,6 +36,31 @@ static void reset_cfg(void) {
     cfg.max_duration = MAX_SECONDS;
     snprintf(cfg.groq_model, sizeof(cfg.groq_model), "whisper-large-v3");
     cfg.proxy[0] = '\0';
+    cfg.groq_codec = CODEC_WAV;
+    cfg.aai_codec = CODEC_WAV;
+    cfg.upload_concurrency = 4;
+    cfg.hedge = 1;
+    cfg.hedge_after_ms = 0;
+    cfg.groq_rpm = 0;
+    cfg.aai_rpm = 0;
+    cfg.latency_slo_ms = 20000;
+    cfg.stream_upload = 0;
+    cfg.aai_live_upload = 1;
+    cfg.realtime_url[0] = '\0';
+    snprintf(cfg.spill_dir, sizeof(cfg.spill_dir), "/var/tmp");
+    cfg.preroll_ms = 0;
+    cfg.vad = 1;
+    cfg.hands_free = 0;
+    cfg.endpoint_ms = 800;
+    cfg.time_compress = 1.0;
+    cfg.vad_threshold_db = 10;
+    cfg.vad_max_pause_ms = 600;
+    cfg.capture_mmap = 0;
+    cfg.capture_sched = SCHED_OTHER;
+    cfg.capture_priority = 10;
+    snprintf(cfg.capture_source, sizeof(cfg.capture_source), "alsa");
+    snprintf(cfg.capture_device, sizeof(cfg.capture_device), "default");
+    cfg.capture_rate = 0;
 }
 
 /* Write content to a temp file, load it, then remove */
@@ -247,7 +272,181 @@ static void test_max_duration_clamped(void) {
     ASSERT(cfg.max_duration == 10, "max_duration clamped to 10 (lower bound)");
 
     load_from_string("max_duration = 999\n");
-    ASSERT(cfg.max_duration == 300, "max_duration clamped to 300 (upper bound)");
+    ASSERT(cfg.max_duration == 999, "max_duration above 300 allowed (spills to disk)");
+
+    load_from_string("max_duration = 1000000\n");
+    ASSERT(cfg.max_duration == STORE_MAX_SECONDS,
+           "max_duration clamped to STORE_MAX_SECONDS (upper bound)");
+}
+
+static void test_spill_dir(void) {
+    printf("test_spill_dir\n");
+    reset_cfg();
+    ASSERT(strcmp(cfg.spill_dir, "/var/tmp") == 0, "default spill_dir is /var/tmp");
+    load_from_string("spill_dir = /data/tmp\n");
+    ASSERT(strcmp(cfg.spill_dir, "/data/tmp") == 0, "spill_dir set");
+}
+
+static void test_capture_device_rate(void) {
+    printf("test_capture_device_rate\n");
+    reset_cfg();
+    ASSERT(strcmp(cfg.capture_device, "default") == 0, "default capture_device");
+    ASSERT(cfg.capture_rate == 0, "capture_rate defaults to auto");
+    load_from_string("capture_device = hw:1,0\ncapture_rate = 48000\n");
+    ASSERT(strcmp(cfg.capture_device, "hw:1,0") == 0, "capture_device set");
+    ASSERT(cfg.capture_rate == 48000, "capture_rate set");
+    load_from_string("capture_rate = 100\n");
+    ASSERT(cfg.capture_rate == 8000, "capture_rate clamped to 8000");
+    load_from_string("capture_rate = 384000\n");
+    ASSERT(cfg.capture_rate == 192000, "capture_rate clamped to 192000");
+}
+
+static void test_capture_source(void) {
+    printf("test_capture_source\n");
+    reset_cfg();
+    ASSERT(strcmp(cfg.capture_source, "alsa") == 0, "default capture_source is alsa");
+    load_from_string("capture_source = wav:/srv/bench/dictation.wav\n");
+    ASSERT(strcmp(cfg.capture_source, "wav:/srv/bench/dictation.wav") == 0,
+           "capture_source keeps the argument");
+}
+
+static void test_vad_options(void) {
+    printf("test_vad_options\n");
+    reset_cfg();
+    ASSERT(cfg.vad == 1, "vad on by default");
+    ASSERT(cfg.vad_threshold_db == 10, "default vad_threshold_db");
+    ASSERT(cfg.vad_max_pause_ms == 600, "default vad_max_pause_ms");
+    load_from_string("vad = false\nvad_threshold_db = 15\nvad_max_pause_ms = 1000\n");
+    ASSERT(cfg.vad == 0, "vad disabled");
+    ASSERT(cfg.vad_threshold_db == 15, "vad_threshold_db set");
+    ASSERT(cfg.vad_max_pause_ms == 1000, "vad_max_pause_ms set");
+    load_from_string("vad_threshold_db = 0\nvad_max_pause_ms = 10\n");
+    ASSERT(cfg.vad_threshold_db == 3, "vad_threshold_db clamped low");
+    ASSERT(cfg.vad_max_pause_ms == 2 * VAD_PAD_MS, "vad_max_pause_ms at least two pads");
+    load_from_string("vad_threshold_db = 90\nvad_max_pause_ms = 60000\n");
+    ASSERT(cfg.vad_threshold_db == 40, "vad_threshold_db clamped high");
+    ASSERT(cfg.vad_max_pause_ms == 10000, "vad_max_pause_ms clamped high");
+}
+
+static void test_time_compress(void) {
+    printf("test_time_compress\n");
+    reset_cfg();
+    ASSERT(cfg.time_compress == 1.0, "time_compress off by default");
+    load_from_string("time_compress = 1.25\n");
+    ASSERT(cfg.time_compress == 1.25, "time_compress set");
+    load_from_string("time_compress = 0.5\n");
+    ASSERT(cfg.time_compress == 1.0, "time_compress never slows down");
+    load_from_string("time_compress = 3\n");
+    ASSERT(cfg.time_compress == 2.0, "time_compress clamped to 2.0");
+}
+
+static void test_hands_free(void) {
+    printf("test_hands_free\n");
+    reset_cfg();
+    ASSERT(cfg.hands_free == 0, "hands_free off by default");
+    ASSERT(cfg.endpoint_ms == 800, "default endpoint_ms");
+    load_from_string("hands_free = true\nendpoint_ms = 1200\n");
+    ASSERT(cfg.hands_free == 1, "hands_free enabled");
+    ASSERT(cfg.endpoint_ms == 1200, "endpoint_ms set");
+    load_from_string("endpoint_ms = 50\n");
+    ASSERT(cfg.endpoint_ms == 300, "endpoint_ms clamped to 300");
+    load_from_string("endpoint_ms = 60000\n");
+    ASSERT(cfg.endpoint_ms == 5000, "endpoint_ms clamped to 5000");
+}
+
+static void test_upload_codecs(void) {
+    printf("test_upload_codecs\n");
+    reset_cfg();
+    ASSERT(cfg.groq_codec == CODEC_WAV && cfg.aai_codec == CODEC_WAV,
+           "uploads are WAV by default");
+    load_from_string("groq_codec = flac\naai_codec = wav\n");
+    ASSERT(cfg.groq_codec == CODEC_FLAC, "groq_codec set to flac");
+    ASSERT(cfg.aai_codec == CODEC_WAV, "aai_codec set to wav");
+    load_from_string("aai_codec = opus\n");
+#ifdef USE_OPUS
+    ASSERT(cfg.aai_codec == CODEC_OPUS, "aai_codec set to opus");
+#else
+    ASSERT(cfg.aai_codec == CODEC_FLAC, "opus without libopus falls back to flac");
+#endif
+    load_from_string("groq_codec = mp3\n");
+    ASSERT(cfg.groq_codec == CODEC_WAV, "unknown codec means wav");
+}
+
+static void test_upload_concurrency(void) {
+    printf("test_upload_concurrency\n");
+    reset_cfg();
+    ASSERT(cfg.upload_concurrency == 4, "default upload_concurrency");
+    load_from_string("upload_concurrency = 8\n");
+    ASSERT(cfg.upload_concurrency == 8, "upload_concurrency set");
+    load_from_string("upload_concurrency = 0\n");
+    ASSERT(cfg.upload_concurrency == 1, "upload_concurrency clamped to 1");
+    load_from_string("upload_concurrency = 100\n");
+    ASSERT(cfg.upload_concurrency == 16, "upload_concurrency clamped to 16");
+}
+
+static void test_hedge(void) {
+    printf("test_hedge\n");
+    reset_cfg();
+    ASSERT(cfg.hedge == 1, "hedge on by default");
+    ASSERT(cfg.hedge_after_ms == 0, "hedge delay adaptive by default");
+    load_from_string("hedge = false\nhedge_after_ms = 3000\n");
+    ASSERT(cfg.hedge == 0, "hedge disabled");
+    ASSERT(cfg.hedge_after_ms == 3000, "hedge_after_ms set");
+    load_from_string("hedge_after_ms = -5\n");
+    ASSERT(cfg.hedge_after_ms == 0, "hedge_after_ms clamped to 0");
+    load_from_string("hedge_after_ms = 999999\n");
+    ASSERT(cfg.hedge_after_ms == 120000, "hedge_after_ms clamped to 120000");
+}
+
+static void test_rpm(void) {
+    printf("test_rpm\n");
+    reset_cfg();
+    ASSERT(cfg.groq_rpm == 0 && cfg.aai_rpm == 0, "no client-side pacing by default");
+    load_from_string("groq_rpm = 20\naai_rpm = 300\n");
+    ASSERT(cfg.groq_rpm == 20, "groq_rpm set");
+    ASSERT(cfg.aai_rpm == 300, "aai_rpm set");
+    load_from_string("groq_rpm = -1\naai_rpm = 99999\n");
+    ASSERT(cfg.groq_rpm == 0, "groq_rpm clamped to 0");
+    ASSERT(cfg.aai_rpm == 10000, "aai_rpm clamped to 10000");
+}
+
+static void test_latency_slo(void) {
+    printf("test_latency_slo\n");
+    reset_cfg();
+    ASSERT(cfg.latency_slo_ms == 20000, "latency_slo_ms default 20000");
+    load_from_string("latency_slo_ms = 5000\n");
+    ASSERT(cfg.latency_slo_ms == 5000, "latency_slo_ms set");
+    load_from_string("latency_slo_ms = 10\n");
+    ASSERT(cfg.latency_slo_ms == 1000, "latency_slo_ms clamped to 1000");
+    load_from_string("latency_slo_ms = 9999999\n");
+    ASSERT(cfg.latency_slo_ms == 600000, "latency_slo_ms clamped to 600000");
+}
+
+static void test_stream_upload(void) {
+    printf("test_stream_upload\n");
+    reset_cfg();
+    ASSERT(cfg.stream_upload == 0, "stream_upload off by default");
+    load_from_string("stream_upload = true\n");
+    ASSERT(cfg.stream_upload == 1, "stream_upload enabled");
+    load_from_string("stream_upload = false\n");
+    ASSERT(cfg.stream_upload == 0, "stream_upload disabled");
+}
+
+static void test_aai_live_upload(void) {
+    printf("test_aai_live_upload\n");
+    reset_cfg();
+    ASSERT(cfg.aai_live_upload == 1, "aai_live_upload on by default");
+    load_from_string("aai_live_upload = false\n");
+    ASSERT(cfg.aai_live_upload == 0, "aai_live_upload disabled");
+}
+
+static void test_realtime_url(void) {
+    printf("test_realtime_url\n");
+    reset_cfg();
+    ASSERT(cfg.realtime_url[0] == '\0', "realtime off by default");
+    load_from_string("realtime_url = wss://example.com/v3/ws?sample_rate=16000&format_turns=true\n");
+    ASSERT(strcmp(cfg.realtime_url, "wss://example.com/v3/ws?sample_rate=16000&format_turns=true") == 0,
+           "URL with query kept whole");
 }
 
 static void test_groq_model_default(void) {
@@ -277,6 +476,49 @@ static void test_proxy_custom(void) {
            "proxy set to custom value");
 }
 
+static void test_preroll_default(void) {
+    printf("test_preroll_default\n");
+    reset_cfg();
+    ASSERT(cfg.preroll_ms == 0, "default preroll_ms is 0 (off)");
+}
+
+static void test_preroll_custom(void) {
+    printf("test_preroll_custom\n");
+    load_from_string("preroll_ms = 500\n");
+    ASSERT(cfg.preroll_ms == 500, "preroll_ms set to 500");
+}
+
+static void test_preroll_clamped(void) {
+    printf("test_preroll_clamped\n");
+    load_from_string("preroll_ms = -20\n");
+    ASSERT(cfg.preroll_ms == 0, "preroll_ms clamped to 0");
+
+    load_from_string("preroll_ms = 5000\n");
+    ASSERT(cfg.preroll_ms == PREROLL_MAX_MS, "preroll_ms clamped to PREROLL_MAX_MS");
+}
+
+static void test_capture_access(void) {
+    printf("test_capture_access\n");
+    reset_cfg();
+    ASSERT(cfg.capture_mmap == 0, "default capture_access is readi");
+    load_from_string("capture_access = mmap\n");
+    ASSERT(cfg.capture_mmap == 1, "capture_access = mmap");
+    load_from_string("capture_access = rw\n");
+    ASSERT(cfg.capture_mmap == 0, "capture_access = rw");
+}
+
+static void test_capture_sched(void) {
+    printf("test_capture_sched\n");
+    reset_cfg();
+    ASSERT(cfg.capture_sched == SCHED_OTHER, "default capture_sched is other");
+    load_from_string("capture_sched = fifo\ncapture_priority = 20\n");
+    ASSERT(cfg.capture_sched == SCHED_FIFO, "capture_sched = fifo");
+    ASSERT(cfg.capture_priority == 20, "capture_priority = 20");
+    load_from_string("capture_sched = rr\ncapture_priority = 500\n");
+    ASSERT(cfg.capture_sched == SCHED_RR, "capture_sched = rr");
+    ASSERT(cfg.capture_priority == 99, "capture_priority clamped to 99");
+}
+
 static void test_simple_speech2text_translate_paste_key(void) {
     printf("test_simple_speech2text_translate_paste_key\n");
     load_from_string("speech2text_translate_paste_key = F5\n");
@@ -331,10 +573,29 @@ int main(void) {
     test_max_duration_default();
     test_max_duration_custom();
     test_max_duration_clamped();
+    test_spill_dir();
+    test_capture_device_rate();
+    test_capture_source();
+    test_vad_options();
+    test_time_compress();
+    test_hands_free();
+    test_upload_codecs();
+    test_upload_concurrency();
+    test_hedge();
+    test_rpm();
+    test_latency_slo();
+    test_stream_upload();
+    test_aai_live_upload();
+    test_realtime_url();
     test_groq_model_default();
     test_groq_model_custom();
     test_proxy_default();
     test_proxy_custom();
+    test_preroll_default();
+    test_preroll_custom();
+    test_preroll_clamped();
+    test_capture_access();
+    test_capture_sched();
     test_simple_speech2text_translate_paste_key();
     test_speech2text_translate_paste_key_with_modifiers();
     test_all_three_keys();
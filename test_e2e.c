@@ -1,12 +1,16 @@
 /*
- * test_e2e — end-to-end integration test: mp3 → PCM → chunked WAV → AssemblyAI
+ * test_e2e — end-to-end integration test: mp3 → capture → chunked WAV → AssemblyAI
  *
- * Converts test.mp3 to raw PCM, runs it through the chunked transcription
+ * Decodes test.mp3 with ffmpeg, feeds the raw PCM through the capture
+ * thread (fd: source), runs it through the chunked transcription
  * pipeline, and compares the result against the reference text in test.txt.
  *
  * Requires: ffmpeg, ASSEMBLYAI key in .env, network access, test.mp3, test.txt
  * Build: make test_e2e
  * Run:   ./test_e2e       (NOT part of `make test` — use `make e2e`)
+ *        ./test_e2e --wsola 1,1.25,1.5
+ *                         (replay at each time_compress factor and compare
+ *                          upload size, latency and word match)
  */
 
 #include <stdio.h>
@@ -80,8 +84,10 @@ static char *load_text_file(const char *path) {
     return buf;
 }
 
-/* ── Load PCM from mp3 via ffmpeg ────────────────────────────────────── */
+/* ── Capture mp3 through the fd source ─────────────────────────────── */
 
+/* ffmpeg decodes to raw PCM on a pipe; the capture thread reads it via
+ * the fd: source exactly as it would a microphone, until EOF. */
 static size_t load_pcm_from_mp3(const char *mp3_path) {
     char cmd[512];
     snprintf(cmd, sizeof(cmd),
@@ -94,63 +100,56 @@ static size_t load_pcm_from_mp3(const char *mp3_path) {
         return 0;
     }
 
-    size_t total = 0;
-    size_t max_bytes = (size_t)BUF_SAMPLES * FRAME_SIZE;
-    uint8_t *buf = (uint8_t *)pcm_buf;
-
-    while (total < max_bytes) {
-        size_t n = fread(buf + total, 1, max_bytes - total, p);
-        if (n == 0) break;
-        total += n;
+    snprintf(cfg.capture_source, sizeof(cfg.capture_source), "fd:%d", fileno(p));
+    if (capture_init() < 0) {
+        pclose(p);
+        return 0;
     }
+    capture_arm();
+    while (capture_busy())
+        usleep(20 * 1000);
+    capture_disarm();
+    capture_shutdown();
     pclose(p);
 
-    size_t samples = total / FRAME_SIZE;
+    size_t samples = pcm_pos;
     printf("test_e2e: loaded %zu samples (%.1fs) from %s (max %ds)\n",
-           samples, (double)samples / SAMPLE_RATE, mp3_path, MAX_SECONDS);
+           samples, (double)samples / SAMPLE_RATE, mp3_path, cfg.max_duration);
     return samples;
 }
 
 /* ── Chunked transcription (mirrors handle_recording_done logic) ─────── */
 
+static size_t uploaded_bytes;   /* encoded bytes sent by the last call */
+
 static char *chunked_transcribe(size_t num_samples) {
-    static char result[16384];
-    result[0] = '\0';
-    size_t result_len = 0;
+    struct strbuf result = {0};
+    uploaded_bytes = 0;
 
-    size_t nchunks = (num_samples + CHUNK_SAMPLES - 1) / CHUNK_SAMPLES;
+    size_t *ends = malloc(chunk_count(num_samples) * sizeof(size_t));
+    if (!ends) return NULL;
+    size_t nchunks = chunk_plan(pcm_buf, num_samples, ends);
     printf("test_e2e: %zu chunk(s) to transcribe\n", nchunks);
 
     for (size_t i = 0; i < nchunks; i++) {
-        size_t offset = i * CHUNK_SAMPLES;
-        size_t chunk_samples = num_samples - offset;
-        if (chunk_samples > CHUNK_SAMPLES) chunk_samples = CHUNK_SAMPLES;
-
-        uint8_t *wav;
-        size_t wav_len = build_wav(pcm_buf + offset, chunk_samples, &wav);
-        if (!wav_len) {
-            fprintf(stderr, "test_e2e: build_wav failed for chunk %zu\n", i);
-            return NULL;
-        }
+        size_t offset = i ? ends[i - 1] : 0;
+        size_t chunk_samples = ends[i] - offset;
+
+        struct audio a;
+        audio_chunk(&a, pcm_buf, offset, chunk_samples, NULL);
 
         printf("test_e2e: chunk %zu/%zu (%.1fs)...",
                i + 1, nchunks, (double)chunk_samples / SAMPLE_RATE);
         fflush(stdout);
 
-        char *text = transcribe(wav, wav_len);
-        free(wav);
+        char *text = transcribe(&a);
+        for (int c = 0; c < CODEC_COUNT; c++)
+            uploaded_bytes += a.enc_len[c];
+        audio_free(&a);
 
         if (text && strlen(text) > 0) {
             printf(" %zu chars\n", strlen(text));
-            if (result_len > 0 && result_len + 1 < sizeof(result)) {
-                result[result_len++] = ' ';
-            }
-            size_t tlen = strlen(text);
-            if (result_len + tlen < sizeof(result)) {
-                memcpy(result + result_len, text, tlen);
-                result_len += tlen;
-                result[result_len] = '\0';
-            }
+            strbuf_append_words(&result, text);
             free(text);
         } else {
             printf(" (empty)\n");
@@ -158,12 +157,69 @@ static char *chunked_transcribe(size_t num_samples) {
         }
     }
 
-    return result;
+    free(ends);
+    return result.data ? result.data : strdup("");
+}
+
+/* ── WSOLA benchmark ─────────────────────────────────────────────────── */
+
+/* Percent of result words found in the reference and vice versa */
+static void word_match(const char *ref_text, const char *result,
+                       double *fwd_pct, double *rev_pct) {
+    static char ref_words[2048][64], res_words[2048][64];
+    int nref = tokenize(ref_text, ref_words, 2048);
+    int nres = tokenize(result, res_words, 2048);
+    int forward = count_word_matches(res_words, nres, ref_words, nref);
+    int reverse = count_word_matches(ref_words, nref, res_words, nres);
+    *fwd_pct = nres > 0 ? (double)forward / nres * 100.0 : 0;
+    *rev_pct = nref > 0 ? (double)reverse / nref * 100.0 : 0;
+}
+
+/* --wsola 1,1.25,1.5: transcribe the same capture at each time_compress
+ * factor and tabulate bytes sent, latency and word-match rate */
+static void wsola_bench(const char *ref_text, size_t samples, const char *factors) {
+    struct row { double factor, bytes, ms, fwd, rev; } rows[16];
+    int nrows = 0;
+    char list[256];
+    snprintf(list, sizeof(list), "%s", factors);
+    for (char *tok = strtok(list, ","); tok && nrows < 16; tok = strtok(NULL, ",")) {
+        struct row *r = &rows[nrows];
+        r->factor = atof(tok);
+        if (r->factor < 1.0) r->factor = 1.0;
+        cfg.time_compress = r->factor;
+        printf("\ntest_e2e: --- %.2fx ---\n", r->factor);
+
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        char *result = chunked_transcribe(samples);
+        r->ms = ms_since(&t0);
+        ASSERT(result != NULL, "transcription returned non-NULL");
+        if (!result) continue;
+        r->bytes = (double)uploaded_bytes;
+        word_match(ref_text, result, &r->fwd, &r->rev);
+        free(result);
+        nrows++;
+    }
+
+    printf("\ntest_e2e: WSOLA benchmark, %.1fs of audio\n", (double)samples / SAMPLE_RATE);
+    printf("  factor  uploaded    latency   result→ref  ref→result\n");
+    for (int i = 0; i < nrows; i++)
+        printf("  %5.2fx  %7.0f KB  %7.0f ms  %9.0f%%  %9.0f%%\n",
+               rows[i].factor, rows[i].bytes / 1024, rows[i].ms,
+               rows[i].fwd, rows[i].rev);
 }
 
 /* ── Main ───────────────────────────────────────────────────────────── */
 
-int main(void) {
+int main(int argc, char **argv) {
+    const char *wsola = NULL;
+    if (argc == 3 && strcmp(argv[1], "--wsola") == 0) {
+        wsola = argv[2];
+    } else if (argc != 1) {
+        fprintf(stderr, "usage: test_e2e [--wsola FACTOR[,FACTOR...]]\n");
+        return 1;
+    }
+
     /* Load reference text */
     char *ref_text = load_text_file("test.txt");
     if (!ref_text) {
@@ -180,14 +236,21 @@ int main(void) {
     load_config(); /* pick up proxy and other settings from /etc/dictator.conf */
     cfg.notify = 0; /* suppress desktop notifications */
     curl_global_init(CURL_GLOBAL_ALL);
+    pool_init();
+    char *result = NULL;
 
-    /* Convert mp3 → PCM (capped at BUF_SAMPLES) */
+    /* Convert mp3 → PCM (capped at max_duration) */
     size_t samples = load_pcm_from_mp3("test.mp3");
     ASSERT(samples > 0, "loaded PCM from mp3");
     if (samples == 0) goto done;
 
+    if (wsola) {
+        wsola_bench(ref_text, samples, wsola);
+        goto done;
+    }
+
     /* Transcribe via chunked pipeline */
-    char *result = chunked_transcribe(samples);
+    result = chunked_transcribe(samples);
     ASSERT(result != NULL, "transcription returned non-NULL");
     if (!result) goto done;
 
@@ -225,7 +288,9 @@ int main(void) {
            ">=95%% of reference words appear in transcription");
 
 done:
+    free(result);
     free(ref_text);
+    pool_shutdown();
     curl_global_cleanup();
     printf("\n%d tests, %d failed\n", tests_run, tests_failed);
     return tests_failed ? 1 : 0;
@@ -0,0 +1,1222 @@
+/*
+ * test_net — backend protocol tests against an in-process stub server
+ * Build: make test_net
+ * Run:   ./test_net
+ *
+ * A small HTTP/1.1 server on 127.0.0.1 (keep-alive, Content-Length and
+ * chunked bodies) runs in a thread; host_base is pointed at it and each
+ * test installs a handler that scripts the responses. Nothing leaves the
+ * machine. The same server answers WebSocket upgrades as a stand-in for
+ * the AssemblyAI v3 streaming API.
+ *
+ * ./test_net serve [PORT] runs only the stand-in, for trying dictator
+ * offline: realtime_url = ws://127.0.0.1:PORT/v3/ws
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define main dictator_main
+#include "dictator.c"
+#undef main
+
+static int tests_run, tests_failed;
+
+#define ASSERT(cond, msg) do { \
+    tests_run++; \
+    if (!(cond)) { \
+        fprintf(stderr, "  FAIL: %s (line %d)\n", msg, __LINE__); \
+        tests_failed++; \
+    } \
+} while (0)
+
+/* ── Stub HTTP server ────────────────────────────────────────────────── */
+
+struct stub_req {
+    char    method[8];
+    char    path[256];
+    char    headers[4096];   /* raw header block, names lowercased */
+    char   *body;
+    size_t  body_len;
+    int     chunked;
+};
+
+struct stub_resp {
+    int         status;
+    char        body[4096];
+    char        headers[512];   /* extra header lines, each ending in \r\n */
+    int         delay_ms;       /* before answering */
+};
+
+static struct {
+    int           fd;
+    int           port;
+    pthread_t     tid;
+    atomic_int    connections;
+    atomic_int    requests;
+    void        (*handler)(const struct stub_req *, struct stub_resp *);
+    char          base[64];
+} stub;
+
+static int read_line(FILE *f, char *buf, size_t cap) {
+    if (!fgets(buf, (int)cap, f)) return -1;
+    size_t n = strlen(buf);
+    while (n && (buf[n - 1] == '\n' || buf[n - 1] == '\r')) buf[--n] = '\0';
+    return (int)n;
+}
+
+static int read_body(FILE *f, struct stub_req *rq) {
+    const char *cl = strstr(rq->headers, "content-length:");
+    rq->chunked = strstr(rq->headers, "transfer-encoding: chunked") != NULL;
+    size_t cap = 0;
+    if (!rq->chunked) {
+        rq->body_len = cl ? strtoul(cl + 15, NULL, 10) : 0;
+        rq->body = malloc(rq->body_len + 1);
+        if (!rq->body || fread(rq->body, 1, rq->body_len, f) != rq->body_len) return -1;
+        rq->body[rq->body_len] = '\0';
+        return 0;
+    }
+    char line[64];
+    for (;;) {
+        if (read_line(f, line, sizeof(line)) < 0) return -1;
+        size_t n = strtoul(line, NULL, 16);
+        if (n == 0) { read_line(f, line, sizeof(line)); break; }
+        if (rq->body_len + n + 1 > cap) {
+            cap = (rq->body_len + n + 1) * 2;
+            char *tmp = realloc(rq->body, cap);
+            if (!tmp) return -1;
+            rq->body = tmp;
+        }
+        if (fread(rq->body + rq->body_len, 1, n, f) != n) return -1;
+        rq->body_len += n;
+        read_line(f, line, sizeof(line));
+    }
+    if (!rq->body && !(rq->body = malloc(1))) return -1;
+    rq->body[rq->body_len] = '\0';
+    return 0;
+}
+
+/* ── WebSocket stand-in ──────────────────────────────────────────────── */
+
+/*
+ * Speaks the v3 streaming protocol: every 2 s of audio is one turn,
+ * "turnK", sent as a partial after the first second and as a final at
+ * the end. Terminate finishes the open turn and answers Termination.
+ * The Begin message arrives fragmented with a ping in between.
+ * ws_stub.drop_after_ms hangs up without a word after that much audio;
+ * ws_stub.huge opens with a frame claiming a terabyte instead;
+ * ws_stub.mute never answers Terminate.
+ */
+
+#define TURN_BYTES (2 * SAMPLE_RATE * FRAME_SIZE)
+
+static struct {
+    int        drop_after_ms;
+    int        refuse;
+    int        huge;
+    int        mute;
+    atomic_int audio_bytes;
+} ws_stub;
+
+static int stub_ws_frame(int fd, int op, int fin, const char *data, size_t len) {
+    uint8_t h[4] = { (uint8_t)((fin ? 0x80 : 0) | op) };
+    size_t hl = 2;
+    if (len < 126) {
+        h[1] = (uint8_t)len;
+    } else {
+        h[1] = 126;
+        h[2] = (uint8_t)(len >> 8);
+        h[3] = (uint8_t)len;
+        hl = 4;
+    }
+    return write(fd, h, hl) == (ssize_t)hl && write(fd, data, len) == (ssize_t)len ? 0 : -1;
+}
+
+static int stub_ws_text(int fd, const char *fmt, int a, int b) {
+    char msg[256];
+    int n = snprintf(msg, sizeof(msg), fmt, a, b);
+    return stub_ws_frame(fd, WS_OP_TEXT, 1, msg, (size_t)n);
+}
+
+static void stub_ws_session(FILE *in, int fd) {
+    static const char begin[] = "{\"type\": \"Begin\", \"id\": \"s1\"}";
+    if (ws_stub.huge) {
+        static const uint8_t tera[] = { 0x81, 127, 0, 0, 1, 0, 0, 0, 0, 0, 'x' };
+        if (write(fd, tera, sizeof(tera))) { /* the client hangs up */ }
+        char sink[256];
+        while (fread(sink, 1, sizeof(sink), in) > 0) {}
+        return;
+    }
+    stub_ws_frame(fd, WS_OP_TEXT, 0, begin, 10);
+    stub_ws_frame(fd, WS_OP_PING, 1, "hi", 2);
+    stub_ws_frame(fd, WS_OP_CONT, 1, begin + 10, sizeof(begin) - 11);
+    int bytes = 0, turn = 0, partial_sent = 0;
+    for (;;) {
+        uint8_t h[14];
+        if (fread(h, 1, 2, in) != 2) return;
+        int op = h[0] & 0x0F;
+        size_t len = h[1] & 0x7F;
+        if (len == 126) {
+            if (fread(h + 2, 1, 2, in) != 2) return;
+            len = (size_t)h[2] << 8 | h[3];
+        } else if (len == 127) {
+            if (fread(h + 2, 1, 8, in) != 8) return;
+            len = 0;
+            for (int i = 0; i < 8; i++) len = len << 8 | h[2 + i];
+        }
+        uint8_t mask[4];
+        if (!(h[1] & 0x80) || fread(mask, 1, 4, in) != 4) return;   /* clients must mask */
+        char *p = malloc(len + 1);
+        if (!p || fread(p, 1, len, in) != len) { free(p); return; }
+        for (size_t i = 0; i < len; i++) p[i] ^= mask[i & 3];
+        p[len] = '\0';
+        if (op == WS_OP_BINARY) {
+            bytes += (int)len;
+            atomic_store(&ws_stub.audio_bytes, bytes);
+            if (ws_stub.drop_after_ms &&
+                bytes >= ws_stub.drop_after_ms * SAMPLE_RATE / 1000 * FRAME_SIZE) {
+                free(p);
+                return;
+            }
+            while (bytes >= (turn + 1) * TURN_BYTES) {
+                stub_ws_text(fd, "{\"type\": \"Turn\", \"turn_order\": %d, \"end_of_turn\": true, "
+                             "\"transcript\": \"turn%d\"}", turn, turn);
+                turn++;
+                partial_sent = 0;
+            }
+            if (!partial_sent && bytes >= turn * TURN_BYTES + TURN_BYTES / 2) {
+                stub_ws_text(fd, "{\"type\": \"Turn\", \"turn_order\": %d, \"end_of_turn\": false, "
+                             "\"transcript\": \"tu%d\"}", turn, turn);
+                partial_sent = 1;
+            }
+        } else if (op == WS_OP_TEXT && strstr(p, "Terminate") && !ws_stub.mute) {
+            if (bytes > turn * TURN_BYTES)
+                stub_ws_text(fd, "{\"type\": \"Turn\", \"turn_order\": %d, \"end_of_turn\": true, "
+                             "\"transcript\": \"turn%d\"}", turn, turn);
+            stub_ws_text(fd, "{\"type\": \"Termination\", \"audio_duration_seconds\": %d, "
+                         "\"turns\": %d}", bytes / (SAMPLE_RATE * FRAME_SIZE), turn + 1);
+        } else if (op == WS_OP_CLOSE) {
+            stub_ws_frame(fd, WS_OP_CLOSE, 1, p, len < 2 ? len : 2);
+            free(p);
+            return;
+        }
+        free(p);
+    }
+}
+
+/* Answer an upgrade request; returns 0 if the socket now speaks WebSocket */
+static int stub_ws_upgrade(const struct stub_req *rq, int fd) {
+    const char *k = strstr(rq->headers, "sec-websocket-key:");
+    char key[64] = "", accept_key[29], head[256];
+    if (k) sscanf(k + 18, " %63s", key);
+    if (ws_stub.refuse || !key[0]) {
+        static const char no[] = "HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\n\r\n";
+        if (write(fd, no, sizeof(no) - 1)) { /* closing anyway */ }
+        return -1;
+    }
+    ws_accept_key(key, accept_key);
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 101 Switching Protocols\r\n"
+                     "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                     "Sec-WebSocket-Accept: %s\r\n\r\n", accept_key);
+    return write(fd, head, (size_t)n) == n ? 0 : -1;
+}
+
+static void *stub_conn(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    FILE *in = fdopen(fd, "r");
+    if (!in) { close(fd); return NULL; }
+    char line[1024];
+    while (read_line(in, line, sizeof(line)) > 0) {
+        struct stub_req rq = {0};
+        sscanf(line, "%7s %255s", rq.method, rq.path);
+        size_t hl = 0;
+        int n;
+        while ((n = read_line(in, line, sizeof(line))) > 0) {
+            for (char *c = line; *c && *c != ':'; c++) *c = (char)tolower((unsigned char)*c);
+            hl += snprintf(rq.headers + hl, sizeof(rq.headers) - hl, "%s\n", line);
+            if (hl >= sizeof(rq.headers)) hl = sizeof(rq.headers) - 1;
+        }
+        if (n < 0 || read_body(in, &rq) < 0) { free(rq.body); break; }
+        atomic_fetch_add(&stub.requests, 1);
+        if (strstr(rq.headers, "upgrade: websocket")) {
+            free(rq.body);
+            if (stub_ws_upgrade(&rq, fd) == 0) stub_ws_session(in, fd);
+            break;
+        }
+
+        struct stub_resp rs = { .status = 200 };
+        if (stub.handler) stub.handler(&rq, &rs);
+        free(rq.body);
+        if (rs.delay_ms) usleep((useconds_t)rs.delay_ms * 1000);
+        char head[1024];
+        int hn = snprintf(head, sizeof(head),
+                          "HTTP/1.1 %d X\r\nContent-Type: application/json\r\n"
+                          "Content-Length: %zu\r\n%s\r\n",
+                          rs.status, strlen(rs.body), rs.headers);
+        if (write(fd, head, (size_t)hn) != hn) break;
+        if (write(fd, rs.body, strlen(rs.body)) != (ssize_t)strlen(rs.body)) break;
+    }
+    fclose(in);
+    return NULL;
+}
+
+static void *stub_accept(void *arg) {
+    (void)arg;
+    for (;;) {
+        int c = accept(stub.fd, NULL, NULL);
+        if (c < 0) break;
+        atomic_fetch_add(&stub.connections, 1);
+        pthread_t t;
+        if (pthread_create(&t, NULL, stub_conn, (void *)(intptr_t)c) == 0)
+            pthread_detach(t);
+        else
+            close(c);
+    }
+    return NULL;
+}
+
+static int stub_start(int port) {
+    stub.fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(stub.fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port) };
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t sl = sizeof(sa);
+    if (stub.fd < 0 || bind(stub.fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+        listen(stub.fd, 16) < 0 || getsockname(stub.fd, (struct sockaddr *)&sa, &sl) < 0)
+        return -1;
+    stub.port = ntohs(sa.sin_port);
+    snprintf(stub.base, sizeof(stub.base), "http://127.0.0.1:%d/", stub.port);
+    for (int h = 0; h < HOST_COUNT; h++) host_base[h] = stub.base;
+    return pthread_create(&stub.tid, NULL, stub_accept, NULL);
+}
+
+/* New scripted server behaviour; idle pooled connections are dropped so
+ * connection counts start from zero */
+static void stub_reset(void (*handler)(const struct stub_req *, struct stub_resp *)) {
+    pool_shutdown();
+    pool_init();
+    stub.handler = handler;
+    stub.connections = 0;
+    stub.requests = 0;
+}
+
+/* ── Test audio ──────────────────────────────────────────────────────── */
+
+static int16_t *make_audio(struct audio *a, double seconds) {
+    size_t n = (size_t)(seconds * SAMPLE_RATE);
+    int16_t *pcm = calloc(n, sizeof(int16_t));
+    *a = (struct audio){ .pcm = pcm, .n = n };
+    return pcm;
+}
+
+/* ── AssemblyAI job polling ──────────────────────────────────────────── */
+
+/* Scripted AssemblyAI: the job completes job_ms after submit */
+static struct {
+    int             job_ms;
+    int             fail;
+    struct timespec submitted;
+    atomic_int      polls;
+} aai_stub;
+
+static void aai_handler(const struct stub_req *rq, struct stub_resp *rs) {
+    if (strcmp(rq->path, "/v2/upload") == 0) {
+        snprintf(rs->body, sizeof(rs->body), "{\"upload_url\": \"https://cdn/u1\"}");
+    } else if (strcmp(rq->path, "/v2/transcript") == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &aai_stub.submitted);
+        snprintf(rs->body, sizeof(rs->body), "{\"id\": \"t1\", \"status\": \"queued\"}");
+    } else if (strcmp(rq->path, "/v2/transcript/t1") == 0) {
+        atomic_fetch_add(&aai_stub.polls, 1);
+        if (aai_stub.fail)
+            snprintf(rs->body, sizeof(rs->body),
+                     "{\"status\": \"error\", \"error\": \"bad audio\"}");
+        else if (ms_since(&aai_stub.submitted) >= aai_stub.job_ms)
+            snprintf(rs->body, sizeof(rs->body),
+                     "{\"status\": \"completed\", \"text\": \"hello world \"}");
+        else
+            snprintf(rs->body, sizeof(rs->body), "{\"status\": \"processing\"}");
+    } else {
+        rs->status = 404;
+    }
+}
+
+static void test_aai_poll_schedule(void) {
+    printf("test_aai_poll_schedule\n");
+    aai_jobs.ms_per_s = AAI_JOB_PRIOR_MS;
+    aai_jobs.observed = 0;
+    ASSERT(aai_first_poll_ms(3) < 1000, "short clip: first poll well under a second");
+    ASSERT(aai_first_poll_ms(0) >= AAI_POLL_MIN_MS, "first poll never below the floor");
+    ASSERT(aai_first_poll_ms(120) > aai_first_poll_ms(3), "longer audio, later first poll");
+    ASSERT(aai_poll_step_ms(3600) == AAI_POLL_MAX_MS, "step capped");
+    ASSERT(aai_deadline_ms(600) > aai_deadline_ms(5) + 500000, "deadline grows with audio");
+
+    double before = aai_expected_ms(3);
+    aai_job_observed(3, 4000);
+    ASSERT(fabs(aai_expected_ms(3) - 4000) < 1, "first observation replaces the prior");
+    aai_job_observed(3, 400);
+    ASSERT(aai_expected_ms(3) < 4000 && aai_expected_ms(3) > 400,
+           "later observations are averaged in");
+    aai_jobs.ms_per_s = AAI_JOB_PRIOR_MS;
+    aai_jobs.observed = 0;
+    ASSERT(aai_expected_ms(3) == before, "reset");
+}
+
+/* Hedges record job times from their own threads */
+static void *observe_jobs(void *arg) {
+    (void)arg;
+    for (int i = 0; i < 20000; i++) {
+        aai_job_observed(3, 400);
+        (void)aai_expected_ms(3);
+    }
+    return NULL;
+}
+
+static void test_aai_jobs_concurrent(void) {
+    printf("test_aai_jobs_concurrent\n");
+    aai_jobs.ms_per_s = AAI_JOB_PRIOR_MS;
+    aai_jobs.observed = 0;
+    pthread_t t[4];
+    for (int i = 0; i < 4; i++) pthread_create(&t[i], NULL, observe_jobs, NULL);
+    for (int i = 0; i < 4; i++) pthread_join(t[i], NULL);
+    ASSERT(aai_jobs.observed == 80000, "no observation lost between threads");
+    ASSERT(fabs(aai_expected_ms(3) - 400) < 1, "estimate stays coherent");
+    aai_jobs.ms_per_s = AAI_JOB_PRIOR_MS;
+    aai_jobs.observed = 0;
+}
+
+static void test_aai_fast_job(void) {
+    printf("test_aai_fast_job\n");
+    stub_reset(aai_handler);
+    aai_stub.job_ms = 300;
+    aai_stub.fail = 0;
+    aai_stub.polls = 0;
+    struct audio a;
+    int16_t *pcm = make_audio(&a, 3);
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    char *text = transcribe_aai(&a);
+    double ms = ms_since(&t0);
+    ASSERT(text && strcmp(text, "hello world") == 0, "transcript returned");
+    ASSERT(ms < 900, "300 ms job answered without a whole-second sleep");
+    ASSERT(aai_stub.polls <= 3, "few polls");
+    ASSERT(stub.connections == 1, "upload, submit and polls share one connection");
+    ASSERT(aai_jobs.observed == 1, "job time recorded");
+    free(text);
+    audio_free(&a);
+    free(pcm);
+}
+
+static void test_aai_slow_job_backs_off(void) {
+    printf("test_aai_slow_job_backs_off\n");
+    stub_reset(aai_handler);
+    aai_jobs.ms_per_s = AAI_JOB_PRIOR_MS;
+    aai_jobs.observed = 0;
+    aai_stub.job_ms = 2500;
+    aai_stub.polls = 0;
+    struct audio a;
+    int16_t *pcm = make_audio(&a, 2);
+    char *text = transcribe_aai(&a);
+    ASSERT(text != NULL, "slow job still completes");
+    ASSERT(aai_stub.polls >= 3 && aai_stub.polls <= 8, "backoff keeps polls bounded");
+    ASSERT(aai_expected_ms(2) > 1000, "expectation learns the slower service");
+    free(text);
+    audio_free(&a);
+    free(pcm);
+    aai_jobs.ms_per_s = AAI_JOB_PRIOR_MS;
+    aai_jobs.observed = 0;
+}
+
+static void test_aai_job_error(void) {
+    printf("test_aai_job_error\n");
+    stub_reset(aai_handler);
+    aai_stub.fail = 1;
+    aai_stub.polls = 0;
+    struct audio a;
+    int16_t *pcm = make_audio(&a, 1);
+    char *text = transcribe_aai(&a);
+    ASSERT(text == NULL, "job error gives no text");
+    ASSERT(aai_stub.polls == 1, "error ends polling at once");
+    aai_stub.fail = 0;
+    audio_free(&a);
+    free(pcm);
+}
+
+/* The request body, binary parts and all, contains s */
+static int body_has(const struct stub_req *rq, const char *s) {
+    size_t n = strlen(s);
+    for (size_t i = 0; rq->body && i + n <= rq->body_len; i++)
+        if (memcmp(rq->body + i, s, n) == 0) return 1;
+    return 0;
+}
+
+/* Groq asked for word timestamps answers with them */
+static atomic_int groq_timed;
+
+static void timed_handler(const struct stub_req *rq, struct stub_resp *rs) {
+    if (strncmp(rq->path, "/openai/", 8) != 0) {
+        aai_handler(rq, rs);
+        return;
+    }
+    int timed = body_has(rq, "verbose_json") && body_has(rq, "timestamp_granularities[]");
+    atomic_store(&groq_timed, timed);
+    snprintf(rs->body, sizeof(rs->body), timed
+             ? "{\"text\": \" hi there\", \"words\": [{\"word\": \"hi\", \"start\": 0.1, "
+               "\"end\": 0.3}, {\"word\": \"there\", \"start\": 0.4, \"end\": 0.8}]}"
+             : "groq text\n");
+}
+
+static void test_timed_chunk(void) {
+    printf("test_timed_chunk\n");
+    stub_reset(timed_handler);
+    aai_stub.job_ms = 0;
+    aai_stub.fail = 0;
+    struct audio a;
+    int16_t *pcm = make_audio(&a, 1);
+    char *text = transcribe_groq(&a);
+    ASSERT(!groq_timed && text && strcmp(text, "groq text") == 0, "plain text by default");
+    free(text);
+
+    a.timed = 1;
+    text = transcribe_groq(&a);
+    struct word_list w = {0};
+    ASSERT(groq_timed, "Groq asked for word timestamps");
+    ASSERT(text && word_list_parse(text, &w) == 0 && w.n == 2, "words returned");
+    word_list_free(&w);
+    free(text);
+
+    text = transcribe_aai(&a);
+    ASSERT(text && strstr(text, "\"status\": \"completed\""), "AssemblyAI transcript JSON returned");
+    struct chunk_merge m = {0};
+    struct strbuf sb = {0};
+    chunk_merge_add(&m, &sb, text, 1, 1, 0);
+    chunk_merge_end(&m, &sb);
+    ASSERT(sb.data && strcmp(sb.data, "hello world") == 0, "its text used without words");
+    strbuf_free(&sb);
+    free(text);
+    audio_free(&a);
+    free(pcm);
+}
+
+/* ── Hedged chunk upload ─────────────────────────────────────────────── */
+
+/* Groq answers after groq_ms; AssemblyAI as scripted in aai_stub */
+static int groq_ms;
+
+static void hedge_handler(const struct stub_req *rq, struct stub_resp *rs) {
+    if (strncmp(rq->path, "/openai/", 8) == 0) {
+        rs->delay_ms = groq_ms;
+        snprintf(rs->body, sizeof(rs->body), "groq text\n");
+    } else {
+        aai_handler(rq, rs);
+    }
+}
+
+static void reset_hedges(void) {
+    memset(&hedges, 0, sizeof(hedges));
+}
+
+/* One chunk through the uploader; the text, and the time until the
+ * uploader is freed (the loser cancelled) in *ms */
+static char *run_hedged(struct uploader *u, double *ms) {
+    have_groq = have_aai = 1;
+    struct audio a;
+    int16_t *pcm = make_audio(&a, 3);
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uploader_init(u, ACT_COPY);
+    uploader_add(u, &a);
+    uploader_wait(u);
+    struct strbuf sb = {0};
+    uploader_collect(u, &sb);
+    int hedged = u->hedged, won = u->hedge_won;
+    uploader_free(u);
+    u->hedged = hedged;
+    u->hedge_won = won;
+    *ms = ms_since(&t0);
+    free(pcm);
+    have_groq = have_aai = 0;
+    return sb.data;
+}
+
+static void test_hedge_delay(void) {
+    printf("test_hedge_delay\n");
+    reset_hedges();
+    cfg.hedge_after_ms = 0;
+    ASSERT(hedge_after_ms(3) == HEDGE_PRIOR_MS, "prior until Groq has been timed");
+    for (int i = 0; i < 19; i++) groq_latency_observed(9, 1000);
+    groq_latency_observed(9, 8000);
+    ASSERT(fabs(hedge_after_ms(9) - 1000) < 1, "p95 ignores a single outlier");
+    ASSERT(hedge_after_ms(29) > hedge_after_ms(9), "longer chunk, later hedge");
+    ASSERT(hedge_after_ms(0) >= HEDGE_MIN_MS, "never below the floor");
+    cfg.hedge_after_ms = 250;
+    ASSERT(hedge_after_ms(9) == 250, "configured delay wins");
+    cfg.hedge_after_ms = 0;
+    reset_hedges();
+}
+
+static void test_hedge_wins_over_slow_groq(void) {
+    printf("test_hedge_wins_over_slow_groq\n");
+    stub_reset(hedge_handler);
+    reset_hedges();
+    cfg.hedge_after_ms = 200;
+    groq_ms = 4000;
+    aai_stub.job_ms = 100;
+    aai_stub.fail = 0;
+    struct uploader u;
+    double ms;
+    char *text = run_hedged(&u, &ms);
+    ASSERT(text && strcmp(text, "hello world") == 0, "AssemblyAI text used");
+    ASSERT(ms < 2000, "slow Groq call did not hold the session");
+    ASSERT(u.hedged == 1 && u.hedge_won == 1, "hedge fired and won");
+    ASSERT(hedges.fired == 1 && hedges.won == 1, "counted since start");
+    free(text);
+    cfg.hedge_after_ms = 0;
+}
+
+static void test_hedge_cancelled_when_groq_answers(void) {
+    printf("test_hedge_cancelled_when_groq_answers\n");
+    stub_reset(hedge_handler);
+    reset_hedges();
+    cfg.hedge_after_ms = 100;
+    groq_ms = 500;
+    aai_stub.job_ms = 10000;
+    struct uploader u;
+    double ms;
+    char *text = run_hedged(&u, &ms);
+    ASSERT(text && strcmp(text, "groq text") == 0, "Groq text used");
+    ASSERT(u.hedged == 1 && u.hedge_won == 0, "hedge fired and lost");
+    ASSERT(ms < 1500, "losing hedge cancelled promptly");
+    ASSERT(hedges.n == 1, "Groq latency recorded");
+    free(text);
+    cfg.hedge_after_ms = 0;
+    reset_hedges();
+}
+
+static void test_hedge_not_fired_for_fast_groq(void) {
+    printf("test_hedge_not_fired_for_fast_groq\n");
+    stub_reset(hedge_handler);
+    reset_hedges();
+    groq_ms = 0;
+    aai_stub.polls = 0;
+    struct uploader u;
+    double ms;
+    char *text = run_hedged(&u, &ms);
+    ASSERT(text && strcmp(text, "groq text") == 0, "Groq text used");
+    ASSERT(u.hedged == 0 && aai_stub.polls == 0, "AssemblyAI left alone");
+    free(text);
+    reset_hedges();
+}
+
+/* ── Circuit breaker ─────────────────────────────────────────────────── */
+
+static void reset_breakers(void) {
+    memset(breakers, 0, sizeof(breakers));
+}
+
+/* Pretend the cooldown of h has passed */
+static void breaker_expire(enum api_host h) {
+    breakers[h].since.tv_sec -= (time_t)(BREAKER_COOLDOWN_MAX_MS / 1000) + 1;
+}
+
+static void test_breaker_states(void) {
+    printf("test_breaker_states\n");
+    reset_breakers();
+    for (int i = 0; i < 6; i++) breaker_record(HOST_GROQ, 0, 500, 3);
+    breaker_record(HOST_GROQ, 1, 0, 3);
+    ASSERT(breakers[HOST_GROQ].state == BREAKER_CLOSED, "one failure keeps it closed");
+    breaker_record(HOST_GROQ, 0, 20000, 3);
+    breaker_record(HOST_GROQ, 1, 0, 3);
+    breaker_record(HOST_GROQ, 1, 0, 3);
+    breaker_record(HOST_GROQ, 1, 0, 3);
+    ASSERT(breakers[HOST_GROQ].state == BREAKER_OPEN, "half the window bad: open");
+    ASSERT(!breaker_allow(HOST_GROQ), "open circuit refuses calls");
+    ASSERT(breaker_allow(HOST_AAI), "the other backend is unaffected");
+
+    breaker_expire(HOST_GROQ);
+    ASSERT(breaker_allow(HOST_GROQ), "after the cooldown one probe goes through");
+    ASSERT(breakers[HOST_GROQ].state == BREAKER_HALF_OPEN, "half-open");
+    ASSERT(!breaker_allow(HOST_GROQ) && breaker_probing(HOST_GROQ), "only one probe");
+    breaker_record(HOST_GROQ, 1, 0, 3);
+    ASSERT(breakers[HOST_GROQ].state == BREAKER_OPEN, "failed probe reopens");
+    ASSERT(breakers[HOST_GROQ].cooldown_ms == 2 * BREAKER_COOLDOWN_MS, "for twice as long");
+
+    breaker_expire(HOST_GROQ);
+    ASSERT(breaker_allow(HOST_GROQ), "second probe");
+    breaker_record(HOST_GROQ, 0, 400, 3);
+    ASSERT(breakers[HOST_GROQ].state == BREAKER_CLOSED, "good probe closes");
+    ASSERT(breakers[HOST_GROQ].cooldown_ms == BREAKER_COOLDOWN_MS, "cooldown reset");
+    breaker_record(HOST_GROQ, 1, 0, 3);
+    ASSERT(breakers[HOST_GROQ].state == BREAKER_CLOSED, "window starts fresh");
+    reset_breakers();
+}
+
+/* Groq down with 503s, AssemblyAI fine */
+static atomic_int groq_calls;
+
+static void groq_down_handler(const struct stub_req *rq, struct stub_resp *rs) {
+    if (strncmp(rq->path, "/openai/", 8) == 0) {
+        atomic_fetch_add(&groq_calls, 1);
+        rs->status = 503;
+        snprintf(rs->body, sizeof(rs->body), "{\"error\": \"overloaded\"}");
+    } else {
+        aai_handler(rq, rs);
+    }
+}
+
+static void test_breaker_skips_failing_groq(void) {
+    printf("test_breaker_skips_failing_groq\n");
+    stub_reset(groq_down_handler);
+    reset_breakers();
+    groq_calls = 0;
+    aai_stub.job_ms = 0;
+    aai_stub.fail = 0;
+    have_groq = have_aai = 1;
+    struct audio a;
+    int16_t *pcm = make_audio(&a, 1);
+    int texts = 0;
+    for (int i = 0; i < 6; i++) {
+        char *text = transcribe(&a);
+        texts += text && strcmp(text, "hello world") == 0;
+        free(text);
+    }
+    ASSERT(texts == 6, "every press still transcribed");
+    ASSERT(groq_calls == BREAKER_MIN_CALLS * (API_RETRIES + 1),
+           "Groq skipped once its circuit opened");
+
+    /* the uploader sends the chunk straight to AssemblyAI too */
+    struct uploader u;
+    uploader_init(&u, ACT_COPY);
+    uploader_add(&u, &a);
+    uploader_wait(&u);
+    struct strbuf sb = {0};
+    uploader_collect(&u, &sb);
+    uploader_free(&u);
+    ASSERT(sb.data && strcmp(sb.data, "hello world") == 0, "chunk transcribed");
+    ASSERT(groq_calls == BREAKER_MIN_CALLS * (API_RETRIES + 1), "uploader skipped Groq");
+    strbuf_free(&sb);
+
+    /* recovered: the probe closes the circuit */
+    stub.handler = hedge_handler;
+    groq_ms = 0;
+    breaker_expire(HOST_GROQ);
+    char *text = transcribe(&a);
+    ASSERT(text && strcmp(text, "groq text") == 0, "probe answered by Groq");
+    ASSERT(breakers[HOST_GROQ].state == BREAKER_CLOSED, "circuit closed again");
+    free(text);
+
+    have_groq = have_aai = 0;
+    audio_free(&a);
+    free(pcm);
+    reset_breakers();
+}
+
+/* ── Rate limits and retries ─────────────────────────────────────────── */
+
+/* Scripted Groq: the k-th request gets status[k] and headers[k] (200 once
+ * the script runs out); AssemblyAI submits get submit_status */
+static struct {
+    int             status[8];
+    const char     *headers[8];
+    int             n;
+    int             submit_status;
+    atomic_int      calls, submits;
+    double          at[8];        /* ms since t0 of each Groq request */
+    struct timespec t0;
+} script;
+
+static void script_handler(const struct stub_req *rq, struct stub_resp *rs) {
+    if (strncmp(rq->path, "/openai/", 8) == 0) {
+        int k = atomic_fetch_add(&script.calls, 1);
+        if (k < 8) script.at[k] = ms_since(&script.t0);
+        if (k < script.n) {
+            rs->status = script.status[k];
+            snprintf(rs->headers, sizeof(rs->headers), "%s", script.headers[k] ? script.headers[k] : "");
+        }
+        snprintf(rs->body, sizeof(rs->body), rs->status == 200 ? "groq text\n" : "{\"error\": \"x\"}");
+    } else if (strcmp(rq->path, "/v2/transcript") == 0 && script.submit_status) {
+        atomic_fetch_add(&script.submits, 1);
+        rs->status = script.submit_status;
+        snprintf(rs->headers, sizeof(rs->headers), "%s",
+                 script.headers[0] ? script.headers[0] : "");
+    } else {
+        if (strcmp(rq->path, "/v2/transcript") == 0) atomic_fetch_add(&script.submits, 1);
+        aai_handler(rq, rs);
+    }
+}
+
+static void script_reset(void) {
+    stub_reset(script_handler);
+    memset(&script, 0, sizeof(script));
+    memset(buckets, 0, sizeof(buckets));
+    reset_breakers();
+    clock_gettime(CLOCK_MONOTONIC, &script.t0);
+}
+
+static void test_parse_duration(void) {
+    printf("test_parse_duration\n");
+    ASSERT(fabs(parse_duration_ms("2m59.56s") - 179560) < 0.01, "minutes and seconds");
+    ASSERT(fabs(parse_duration_ms("7.66s") - 7660) < 0.01, "fractional seconds");
+    ASSERT(parse_duration_ms("250ms") == 250, "milliseconds");
+    ASSERT(parse_duration_ms("1h") == 3.6e6, "hours");
+    ASSERT(parse_duration_ms("3") == 3000, "bare seconds");
+    ASSERT(parse_duration_ms("") < 0 && parse_duration_ms("soon") < 0, "garbage rejected");
+}
+
+static void test_retry_after_429(void) {
+    printf("test_retry_after_429\n");
+    script_reset();
+    script.status[0] = 429;
+    script.headers[0] = "Retry-After: 1\r\n";
+    script.n = 1;
+    struct audio a;
+    int16_t *pcm = make_audio(&a, 1);
+    char *text = transcribe_groq(&a);
+    ASSERT(text && strcmp(text, "groq text") == 0, "answered after the wait");
+    ASSERT(script.calls == 2, "one retry");
+    ASSERT(script.at[1] - script.at[0] >= 1000, "Retry-After honoured");
+    ASSERT(script.at[1] - script.at[0] < 1000 + API_BACKOFF_MS + 200, "and not much more");
+    free(text);
+    audio_free(&a);
+    free(pcm);
+}
+
+static void test_503_backoff_with_jitter(void) {
+    printf("test_503_backoff_with_jitter\n");
+    script_reset();
+    script.status[0] = script.status[1] = 503;
+    script.n = 2;
+    struct audio a;
+    int16_t *pcm = make_audio(&a, 1);
+    char *text = transcribe_groq(&a);
+    ASSERT(text && strcmp(text, "groq text") == 0, "third attempt succeeds");
+    ASSERT(script.calls == 3, "two retries");
+    double gap1 = script.at[1] - script.at[0], gap2 = script.at[2] - script.at[1];
+    ASSERT(gap1 >= API_BACKOFF_MS / 2 && gap1 < API_BACKOFF_MS + 150, "first backoff in range");
+    ASSERT(gap2 >= API_BACKOFF_MS && gap2 < 2 * API_BACKOFF_MS + 150, "second backoff doubled");
+    free(text);
+
+    /* a backend that stays down is given up on within the attempts */
+    script_reset();
+    for (int i = 0; i < 8; i++) script.status[i] = 503;
+    script.n = 8;
+    text = transcribe_groq(&a);
+    ASSERT(text == NULL, "fails once retries are spent");
+    ASSERT(script.calls == API_RETRIES + 1, "bounded attempts");
+    audio_free(&a);
+    free(pcm);
+}
+
+static void test_submit_retried_only_if_rejected(void) {
+    printf("test_submit_retried_only_if_rejected\n");
+    aai_stub.job_ms = 0;
+    aai_stub.fail = 0;
+    struct audio a;
+    int16_t *pcm = make_audio(&a, 1);
+
+    script_reset();
+    script.submit_status = 500;
+    char *text = transcribe_aai(&a);
+    ASSERT(text == NULL && script.submits == 1, "a 500 may have started a job: no resubmit");
+
+    script_reset();
+    script.submit_status = 429;
+    script.headers[0] = "Retry-After: 1\r\n";
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    text = transcribe_aai(&a);
+    ASSERT(text == NULL && script.submits == API_RETRIES + 1, "a 429 was refused: resubmitted");
+    ASSERT(ms_since(&t0) >= 1000.0 * API_RETRIES, "each after Retry-After");
+    audio_free(&a);
+    free(pcm);
+}
+
+static void test_token_bucket(void) {
+    printf("test_token_bucket\n");
+    script_reset();
+    cfg.groq_rpm = 120;                       /* 2/s, bursts of 20 */
+    int immediate = 0;
+    while (bucket_take(HOST_GROQ) == 0 && immediate < 100) immediate++;
+    ASSERT(immediate == 20, "burst of API_BURST_S worth");
+    long wait = bucket_take(HOST_GROQ);
+    ASSERT(wait > 0 && wait <= 500, "then one every 500 ms");
+    cfg.groq_rpm = 0;
+    ASSERT(bucket_take(HOST_AAI) == 0, "unlimited at 0");
+
+    /* a chunk the open circuit turns away does not spend a token */
+    script_reset();
+    cfg.groq_rpm = 120;
+    for (int i = 0; i < BREAKER_MIN_CALLS; i++) breaker_record(HOST_GROQ, 1, 0, 1);
+    struct upload_job held = {0};
+    int launched = 0, failed = 0;
+    for (int i = 0; i < 30; i++) {
+        held.state = JOB_QUEUED;
+        launched += uploader_may_launch(&held);
+        failed += held.state == JOB_FAILED;
+    }
+    ASSERT(!launched && failed == 30, "open circuit: sent the other way");
+    immediate = 0;
+    while (bucket_take(HOST_GROQ) == 0 && immediate < 100) immediate++;
+    ASSERT(immediate == 20, "the burst is still there");
+    cfg.groq_rpm = 0;
+
+    /* the server reports its request budget spent: everyone waits */
+    script_reset();
+    script.status[0] = 200;
+    script.headers[0] = "x-ratelimit-remaining-requests: 0\r\n"
+                        "x-ratelimit-reset-requests: 1.5s\r\n";
+    script.n = 1;
+    struct audio a;
+    int16_t *pcm = make_audio(&a, 1);
+    char *t1 = transcribe_groq(&a);
+    char *t2 = transcribe_groq(&a);
+    ASSERT(t1 && t2, "both answered");
+    ASSERT(script.at[1] - script.at[0] >= 1500, "second request waited for the reset");
+    free(t1);
+    free(t2);
+    audio_free(&a);
+    free(pcm);
+}
+
+static void test_uploader_rate_limited(void) {
+    printf("test_uploader_rate_limited\n");
+    script_reset();
+    script.status[0] = script.status[1] = 429;
+    script.headers[0] = script.headers[1] = "Retry-After: 1\r\n";
+    script.n = 2;
+    have_groq = 1;
+    struct uploader u;
+    uploader_init(&u, ACT_COPY);
+    int16_t *pcm[3];
+    for (int i = 0; i < 3; i++) {
+        struct audio a;
+        pcm[i] = make_audio(&a, 1);
+        uploader_add(&u, &a);
+    }
+    uploader_wait(&u);
+    struct strbuf sb = {0};
+    uploader_collect(&u, &sb);
+    uploader_free(&u);
+    ASSERT(sb.data && strcmp(sb.data, "groq text groq text groq text") == 0,
+           "every chunk answered");
+    ASSERT(script.calls == 5, "two rejected, retried once each");
+    ASSERT(script.at[4] >= 1000, "nothing went out during the pause");
+    ASSERT(breakers[HOST_GROQ].n == 3, "429s are not counted as ill health");
+    strbuf_free(&sb);
+    for (int i = 0; i < 3; i++) free(pcm[i]);
+    have_groq = 0;
+}
+
+/* ── Session deadline ────────────────────────────────────────────────── */
+
+/* A deadline of ms from now, as handle_recording_done() sets it */
+static void deadline_in(int ms) {
+    cfg.latency_slo_ms = ms;
+    deadline_start(0);
+}
+
+static void test_deadline_cuts_slow_groq(void) {
+    printf("test_deadline_cuts_slow_groq\n");
+    stub_reset(hedge_handler);
+    reset_breakers();
+    groq_ms = 5000;
+    aai_stub.job_ms = 0;
+    aai_stub.polls = 0;
+    have_groq = have_aai = 1;
+    struct audio a;
+    int16_t *pcm = make_audio(&a, 1);
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    deadline_in(1000);
+    char *text = transcribe(&a);
+    double ms = ms_since(&t0);
+    ASSERT(text == NULL, "no text past the deadline");
+    ASSERT(ms >= 950 && ms < 1500, "Groq got the budget and no more");
+    ASSERT(deadline_reported, "reported as deadline exceeded");
+    ASSERT(aai_stub.polls == 0, "fallback that could not finish was not started");
+    ASSERT(breakers[HOST_GROQ].n == 0, "cut-off call not held against Groq");
+    deadline_end();
+    groq_ms = 0;
+    have_groq = have_aai = 0;
+    audio_free(&a);
+    free(pcm);
+}
+
+static void test_deadline_bounds_retries(void) {
+    printf("test_deadline_bounds_retries\n");
+    stub_reset(groq_down_handler);
+    reset_breakers();
+    groq_calls = 0;
+    have_groq = 1;
+    struct audio a;
+    int16_t *pcm = make_audio(&a, 1);
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    deadline_in(600);   /* too short for all API_RETRIES backoffs, however jittered */
+    char *text = transcribe(&a);
+    ASSERT(text == NULL, "Groq never answered");
+    ASSERT(ms_since(&t0) < 700, "no retry sleeps past the deadline");
+    ASSERT(groq_calls >= 1 && groq_calls < API_RETRIES + 1, "retries cut short");
+    deadline_end();
+    have_groq = 0;
+    audio_free(&a);
+    free(pcm);
+    reset_breakers();
+}
+
+static void test_deadline_expires_uploader(void) {
+    printf("test_deadline_expires_uploader\n");
+    stub_reset(hedge_handler);
+    reset_breakers();
+    groq_ms = 5000;
+    have_groq = 1;
+    struct uploader u;
+    uploader_init(&u, ACT_COPY);
+    int16_t *pcm[2];
+    for (int i = 0; i < 2; i++) {
+        struct audio a;
+        pcm[i] = make_audio(&a, 1);
+        uploader_add(&u, &a);
+    }
+    uploader_poll(&u, 10);   /* launched while recording: no deadline yet */
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    deadline_in(1000);
+    uploader_wait(&u);
+    double ms = ms_since(&t0);
+    struct strbuf sb = {0};
+    uploader_collect(&u, &sb);
+    uploader_free(&u);
+    ASSERT(sb.len == 0, "no text past the deadline");
+    ASSERT(ms < 1300, "transfers stopped at the deadline");
+    ASSERT(deadline_reported, "reported as deadline exceeded");
+    strbuf_free(&sb);
+    for (int i = 0; i < 2; i++) free(pcm[i]);
+    deadline_end();
+    groq_ms = 0;
+    have_groq = 0;
+    cfg.latency_slo_ms = 20000;
+}
+
+static void slow_handler(const struct stub_req *rq, struct stub_resp *rs) {
+    (void)rq;
+    rs->delay_ms = 3000;
+}
+
+static void test_deadline_bounds_warm_join(void) {
+    printf("test_deadline_bounds_warm_join\n");
+    stub_reset(slow_handler);
+    have_groq = 1;
+    warm_start(ACT_COPY);
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    deadline_in(300);
+    warm_join();
+    ASSERT(ms_since(&t0) < 1300, "aborted at the deadline");
+    ASSERT(!warm.active && !warm.busy, "joined, not left running");
+    ASSERT(deadline_reported, "reported as deadline exceeded");
+    deadline_end();
+    have_groq = 0;
+    cfg.latency_slo_ms = 20000;
+}
+
+/* ── Real-time streaming ─────────────────────────────────────────────── */
+
+static void test_ws_accept_key(void) {
+    printf("test_ws_accept_key\n");
+    char out[29];
+    ws_accept_key("dGhlIHNhbXBsZSBub25jZQ==", out);   /* RFC 6455 section 1.3 */
+    ASSERT(strcmp(out, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") == 0, "handshake accept value");
+    uint8_t d[20];
+    sha1((const uint8_t *)"", 0, d);
+    ASSERT(d[0] == 0xda && d[1] == 0x39 && d[19] == 0x09, "sha1 of empty input");
+    char b64[9];
+    base64_encode((const uint8_t *)"ab", 2, b64);
+    ASSERT(strcmp(b64, "YWI=") == 0, "base64 padding");
+}
+
+/* Feed `seconds` of audio through the realtime consumer as the capture
+ * thread would, then release. Returns rt_finish(). */
+static char *run_realtime(double seconds) {
+    snprintf(cfg.realtime_url, sizeof(cfg.realtime_url), "ws://127.0.0.1:%d/v3/ws?sample_rate=16000",
+             stub.port);
+    pcm_ring_reset(&rt.ring);
+    rt_start(ACT_COPY);
+    size_t n = (size_t)(seconds * SAMPLE_RATE);
+    int16_t period[PERIOD_FRAMES] = {0};
+    for (size_t done = 0; done < n; ) {
+        size_t k = n - done < PERIOD_FRAMES ? n - done : PERIOD_FRAMES;
+        done += pcm_ring_write(&rt.ring, period, k);
+        if (done < n && pcm_ring_space(&rt.ring) < PERIOD_FRAMES) usleep(1000);
+    }
+    pcm_pos = n;
+    pcm_ring_close(&rt.ring);
+    rt_stop();
+    char *text = rt_finish();
+    pcm_pos = 0;
+    return text;
+}
+
+static void test_realtime_session(void) {
+    printf("test_realtime_session\n");
+    ws_stub.drop_after_ms = 0;
+    ws_stub.refuse = 0;
+    char *text = run_realtime(5.0);
+    ASSERT(text && strcmp(text, "turn0 turn1 turn2") == 0, "final turns in order");
+    ASSERT(ws_stub.audio_bytes == 5 * SAMPLE_RATE * FRAME_SIZE, "every sample sent");
+    free(text);
+}
+
+static void test_realtime_dropped_falls_back(void) {
+    printf("test_realtime_dropped_falls_back\n");
+    ws_stub.drop_after_ms = 1000;
+    char *text = run_realtime(3.0);
+    ASSERT(text == NULL, "lost connection: batch path takes over");
+    ws_stub.drop_after_ms = 0;
+
+    ws_stub.refuse = 1;
+    text = run_realtime(1.0);
+    ASSERT(text == NULL, "refused upgrade: batch path takes over");
+    ws_stub.refuse = 0;
+}
+
+static void test_ws_oversized_frame(void) {
+    printf("test_ws_oversized_frame\n");
+    char url[128];
+    snprintf(url, sizeof(url), "ws://127.0.0.1:%d/v3/ws", stub.port);
+    ws_stub.huge = 1;
+    struct ws w;
+    ASSERT(ws_connect(&w, url, NULL) == 0, "upgraded");
+    int op;
+    const char *data;
+    size_t len;
+    ASSERT(ws_recv(&w, 2000, &op, &data, &len) < 0, "terabyte frame refused");
+    ASSERT(w.closed && !w.curl && !w.in, "connection dropped, buffer freed");
+    ws_close(&w);
+    ws_stub.huge = 0;
+}
+
+static void test_realtime_deadline(void) {
+    printf("test_realtime_deadline\n");
+    ws_stub.mute = 1;
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    deadline_in(500);
+    char *text = run_realtime(1.0);
+    ASSERT(text == NULL, "no Termination in time: batch path takes over");
+    ASSERT(ms_since(&t0) < 1000, "Termination not waited for past the deadline");
+    ASSERT(deadline_reported, "reported as deadline exceeded");
+    deadline_end();
+    ws_stub.mute = 0;
+    cfg.latency_slo_ms = 20000;
+}
+
+static void groq_count_handler(const struct stub_req *rq, struct stub_resp *rs) {
+    if (strncmp(rq->path, "/openai/", 8) == 0) atomic_fetch_add(&groq_calls, 1);
+    snprintf(rs->body, sizeof(rs->body), "{\"text\": \"chunk\"}");
+}
+
+static void test_realtime_skips_stream_upload(void) {
+    printf("test_realtime_skips_stream_upload\n");
+    stub_reset(groq_count_handler);
+    groq_calls = 0;
+    have_groq = 1;
+    cfg.stream_upload = 1;
+    int vad = cfg.vad;
+    cfg.vad = 0;
+    stream_init();
+    size_t n = 35 * SAMPLE_RATE;   /* more than a chunk */
+    ASSERT(pcm_store_reserve(n) == 0, "store reserved");
+    pcm_ring_reset(&stream.ring);
+    stream_start(ACT_COPY);
+    ASSERT(!stream.active && !stream.have_up, "no chunks streamed to Groq");
+    int16_t period[PERIOD_FRAMES] = {0};
+    for (size_t done = 0; done < n; ) {   /* as the capture thread would */
+        size_t k = n - done < PERIOD_FRAMES ? n - done : PERIOD_FRAMES;
+        done += stream.active ? pcm_ring_write(&stream.ring, period, k) : k;
+        if (stream.active && pcm_ring_space(&stream.ring) < PERIOD_FRAMES) usleep(1000);
+    }
+    pcm_ring_close(&stream.ring);
+    char *text = run_realtime(5.0);
+    stream_stop();
+    struct uploader u;
+    stream_take(&u, ACT_COPY);
+    uploader_wait(&u);
+    uploader_free(&u);
+    ASSERT(text && strcmp(text, "turn0 turn1 turn2") == 0, "realtime transcript used");
+    ASSERT(groq_calls == 0, "Groq sent nothing");
+    free(text);
+    stream_shutdown();
+    pcm_store_reset();
+    cfg.vad = vad;
+    cfg.stream_upload = 0;
+    have_groq = 0;
+}
+
+/* ── Main ────────────────────────────────────────────────────────────── */
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "serve") == 0) {
+        if (stub_start(argc > 2 ? atoi(argv[2]) : 8765) != 0) {
+            perror("test_net: serve");
+            return 1;
+        }
+        printf("stand-in listening: realtime_url = ws://127.0.0.1:%d/v3/ws\n", stub.port);
+        pthread_join(stub.tid, NULL);
+        return 0;
+    }
+
+    signal(SIGPIPE, SIG_IGN);   /* stub replies to clients that hung up */
+    cfg.notify = 0;
+    snprintf(aai_key, sizeof(aai_key), "Authorization: test");
+    snprintf(groq_key, sizeof(groq_key), "Authorization: Bearer test");
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    pool_init();
+    if (stub_start(0) != 0) {
+        fprintf(stderr, "test_net: cannot start stub server\n");
+        return 1;
+    }
+    snprintf(cfg.realtime_url, sizeof(cfg.realtime_url), "ws://127.0.0.1:%d/v3/ws", stub.port);
+    rt_init();
+
+    test_aai_poll_schedule();
+    test_aai_jobs_concurrent();
+    test_aai_fast_job();
+    test_aai_slow_job_backs_off();
+    test_aai_job_error();
+    test_timed_chunk();
+    test_hedge_delay();
+    test_hedge_wins_over_slow_groq();
+    test_hedge_cancelled_when_groq_answers();
+    test_hedge_not_fired_for_fast_groq();
+    test_breaker_states();
+    test_breaker_skips_failing_groq();
+    test_parse_duration();
+    test_retry_after_429();
+    test_503_backoff_with_jitter();
+    test_submit_retried_only_if_rejected();
+    test_token_bucket();
+    test_uploader_rate_limited();
+    test_deadline_cuts_slow_groq();
+    test_deadline_bounds_retries();
+    test_deadline_expires_uploader();
+    test_deadline_bounds_warm_join();
+    test_ws_accept_key();
+    test_realtime_session();
+    test_realtime_dropped_falls_back();
+    test_ws_oversized_frame();
+    test_realtime_deadline();
+    test_realtime_skips_stream_upload();
+
+    rt_shutdown();
+    pool_shutdown();
+    curl_global_cleanup();
+    printf("\n%d tests, %d failed\n", tests_run, tests_failed);
+    return tests_failed ? 1 : 0;
+}
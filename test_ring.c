@@ -0,0 +1,179 @@
+/*
+ * test_ring — unit and stress tests for the lock-free SPSC sample ring
+ * Build: make test_ring
+ * Run:   ./test_ring            (2M periods)
+ *        ./test_ring 10000000   (custom period count)
+ *
+ * The stress test runs producer and consumer threads flat out with
+ * varying write/read sizes; every sample carries a running sequence
+ * number so any lost, duplicated or torn sample is detected.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define main dictator_main
+#include "dictator.c"
+#undef main
+
+static int tests_run, tests_failed;
+
+#define ASSERT(cond, msg) do { \
+    tests_run++; \
+    if (!(cond)) { \
+        fprintf(stderr, "  FAIL: %s (line %d)\n", msg, __LINE__); \
+        tests_failed++; \
+    } \
+} while (0)
+
+/* ── Single-threaded behaviour ───────────────────────────────────────── */
+
+static void test_ring_capacity_pow2(void) {
+    printf("test_ring_capacity_pow2\n");
+    struct pcm_ring r;
+    ASSERT(pcm_ring_init(&r, 1000) == 0, "init");
+    ASSERT(r.mask + 1 == 1024, "capacity rounded up to 1024");
+    ASSERT(pcm_ring_space(&r) == 1024, "empty ring: full space");
+    ASSERT(pcm_ring_readable(&r) == 0, "empty ring: nothing readable");
+    pcm_ring_free(&r);
+}
+
+static void test_ring_wraparound(void) {
+    printf("test_ring_wraparound\n");
+    struct pcm_ring r;
+    pcm_ring_init(&r, 8);
+    int16_t in[6], out[6];
+    int ok = 1;
+    int16_t seq = 0, expect = 0;
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 6; i++) in[i] = seq++;
+        if (pcm_ring_write(&r, in, 6) != 6) ok = 0;
+        if (pcm_ring_read(&r, out, 6) != 6) ok = 0;
+        for (int i = 0; i < 6; i++)
+            if (out[i] != expect++) ok = 0;
+    }
+    ASSERT(ok, "data intact across wraparound");
+    pcm_ring_free(&r);
+}
+
+static void test_ring_overrun_counted(void) {
+    printf("test_ring_overrun_counted\n");
+    struct pcm_ring r;
+    pcm_ring_init(&r, 16);
+    int16_t in[20] = {0};
+    size_t n = pcm_ring_write(&r, in, 20);
+    ASSERT(n == 16, "write stops at capacity");
+    ASSERT(atomic_load(&r.overruns) == 4, "4 dropped samples counted");
+    ASSERT(pcm_ring_space(&r) == 0, "ring full");
+    pcm_ring_free(&r);
+}
+
+static void test_ring_eof(void) {
+    printf("test_ring_eof\n");
+    struct pcm_ring r;
+    pcm_ring_init(&r, 16);
+    int16_t in[4] = {1, 2, 3, 4}, out[4];
+    pcm_ring_write(&r, in, 4);
+    pcm_ring_close(&r);
+    ASSERT(!pcm_ring_done(&r), "not done while data remains");
+    pcm_ring_read(&r, out, 4);
+    ASSERT(pcm_ring_done(&r), "done after drain");
+    pcm_ring_reset(&r);
+    ASSERT(!pcm_ring_done(&r), "reset clears eof");
+    ASSERT(pcm_ring_readable(&r) == 0, "reset empties ring");
+    pcm_ring_free(&r);
+}
+
+/* ── Concurrent stress ───────────────────────────────────────────────── */
+
+struct stress {
+    struct pcm_ring ring;
+    size_t          periods;
+    size_t          samples;   /* total written by the producer */
+    size_t          errors;    /* sequence mismatches seen by the consumer */
+    size_t          received;
+};
+
+static void *stress_producer(void *arg) {
+    struct stress *st = arg;
+    int16_t period[PERIOD_FRAMES];
+    uint16_t seq = 0;
+    for (size_t p = 0; p < st->periods; p++) {
+        size_t n = 1 + (p * 7919) % PERIOD_FRAMES; /* vary period length */
+        for (size_t i = 0; i < n; i++) period[i] = (int16_t)seq++;
+        size_t off = 0;
+        while (off < n) {
+            /* the real producer drops on full; here we wait so the
+             * consumer can check every sample */
+            size_t room = pcm_ring_space(&st->ring);
+            if (room == 0) { sched_yield(); continue; }
+            if (room > n - off) room = n - off;
+            off += pcm_ring_write(&st->ring, period + off, room);
+        }
+        st->samples += n;
+    }
+    pcm_ring_close(&st->ring);
+    return NULL;
+}
+
+static void *stress_consumer(void *arg) {
+    struct stress *st = arg;
+    int16_t buf[3 * PERIOD_FRAMES];
+    uint16_t expect = 0;
+    size_t want = 1;
+    while (!pcm_ring_done(&st->ring)) {
+        size_t n = pcm_ring_read(&st->ring, buf, want);
+        if (n == 0) { sched_yield(); continue; }
+        for (size_t i = 0; i < n; i++) {
+            if ((uint16_t)buf[i] != expect) {
+                st->errors++;
+                expect = (uint16_t)buf[i];
+            }
+            expect++;
+        }
+        st->received += n;
+        want = want * 5 % (3 * PERIOD_FRAMES) + 1; /* vary read size */
+    }
+    return NULL;
+}
+
+static void test_ring_stress(size_t periods) {
+    printf("test_ring_stress (%zu periods)\n", periods);
+    static struct stress st;
+    memset(&st, 0, sizeof(st));
+    st.periods = periods;
+    pcm_ring_init(&st.ring, 4 * PERIOD_FRAMES);
+
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_t prod, cons;
+    pthread_create(&cons, NULL, stress_consumer, &st);
+    pthread_create(&prod, NULL, stress_producer, &st);
+    pthread_join(prod, NULL);
+    pthread_join(cons, NULL);
+    double ms = ms_since(&t0);
+
+    printf("  %zu samples in %.0f ms (%.1f Msamples/s)\n",
+           st.received, ms, (double)st.received / ms / 1000.0);
+    ASSERT(st.received == st.samples, "consumer received every sample");
+    ASSERT(st.errors == 0, "no lost, duplicated or torn samples");
+    ASSERT(atomic_load(&st.ring.overruns) == 0, "no overruns");
+    pcm_ring_free(&st.ring);
+}
+
+/* ── Main ───────────────────────────────────────────────────────────── */
+
+int main(int argc, char **argv) {
+    size_t periods = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000000;
+
+    test_ring_capacity_pow2();
+    test_ring_wraparound();
+    test_ring_overrun_counted();
+    test_ring_eof();
+    test_ring_stress(periods);
+
+    printf("\n%d tests, %d failed\n", tests_run, tests_failed);
+    return tests_failed ? 1 : 0;
+}